@@ -0,0 +1,59 @@
+//
+//  Arena.cpp
+//  ParseOsmChangesetFile
+//
+//  Created by Bryce Cogswell on 10/18/26.
+//  Copyright © 2026 Bryce Cogswell. All rights reserved.
+//
+
+#include <stdlib.h>
+#include <string.h>
+#include <new>
+
+#include "Arena.hpp"
+
+Arena::Arena()
+	: next(NULL), end(NULL), chunkSize(FIRST_CHUNK), chunkBytes(0), bytesInUse(0), peakBytes(0), largeBytes(0), allocationCount(0)
+{
+	memset( freeLists, 0, sizeof freeLists );
+}
+
+// Everything allocated from the arena goes at once. Containers using it must be destroyed
+// first, which is the case for a reader's members since the arena is in its base class.
+Arena::~Arena()
+{
+	for ( char * chunk: chunks ) {
+		free( chunk );
+	}
+}
+
+// Starts a new chunk once the current one is too full for the block. What is left of the old
+// chunk is less than LARGEST_POOLED bytes, so it is abandoned.
+void * Arena::allocateChunk( size_t size )
+{
+	char * chunk = (char *)malloc( chunkSize );
+	if ( chunk == NULL )
+		throw std::bad_alloc();
+	chunks.push_back( chunk );
+	chunkBytes += chunkSize;
+	next = chunk + size;
+	end = chunk + chunkSize;
+	if ( chunkSize < LAST_CHUNK )
+		chunkSize *= 2;
+	return chunk;
+}
+
+void * Arena::allocateLarge( size_t size )
+{
+	void * p = malloc( size );
+	if ( p == NULL )
+		throw std::bad_alloc();
+	largeBytes += size;
+	return p;
+}
+
+void Arena::deallocateLarge( void * p, size_t size )
+{
+	largeBytes -= size;
+	free( p );
+}
@@ -0,0 +1,160 @@
+//
+//  Arena.hpp
+//  ParseOsmChangesetFile
+//
+//  Created by Bryce Cogswell on 10/18/26.
+//  Copyright © 2026 Bryce Cogswell. All rights reserved.
+//
+
+#ifndef Arena_hpp
+#define Arena_hpp
+
+#include <stddef.h>
+#include <functional>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// A memory pool owned by one reader, so the millions of small nodes and strings a reader
+// creates don't go through the global allocator, and so we can tell how much each reader uses.
+//
+// Small blocks are carved out of large chunks and recycled through a free list for each
+// size, so a table that is cleared and refilled reuses its memory. Large blocks, such as
+// the arrays behind vectors and hash tables, come from malloc but are still counted.
+// The chunks are all freed together when the arena is destroyed.
+//
+// An arena isn't thread safe: it belongs to a single reader, which only uses it from one thread at a time.
+class Arena {
+private:
+	static const size_t ALIGNMENT		= 16;
+	static const size_t LARGEST_POOLED	= 512;			// larger blocks come from malloc
+	static const size_t FIRST_CHUNK		= 64 << 10;		// chunks double in size up to LAST_CHUNK
+	static const size_t LAST_CHUNK		= 1 << 20;
+
+	struct FreeBlock {
+		FreeBlock *	next;
+	};
+	FreeBlock *			freeLists[LARGEST_POOLED / ALIGNMENT];	// indexed by size / ALIGNMENT - 1
+	std::vector<char *>	chunks;
+	char *				next;			// the unused part of the last chunk
+	char *				end;
+	size_t				chunkSize;		// the size of the next chunk
+	size_t				chunkBytes;		// the total size of the chunks
+	size_t				bytesInUse;
+	size_t				peakBytes;
+	size_t				largeBytes;		// the part of bytesInUse that came from malloc
+	long				allocationCount;
+
+	void * allocateChunk( size_t size );
+	void * allocateLarge( size_t size );
+	void deallocateLarge( void * p, size_t size );
+
+	Arena( const Arena & );				// not copyable
+	Arena & operator = ( const Arena & );
+public:
+	Arena();
+	~Arena();
+
+	void * allocate( size_t size )
+	{
+		size = size == 0 ? ALIGNMENT : (size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+		++allocationCount;
+		bytesInUse += size;
+		if ( bytesInUse > peakBytes )
+			peakBytes = bytesInUse;
+		if ( size > LARGEST_POOLED )
+			return allocateLarge( size );
+		FreeBlock *& list = freeLists[size / ALIGNMENT - 1];
+		if ( list ) {
+			FreeBlock * block = list;
+			list = block->next;
+			return block;
+		}
+		if ( (size_t)(end - next) < size )
+			return allocateChunk( size );
+		void * p = next;
+		next += size;
+		return p;
+	}
+
+	void deallocate( void * p, size_t size )
+	{
+		size = size == 0 ? ALIGNMENT : (size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+		bytesInUse -= size;
+		if ( size > LARGEST_POOLED ) {
+			deallocateLarge( p, size );
+			return;
+		}
+		FreeBlock *& list = freeLists[size / ALIGNMENT - 1];
+		FreeBlock * block = (FreeBlock *)p;
+		block->next = list;
+		list = block;
+	}
+
+	long allocations() const		{ return allocationCount; }
+	size_t currentBytes() const		{ return bytesInUse; }
+	size_t peak() const				{ return peakBytes; }
+	size_t reserved() const			{ return chunkBytes + largeBytes; }
+};
+
+// The memory of one or more arenas, for reports. The peak is the sum of their peaks,
+// which may not have happened at the same time.
+struct ArenaUsage {
+	size_t	peak = 0, current = 0, reserved = 0;
+	long	allocations = 0;
+
+	void add( const Arena & arena )
+	{
+		peak		+= arena.peak();
+		current		+= arena.currentBytes();
+		reserved	+= arena.reserved();
+		allocations	+= arena.allocations();
+	}
+};
+
+// A standard allocator that takes its memory from an arena, so standard containers can
+// live in a reader's arena. Without an arena it uses the global allocator.
+//
+// Containers keep the arena they were created with: assigning or swapping them doesn't move it.
+template <class T> class ArenaAllocator {
+public:
+	typedef T value_type;
+
+	Arena *		arena;
+
+	ArenaAllocator( Arena * arena = NULL ) : arena(arena) {}
+	template <class U> ArenaAllocator( const ArenaAllocator<U> & other ) : arena(other.arena) {}
+
+	T * allocate( size_t n )
+	{
+		if ( arena )
+			return (T *)arena->allocate( n * sizeof(T) );
+		return (T *)::operator new( n * sizeof(T) );
+	}
+	void deallocate( T * p, size_t n )
+	{
+		if ( arena )
+			arena->deallocate( p, n * sizeof(T) );
+		else
+			::operator delete( p );
+	}
+};
+
+template <class T, class U> bool operator == ( const ArenaAllocator<T> & a, const ArenaAllocator<U> & b )
+{
+	return a.arena == b.arena;
+}
+template <class T, class U> bool operator != ( const ArenaAllocator<T> & a, const ArenaAllocator<U> & b )
+{
+	return a.arena != b.arena;
+}
+
+// Containers that live in an arena
+template <class T> using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+template <class K, class V> using ArenaMap = std::map<K, V, std::less<K>, ArenaAllocator<std::pair<const K, V>>>;
+template <class K, class V, class Hash = std::hash<K>>
+	using ArenaUnorderedMap = std::unordered_map<K, V, Hash, std::equal_to<K>, ArenaAllocator<std::pair<const K, V>>>;
+typedef std::basic_string<char, std::char_traits<char>, ArenaAllocator<char>> ArenaString;
+
+#endif /* Arena_hpp */
@@ -0,0 +1,482 @@
+//
+//  ArrowExport.cpp
+//  ParseOsmChangesetFile
+//
+//  Created by Bryce Cogswell on 10/18/26.
+//  Copyright © 2026 Bryce Cogswell. All rights reserved.
+//
+
+#include <algorithm>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ArrowExport.hpp"
+#include "GroupBy.hpp"
+
+// Arrow metadata is stored as flatbuffers. We only need to write a handful of tables,
+// so rather than depending on the flatbuffers library this is a minimal builder.
+// Like the real one it builds the buffer from back to front, so children are always
+// written before the tables that refer to them. Values are stored in host order,
+// which is little-endian on every machine we run on.
+class FlatBuilder {
+	std::vector<uint8_t>	buf;		// data occupies [head, buf.size())
+	size_t					head;
+	size_t					minAlign;
+	uint32_t				tableStart;
+	std::vector<std::pair<int,uint32_t>>	fields;		// field id, location of value
+
+	void reserve( size_t len )
+	{
+		if ( len <= head )
+			return;
+		size_t used = buf.size() - head;
+		size_t size = std::max( buf.size() * 2, used + len + 256 );
+		std::vector<uint8_t> bigger( size );
+		memcpy( &bigger[size - used], &buf[head], used );
+		buf.swap( bigger );
+		head = size - used;
+	}
+
+public:
+	FlatBuilder() : head(0), minAlign(1), tableStart(0) {}
+
+	// Locations are measured from the end of the buffer, since that doesn't change as it grows
+	uint32_t size() const	{ return (uint32_t)(buf.size() - head); }
+
+	void bytes( const void * data, size_t len )
+	{
+		reserve( len );
+		head -= len;
+		memcpy( &buf[head], data, len );
+	}
+
+	void pad( size_t len )
+	{
+		reserve( len );
+		while ( len-- > 0 )
+			buf[--head] = 0;
+	}
+
+	// Pads so that after writing len more bytes the size is a multiple of align
+	void prep( size_t align, size_t len )
+	{
+		minAlign = std::max( minAlign, align );
+		pad( (align - ((size() + len) % align)) % align );
+	}
+
+	template <class T> void push( T value )
+	{
+		prep( sizeof value, 0 );
+		bytes( &value, sizeof value );
+	}
+
+	void pushOffset( uint32_t location )
+	{
+		prep( 4, 0 );
+		push<uint32_t>( size() + 4 - location );
+	}
+
+	uint32_t string( const std::string & s )
+	{
+		prep( 4, s.size() + 1 );
+		pad( 1 );
+		bytes( s.data(), s.size() );
+		push<uint32_t>( (uint32_t)s.size() );
+		return size();
+	}
+
+	uint32_t offsets( const std::vector<uint32_t> & locations )
+	{
+		prep( 4, 4 * locations.size() );
+		for ( size_t i = locations.size(); i > 0; --i ) {
+			pushOffset( locations[i-1] );
+		}
+		push<uint32_t>( (uint32_t)locations.size() );
+		return size();
+	}
+
+	// A vector of structs, which are given as a sequence of 64-bit words
+	uint32_t structs( const std::vector<int64_t> & words, size_t wordsPerStruct )
+	{
+		prep( 4, 8 * words.size() );
+		prep( 8, 8 * words.size() );
+		bytes( words.data(), 8 * words.size() );
+		push<uint32_t>( (uint32_t)(words.size() / wordsPerStruct) );
+		return size();
+	}
+
+	void startTable()
+	{
+		fields.clear();
+		tableStart = size();
+	}
+
+	template <class T> void add( int field, T value )
+	{
+		push( value );
+		fields.push_back( std::pair<int,uint32_t>( field, size() ) );
+	}
+
+	void addOffset( int field, uint32_t location )
+	{
+		pushOffset( location );
+		fields.push_back( std::pair<int,uint32_t>( field, size() ) );
+	}
+
+	uint32_t endTable()
+	{
+		push<int32_t>( 0 );		// offset to the vtable, filled in below
+		uint32_t table = size();
+
+		int count = 0;
+		for ( const auto &field: fields ) {
+			count = std::max( count, field.first + 1 );
+		}
+		std::vector<uint16_t> vtable( count, 0 );
+		for ( const auto &field: fields ) {
+			vtable[field.first] = (uint16_t)(table - field.second);
+		}
+		for ( int i = count; i > 0; --i ) {
+			push<uint16_t>( vtable[i-1] );
+		}
+		push<uint16_t>( (uint16_t)(table - tableStart) );
+		push<uint16_t>( (uint16_t)(2 * (count + 2)) );
+
+		int32_t vtableOffset = (int32_t)(size() - table);
+		memcpy( &buf[buf.size() - table], &vtableOffset, 4 );
+		return table;
+	}
+
+	std::string finish( uint32_t root )
+	{
+		prep( minAlign, 4 );
+		pushOffset( root );
+		return std::string( (const char *)&buf[head], size() );
+	}
+};
+
+// Arrow format constants, from Schema.fbs and Message.fbs
+enum {
+	METADATA_V5 = 4,
+	HEADER_SCHEMA = 1, HEADER_DICTIONARY_BATCH = 2, HEADER_RECORD_BATCH = 3,
+	TYPE_INT = 2, TYPE_FLOATING_POINT = 3, TYPE_UTF8 = 5, TYPE_DATE = 8,
+	PRECISION_DOUBLE = 2,
+	DATE_UNIT_DAY = 0,
+};
+
+enum ColumnType { COLUMN_INT64, COLUMN_INT32, COLUMN_DATE, COLUMN_DOUBLE, COLUMN_STRING };
+
+enum {
+	COL_ID, COL_CREATED_AT, COL_UID, COL_USER, COL_APPLICATION, COL_LOCALE, COL_COMMENT,
+	COL_NUM_CHANGES, COL_MIN_LAT, COL_MAX_LAT, COL_MIN_LON, COL_MAX_LON, COL_COUNT
+};
+
+// Strings are dictionary encoded, using the column number as the dictionary id
+static const struct { const char * name; ColumnType type; } columnInfo[COL_COUNT] = {
+	{ "id",				COLUMN_INT64 },
+	{ "created_at",		COLUMN_DATE },
+	{ "uid",			COLUMN_INT32 },
+	{ "user",			COLUMN_STRING },
+	{ "application",	COLUMN_STRING },
+	{ "locale",			COLUMN_STRING },
+	{ "comment",		COLUMN_STRING },
+	{ "num_changes",	COLUMN_INT32 },
+	{ "min_lat",		COLUMN_DOUBLE },
+	{ "max_lat",		COLUMN_DOUBLE },
+	{ "min_lon",		COLUMN_DOUBLE },
+	{ "max_lon",		COLUMN_DOUBLE },
+};
+
+static uint32_t IntType( FlatBuilder & fb, int bitWidth )
+{
+	fb.startTable();
+	fb.add<int32_t>( 0, bitWidth );
+	fb.add<uint8_t>( 1, 1 );	// signed
+	return fb.endTable();
+}
+
+static uint32_t BuildSchema( FlatBuilder & fb )
+{
+	std::vector<uint32_t> fields;
+	for ( int col = 0; col < COL_COUNT; ++col ) {
+		uint32_t name = fb.string( columnInfo[col].name );
+		uint32_t children = fb.offsets( std::vector<uint32_t>() );
+
+		uint8_t typeType = 0;
+		uint32_t type = 0;
+		uint32_t dictionary = 0;
+		switch ( columnInfo[col].type ) {
+			case COLUMN_INT64:
+			case COLUMN_INT32:
+				typeType = TYPE_INT;
+				type = IntType( fb, columnInfo[col].type == COLUMN_INT64 ? 64 : 32 );
+				break;
+			case COLUMN_DATE:
+				typeType = TYPE_DATE;
+				fb.startTable();
+				fb.add<int16_t>( 0, DATE_UNIT_DAY );
+				type = fb.endTable();
+				break;
+			case COLUMN_DOUBLE:
+				typeType = TYPE_FLOATING_POINT;
+				fb.startTable();
+				fb.add<int16_t>( 0, PRECISION_DOUBLE );
+				type = fb.endTable();
+				break;
+			case COLUMN_STRING: {
+				typeType = TYPE_UTF8;
+				fb.startTable();
+				type = fb.endTable();
+				uint32_t indexType = IntType( fb, 32 );
+				fb.startTable();
+				fb.add<int64_t>( 0, col );
+				fb.addOffset( 1, indexType );
+				dictionary = fb.endTable();
+				break;
+			}
+		}
+
+		fb.startTable();
+		fb.addOffset( 0, name );
+		fb.add<uint8_t>( 1, 0 );		// not nullable
+		fb.add<uint8_t>( 2, typeType );
+		fb.addOffset( 3, type );
+		if ( dictionary )
+			fb.addOffset( 4, dictionary );
+		fb.addOffset( 5, children );
+		fields.push_back( fb.endTable() );
+	}
+	uint32_t fieldVector = fb.offsets( fields );
+	fb.startTable();
+	fb.add<int16_t>( 0, 0 );	// little-endian
+	fb.addOffset( 1, fieldVector );
+	return fb.endTable();
+}
+
+// A RecordBatch table describing buffers that have been laid out in a message body
+static uint32_t BuildRecordBatch( FlatBuilder & fb, long length, const std::vector<int64_t> & nodes,
+								 const std::vector<int64_t> & buffers )
+{
+	uint32_t nodeVector = fb.structs( nodes, 2 );
+	uint32_t bufferVector = fb.structs( buffers, 2 );
+	fb.startTable();
+	fb.add<int64_t>( 0, length );
+	fb.addOffset( 1, nodeVector );
+	fb.addOffset( 2, bufferVector );
+	return fb.endTable();
+}
+
+static std::string BuildMessage( FlatBuilder & fb, uint8_t headerType, uint32_t header, long bodyLength )
+{
+	fb.startTable();
+	fb.add<int16_t>( 0, METADATA_V5 );
+	fb.add<uint8_t>( 1, headerType );
+	fb.addOffset( 2, header );
+	fb.add<int64_t>( 3, bodyLength );
+	return fb.finish( fb.endTable() );
+}
+
+// Appends a buffer to a message body, padded to a multiple of 8 bytes,
+// and records its location for the RecordBatch table
+static void AddBuffer( std::string & body, std::vector<int64_t> & buffers, const void * data, size_t len )
+{
+	buffers.push_back( body.size() );
+	buffers.push_back( len );
+	if ( len > 0 )
+		body.append( (const char *)data, len );
+	body.append( (8 - len % 8) % 8, '\0' );
+}
+
+ArrowExporter::ArrowExporter( const std::string & path, long batchSize )
+	: path(path), file(NULL), fileOffset(0), batchSize(batchSize), rows(0), totalRows(0),
+	  columns(COL_COUNT), dictionaries(COL_COUNT), error(false)
+{
+}
+
+ArrowExporter::~ArrowExporter()
+{
+	if ( file )
+		fclose( file );
+}
+
+void ArrowExporter::write( const void * data, size_t len )
+{
+	if ( file && fwrite( data, 1, len, file ) != len ) {
+		perror( path.c_str() );
+		error = true;
+	}
+	fileOffset += len;
+}
+
+// Writes an encapsulated message: a continuation marker, the metadata length,
+// the metadata padded to 8 bytes, and the body
+ArrowExporter::Block ArrowExporter::writeMessage( const std::string & metadata, const std::string & body )
+{
+	Block block;
+	block.offset = fileOffset;
+	int32_t padded = (int32_t)((metadata.size() + 7) & ~7);
+	int32_t prefix[2] = { -1, padded };
+	write( prefix, sizeof prefix );
+	write( metadata.data(), metadata.size() );
+	write( "\0\0\0\0\0\0\0", padded - metadata.size() );
+	write( body.data(), body.size() );
+	block.metadataLength = (int)sizeof prefix + padded;
+	block.bodyLength = body.size();
+	return block;
+}
+
+void ArrowExporter::initialize()
+{
+	file = fopen( path.c_str(), "wb" );
+	if ( file == NULL ) {
+		perror( path.c_str() );
+		error = true;
+		return;
+	}
+	for ( auto &dictionary: dictionaries ) {
+		dictionary.offsets.assign( 1, 0 );
+		dictionary.count = 0;
+		dictionary.written = false;
+	}
+
+	write( "ARROW1\0\0", 8 );
+	FlatBuilder fb;
+	uint32_t schema = BuildSchema( fb );
+	writeMessage( BuildMessage( fb, HEADER_SCHEMA, schema, 0 ), std::string() );
+}
+
+template <class T> void ArrowExporter::append( int column, T value )
+{
+	columns[column].append( (const char *)&value, sizeof value );
+}
+
+void ArrowExporter::appendString( int column, const std::string & value )
+{
+	Dictionary & dictionary = dictionaries[column];
+	auto it = dictionary.ids.find( value );
+	if ( it == dictionary.ids.end() ) {
+		it = dictionary.ids.insert( std::pair<std::string,int32_t>( value, dictionary.count++ ) ).first;
+		dictionary.data += value;
+		dictionary.offsets.push_back( (int32_t)dictionary.data.size() );
+	}
+	append<int32_t>( column, it->second );
+}
+
+void ArrowExporter::process( const Changeset & changeset )
+{
+	if ( file == NULL )
+		return;
+	append<int64_t>( COL_ID, changeset.ident );
+	append<int32_t>( COL_CREATED_AT, DayNumber( changeset.date ) );
+	append<int32_t>( COL_UID, changeset.uid );
+	appendString( COL_USER, changeset.user );
+	appendString( COL_APPLICATION, changeset.application );
+	appendString( COL_LOCALE, changeset.locale );
+	appendString( COL_COMMENT, changeset.comment );
+	append<int32_t>( COL_NUM_CHANGES, changeset.editCount );
+	append<double>( COL_MIN_LAT, changeset.min_lat );
+	append<double>( COL_MAX_LAT, changeset.max_lat );
+	append<double>( COL_MIN_LON, changeset.min_lon );
+	append<double>( COL_MAX_LON, changeset.max_lon );
+	if ( ++rows == batchSize )
+		flushBatch();
+}
+
+// Writes the strings added since the last batch. The first batch for a dictionary
+// defines it, and later ones are deltas that extend it.
+void ArrowExporter::flushDictionary( int column )
+{
+	Dictionary & dictionary = dictionaries[column];
+	long count = dictionary.offsets.size() - 1;
+	if ( count == 0 && dictionary.written )
+		return;
+
+	std::string body;
+	std::vector<int64_t> buffers;
+	AddBuffer( body, buffers, NULL, 0 );		// validity: no nulls
+	AddBuffer( body, buffers, dictionary.offsets.data(), 4 * dictionary.offsets.size() );
+	AddBuffer( body, buffers, dictionary.data.data(), dictionary.data.size() );
+	std::vector<int64_t> nodes = { count, 0 };
+
+	FlatBuilder fb;
+	uint32_t data = BuildRecordBatch( fb, count, nodes, buffers );
+	fb.startTable();
+	fb.add<int64_t>( 0, column );
+	fb.addOffset( 1, data );
+	fb.add<uint8_t>( 2, dictionary.written );	// isDelta
+	uint32_t batch = fb.endTable();
+	dictionaryBlocks.push_back( writeMessage( BuildMessage( fb, HEADER_DICTIONARY_BATCH, batch, body.size() ), body ) );
+
+	dictionary.written = true;
+	dictionary.offsets.assign( 1, 0 );
+	dictionary.data.clear();
+}
+
+void ArrowExporter::flushBatch()
+{
+	if ( rows == 0 )
+		return;
+	for ( int col = 0; col < COL_COUNT; ++col ) {
+		if ( columnInfo[col].type == COLUMN_STRING )
+			flushDictionary( col );
+	}
+
+	std::string body;
+	std::vector<int64_t> nodes, buffers;
+	for ( auto &column: columns ) {
+		nodes.push_back( rows );
+		nodes.push_back( 0 );
+		AddBuffer( body, buffers, NULL, 0 );		// validity: no nulls
+		AddBuffer( body, buffers, column.data(), column.size() );
+		column.clear();
+	}
+	FlatBuilder fb;
+	uint32_t batch = BuildRecordBatch( fb, rows, nodes, buffers );
+	recordBlocks.push_back( writeMessage( BuildMessage( fb, HEADER_RECORD_BATCH, batch, body.size() ), body ) );
+	totalRows += rows;
+	rows = 0;
+}
+
+void ArrowExporter::finalize()
+{
+	if ( file == NULL )
+		return;
+	flushBatch();
+
+	// end-of-stream marker
+	int32_t eos[2] = { -1, 0 };
+	write( eos, sizeof eos );
+
+	// the footer repeats the schema and indexes every message, so readers can mmap the file
+	FlatBuilder fb;
+	uint32_t schema = BuildSchema( fb );
+	uint32_t blockVectors[2];
+	const std::vector<Block> * blockLists[2] = { &dictionaryBlocks, &recordBlocks };
+	for ( int i = 0; i < 2; ++i ) {
+		std::vector<int64_t> words;
+		for ( const auto &block: *blockLists[i] ) {
+			words.push_back( block.offset );
+			words.push_back( block.metadataLength );	// followed by 4 bytes of padding
+			words.push_back( block.bodyLength );
+		}
+		blockVectors[i] = fb.structs( words, 3 );
+	}
+	fb.startTable();
+	fb.add<int16_t>( 0, METADATA_V5 );
+	fb.addOffset( 1, schema );
+	fb.addOffset( 2, blockVectors[0] );
+	fb.addOffset( 3, blockVectors[1] );
+	std::string footer = fb.finish( fb.endTable() );
+	write( footer.data(), footer.size() );
+	int32_t footerLength = (int32_t)footer.size();
+	write( &footerLength, sizeof footerLength );
+	write( "ARROW1", 6 );
+
+	if ( fclose( file ) != 0 ) {
+		perror( path.c_str() );
+		error = true;
+	}
+	file = NULL;
+
+	fprintf( out, "Exported %ld changesets to %s\n", totalRows, path.c_str() );
+}
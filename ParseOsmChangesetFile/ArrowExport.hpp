@@ -0,0 +1,70 @@
+//
+//  ArrowExport.hpp
+//  ParseOsmChangesetFile
+//
+//  Created by Bryce Cogswell on 10/18/26.
+//  Copyright © 2026 Bryce Cogswell. All rights reserved.
+//
+
+#ifndef ArrowExport_hpp
+#define ArrowExport_hpp
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "ChangesetParser.hpp"
+
+// Writes changesets to an Arrow IPC file (also known as Feather v2), which can be
+// opened directly by pyarrow, pandas and DuckDB, without depending on the Arrow library.
+//
+// Rows are buffered and written as record batches of a fixed number of rows, so memory
+// use is bounded apart from the string dictionaries. Each batch is preceded by delta
+// dictionary batches holding any strings that weren't seen in earlier batches.
+class ArrowExporter: public ChangesetReader {
+private:
+	struct Block {
+		long	offset;
+		int		metadataLength;
+		long	bodyLength;
+	};
+	struct Dictionary {
+		std::unordered_map<std::string,int32_t>	ids;
+		std::vector<int32_t>					offsets;	// offsets of the strings not yet written
+		std::string								data;
+		int32_t									count;
+		bool									written;
+	};
+	std::string					path;
+	FILE *						file;
+	long						fileOffset;
+	long						batchSize;
+	long						rows;			// rows in the current batch
+	long						totalRows;
+	std::vector<std::string>	columns;		// raw little-endian values of the current batch
+	std::vector<Dictionary>		dictionaries;	// indexed by column, unused for other columns
+	std::vector<Block>			dictionaryBlocks;
+	std::vector<Block>			recordBlocks;
+	bool						error;
+
+	template <class T> void append( int column, T value );
+	void appendString( int column, const std::string & value );
+	void write( const void * data, size_t len );
+	Block writeMessage( const std::string & metadata, const std::string & body );
+	void flushDictionary( int column );
+	void flushBatch();
+public:
+	ArrowExporter( const std::string & path, long batchSize = 64*1024 );
+	~ArrowExporter();
+
+	void initialize();
+	void process( const Changeset & changeset );
+	void finalize();
+
+	bool failed() const		{ return error; }
+	long rowCount() const	{ return totalRows; }
+};
+
+#endif /* ArrowExport_hpp */
@@ -0,0 +1,611 @@
+//
+//  ChangesetFilter.cpp
+//  ParseOsmChangesetFile
+//
+//  Created by Bryce Cogswell on 10/18/26.
+//  Copyright © 2026 Bryce Cogswell. All rights reserved.
+//
+
+#include <algorithm>
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ChangesetParser.hpp"
+#include "ChangesetFilter.hpp"
+#include "Parallel.hpp"
+#include "UserTable.hpp"
+
+enum FilterField {
+	FIELD_ID, FIELD_UID, FIELD_CHANGES, FIELD_MIN_LAT, FIELD_MAX_LAT, FIELD_MIN_LON, FIELD_MAX_LON,	// numbers
+	FIELD_USER, FIELD_DATE,																		// strings
+	FIELD_APPLICATION, FIELD_CREATED_BY, FIELD_COMMENT, FIELD_LOCALE, FIELD_QUEST_TYPE,			// tags
+	FIELD_HASHTAGS,
+	FIELD_TAG																					// tag:<key>
+};
+
+enum FilterOp { OP_EQ, OP_NE, OP_LT, OP_LE, OP_GT, OP_GE, OP_PREFIX, OP_CONTAINS };
+
+static const struct { const char * name; FilterField field; } fieldNames[] = {
+	{ "id",				FIELD_ID },
+	{ "uid",			FIELD_UID },
+	{ "changes",		FIELD_CHANGES },
+	{ "min_lat",		FIELD_MIN_LAT },
+	{ "max_lat",		FIELD_MAX_LAT },
+	{ "min_lon",		FIELD_MIN_LON },
+	{ "max_lon",		FIELD_MAX_LON },
+	{ "user",			FIELD_USER },
+	{ "date",			FIELD_DATE },
+	{ "application",	FIELD_APPLICATION },
+	{ "created_by",		FIELD_CREATED_BY },
+	{ "comment",		FIELD_COMMENT },
+	{ "locale",			FIELD_LOCALE },
+	{ "quest_type",		FIELD_QUEST_TYPE },
+	{ "hashtags",		FIELD_HASHTAGS },
+};
+
+// Tags the parser keeps in fields of their own, so tag:<key> never sees them
+static const struct { const char * key; const char * field; } parsedTags[] = {
+	{ "created_by",					"created_by" },
+	{ "comment",					"comment" },
+	{ "locale",						"locale" },
+	{ "StreetComplete:quest_type",	"quest_type" },
+	{ "hashtags",					"hashtags" },
+};
+
+// longest operators first, so "<=" isn't read as "<"
+static const struct { const char * name; FilterOp op; } opNames[] = {
+	{ "!=",	OP_NE },
+	{ "<=",	OP_LE },
+	{ ">=",	OP_GE },
+	{ "^=",	OP_PREFIX },
+	{ "=",	OP_EQ },
+	{ "<",	OP_LT },
+	{ ">",	OP_GT },
+	{ "~",	OP_CONTAINS },
+};
+
+static bool IsNumeric( int field )
+{
+	return field <= FIELD_MAX_LON;
+}
+
+static bool IsTag( int field )
+{
+	return field >= FIELD_APPLICATION;
+}
+
+static double NumberField( int field, const Changeset & changeset )
+{
+	switch ( field ) {
+		case FIELD_ID:		return changeset.ident;
+		case FIELD_UID:		return changeset.uid;
+		case FIELD_CHANGES:	return changeset.editCount;
+		case FIELD_MIN_LAT:	return changeset.min_lat;
+		case FIELD_MAX_LAT:	return changeset.max_lat;
+		case FIELD_MIN_LON:	return changeset.min_lon;
+		default:			return changeset.max_lon;
+	}
+}
+
+static const std::string & StringField( int field, const std::string & key, const Changeset & changeset )
+{
+	static const std::string missing;
+	switch ( field ) {
+		case FIELD_USER:		return changeset.user;
+		case FIELD_DATE:		return changeset.date;
+		case FIELD_APPLICATION:	return changeset.application;
+		case FIELD_CREATED_BY:	return changeset.applicationRaw;
+		case FIELD_COMMENT:		return changeset.comment;
+		case FIELD_LOCALE:		return changeset.locale;
+		case FIELD_QUEST_TYPE:	return changeset.quest_type;
+		case FIELD_HASHTAGS:	return changeset.hashtags;
+		default:
+			for ( const auto &tag: changeset.tags ) {
+				if ( tag.first == key )
+					return tag.second;
+			}
+			return missing;
+	}
+}
+
+template <class T> static bool Compare( int op, const T & a, const T & b )
+{
+	switch ( op ) {
+		case OP_EQ:	return a == b;
+		case OP_NE:	return a != b;
+		case OP_LT:	return a < b;
+		case OP_LE:	return a <= b;
+		case OP_GT:	return a > b;
+		default:	return a >= b;
+	}
+}
+
+// Recursive descent parser for filter expressions:
+//		expr		:= and-expr { "or" and-expr }
+//		and-expr	:= unary { "and" unary }
+//		unary		:= "not" unary | "(" expr ")" | field op value
+class FilterCompiler {
+	ChangesetFilter &	filter;
+	const char *		s;
+	std::string &		error;
+
+	void skipSpace()
+	{
+		while ( isspace( *s ) )
+			++s;
+	}
+
+	// Consumes a keyword if it is next, ignoring case
+	bool keyword( const char * word )
+	{
+		skipSpace();
+		size_t len = strlen( word );
+		if ( strncasecmp( s, word, len ) != 0 || isalnum( s[len] ) || s[len] == '_' )
+			return false;
+		s += len;
+		return true;
+	}
+
+	bool fail( const char * message )
+	{
+		if ( error.size() == 0 ) {
+			error = message;
+			error += *s ? std::string(" at '") + s + "'" : " at end of filter";
+		}
+		return false;
+	}
+
+	// A quoted string, or a run of characters up to a space or parenthesis
+	bool value( std::string & text )
+	{
+		skipSpace();
+		text.clear();
+		if ( *s == '"' ) {
+			for ( ++s; *s != '"'; ++s ) {
+				if ( *s == '\0' )
+					return fail( "Missing closing quote" );
+				if ( *s == '\\' && s[1] != '\0' )
+					++s;
+				text += *s;
+			}
+			++s;
+			return true;
+		}
+		while ( *s && !isspace( *s ) && *s != '(' && *s != ')' )
+			text += *s++;
+		return text.size() > 0 || fail( "Expected a value" );
+	}
+
+	int add( const ChangesetFilter::Node & node )
+	{
+		filter.nodes.push_back( node );
+		return (int)filter.nodes.size() - 1;
+	}
+
+	int binary( ChangesetFilter::NodeType type, int left, int right )
+	{
+		ChangesetFilter::Node node = { type, left, right, 0, 0, "", 0.0, "" };
+		return add( node );
+	}
+
+	int comparison()
+	{
+		skipSpace();
+		const char * name = s;
+		while ( isalnum( *s ) || *s == '_' )
+			++s;
+		std::string fieldName( name, s - name );
+		std::string key;
+		int field = -1;
+		for ( const auto &f: fieldNames ) {
+			if ( fieldName == f.name )
+				field = f.field;
+		}
+		if ( fieldName == "tag" && *s == ':' ) {
+			// any other tag, by its key, which runs up to a space or an operator
+			const char * keyStart = s + 1;
+			for ( ++s; *s && !isspace( *s ) && !strchr( "=!<>^~()", *s ); ++s )
+				key += *s;
+			for ( const auto &tag: parsedTags ) {
+				if ( key == tag.key ) {
+					s = keyStart;
+					std::string message = std::string( "Use the " ) + tag.field + " field for the " + tag.key + " tag";
+					fail( message.c_str() );
+					return -1;
+				}
+			}
+			if ( key.size() > 0 )
+				field = FIELD_TAG;
+		}
+		if ( field < 0 ) {
+			s = name;
+			fail( "Expected a field name" );
+			return -1;
+		}
+
+		skipSpace();
+		int op = -1;
+		for ( const auto &o: opNames ) {
+			if ( strncmp( s, o.name, strlen( o.name ) ) == 0 ) {
+				op = o.op;
+				s += strlen( o.name );
+				break;
+			}
+		}
+		if ( op < 0 ) {
+			fail( "Expected a comparison operator" );
+			return -1;
+		}
+
+		ChangesetFilter::Node node = { ChangesetFilter::NODE_COMPARE, -1, -1, field, op, "", 0.0, key };
+		if ( !value( node.text ) )
+			return -1;
+		if ( IsNumeric( field ) ) {
+			if ( op == OP_PREFIX || op == OP_CONTAINS ) {
+				fail( "String operator used with a number" );
+				return -1;
+			}
+			char * end;
+			node.number = strtod( node.text.c_str(), &end );
+			if ( *end != '\0' ) {
+				fail( "Expected a number" );
+				return -1;
+			}
+		}
+		return add( node );
+	}
+
+	int unary()
+	{
+		if ( keyword( "not" ) ) {
+			int child = unary();
+			return child < 0 ? -1 : binary( ChangesetFilter::NODE_NOT, child, -1 );
+		}
+		skipSpace();
+		if ( *s == '(' ) {
+			++s;
+			int child = expression();
+			skipSpace();
+			if ( child < 0 )
+				return -1;
+			if ( *s != ')' ) {
+				fail( "Expected ')'" );
+				return -1;
+			}
+			++s;
+			return child;
+		}
+		return comparison();
+	}
+
+	int conjunction()
+	{
+		int left = unary();
+		while ( left >= 0 && keyword( "and" ) ) {
+			int right = unary();
+			left = right < 0 ? -1 : binary( ChangesetFilter::NODE_AND, left, right );
+		}
+		return left;
+	}
+
+	int expression()
+	{
+		int left = conjunction();
+		while ( left >= 0 && keyword( "or" ) ) {
+			int right = conjunction();
+			left = right < 0 ? -1 : binary( ChangesetFilter::NODE_OR, left, right );
+		}
+		return left;
+	}
+
+public:
+	FilterCompiler( ChangesetFilter & filter, const char * text, std::string & error )
+		: filter(filter), s(text), error(error) {}
+
+	bool compile()
+	{
+		skipSpace();
+		if ( *s == '\0' )
+			return true;
+		int root = expression();
+		skipSpace();
+		if ( root >= 0 && *s != '\0' )
+			return fail( "Unexpected text" );
+		filter.root = root;
+		return root >= 0;
+	}
+};
+
+bool ChangesetFilter::compile( const std::string & expression, std::string & error )
+{
+	nodes.clear();
+	root = -1;
+	keys.clear();
+	hashtags = false;
+	error.clear();
+	if ( !FilterCompiler( *this, expression.c_str(), error ).compile() ) {
+		nodes.clear();
+		root = -1;
+		canonical.clear();
+		keys.clear();
+		hashtags = false;
+		return false;
+	}
+	canonical = empty() ? "" : describe( root );
+	for ( const auto &node: nodes ) {
+		if ( node.type == NODE_COMPARE && node.field == FIELD_TAG &&
+			std::find( keys.begin(), keys.end(), node.key ) == keys.end() )
+			keys.push_back( node.key );
+		if ( node.type == NODE_COMPARE && node.field == FIELD_HASHTAGS )
+			hashtags = true;
+	}
+	return true;
+}
+
+std::string ChangesetFilter::describe( int index ) const
+{
+	const Node & node = nodes[index];
+	switch ( node.type ) {
+		case NODE_AND:
+			return "(" + describe( node.left ) + " and " + describe( node.right ) + ")";
+		case NODE_OR:
+			return "(" + describe( node.left ) + " or " + describe( node.right ) + ")";
+		case NODE_NOT:
+			return "not " + describe( node.left );
+		default:
+			break;
+	}
+	std::string text = node.field == FIELD_TAG ? "tag:" + node.key : "";
+	for ( const auto &f: fieldNames ) {
+		if ( f.field == node.field )
+			text = f.name;
+	}
+	for ( const auto &o: opNames ) {
+		if ( o.op == node.op )
+			text = text + " " + o.name + " ";
+	}
+	text += "\"";
+	for ( char c: node.text ) {
+		if ( c == '"' || c == '\\' )
+			text += '\\';
+		text += c;
+	}
+	return text + "\"";
+}
+
+FilterResult ChangesetFilter::evaluate( int index, const Changeset & changeset, bool attributesOnly ) const
+{
+	const Node & node = nodes[index];
+	switch ( node.type ) {
+		case NODE_AND: {
+			FilterResult left = evaluate( node.left, changeset, attributesOnly );
+			if ( left == FILTER_REJECT )
+				return FILTER_REJECT;
+			FilterResult right = evaluate( node.right, changeset, attributesOnly );
+			if ( right == FILTER_REJECT )
+				return FILTER_REJECT;
+			return left == FILTER_ACCEPT && right == FILTER_ACCEPT ? FILTER_ACCEPT : FILTER_UNKNOWN;
+		}
+		case NODE_OR: {
+			FilterResult left = evaluate( node.left, changeset, attributesOnly );
+			if ( left == FILTER_ACCEPT )
+				return FILTER_ACCEPT;
+			FilterResult right = evaluate( node.right, changeset, attributesOnly );
+			if ( right == FILTER_ACCEPT )
+				return FILTER_ACCEPT;
+			return left == FILTER_REJECT && right == FILTER_REJECT ? FILTER_REJECT : FILTER_UNKNOWN;
+		}
+		case NODE_NOT: {
+			FilterResult child = evaluate( node.left, changeset, attributesOnly );
+			if ( child == FILTER_UNKNOWN )
+				return FILTER_UNKNOWN;
+			return child == FILTER_ACCEPT ? FILTER_REJECT : FILTER_ACCEPT;
+		}
+		case NODE_COMPARE:
+			break;
+	}
+
+	if ( attributesOnly && IsTag( node.field ) )
+		return FILTER_UNKNOWN;
+
+	bool match;
+	if ( IsNumeric( node.field ) ) {
+		match = Compare( node.op, NumberField( node.field, changeset ), node.number );
+	} else {
+		const std::string & value = StringField( node.field, node.key, changeset );
+		if ( node.op == OP_PREFIX ) {
+			match = value.compare( 0, node.text.size(), node.text ) == 0;
+		} else if ( node.op == OP_CONTAINS ) {
+			match = value.find( node.text ) != std::string::npos;
+		} else {
+			match = Compare( node.op, value, node.text );
+		}
+	}
+	return match ? FILTER_ACCEPT : FILTER_REJECT;
+}
+
+FilterResult ChangesetFilter::evaluateAttributes( const Changeset & changeset ) const
+{
+	if ( empty() )
+		return FILTER_ACCEPT;
+	return evaluate( root, changeset, true );
+}
+
+bool ChangesetFilter::accepts( const Changeset & changeset ) const
+{
+	if ( empty() )
+		return true;
+	return evaluate( root, changeset, false ) == FILTER_ACCEPT;
+}
+
+// Changesets are numbered as they are passed on, so derived values (see DerivedValues.hpp)
+// know when they need to be computed again
+static unsigned long g_Generation = 0;
+
+// Adds the reader to the group for its filter, creating the group if necessary
+bool FilteredReaders::addToGroup( std::vector<Group> & groups, ChangesetReader * reader )
+{
+	ChangesetFilter readerFilter;
+	const char * text = reader->filter();
+	if ( text != NULL ) {
+		std::string error;
+		if ( !readerFilter.compile( text, error ) ) {
+			fprintf( stderr, "Bad reader filter '%s': %s\n", text, error.c_str() );
+			return false;
+		}
+	}
+
+	// share the evaluation with other readers that have the same filter
+	for ( auto &group: groups ) {
+		if ( group.filter.text() == readerFilter.text() ) {
+			group.readers.push_back( reader );
+			return true;
+		}
+	}
+	Group group;
+	group.filter = readerFilter;
+	group.readers.push_back( reader );
+	group.state = FILTER_UNKNOWN;
+	groups.push_back( group );
+	return true;
+}
+
+bool FilteredReaders::add( ChangesetReader * reader )
+{
+	for ( auto stage: reader->stages() ) {
+		if ( std::find( stages.begin(), stages.end(), stage ) != stages.end() )
+			continue;
+		if ( !addToGroup( stageGroups, stage ) )
+			return false;
+		stages.push_back( stage );
+	}
+	if ( !addToGroup( groups, reader ) )
+		return false;
+	readers.push_back( reader );
+	return true;
+}
+
+// The keys of the tag:<key> comparisons of the filters, which the parser has to keep
+std::vector<std::string> FilteredReaders::tagKeys() const
+{
+	std::vector<std::string> keys = filter.tagKeys();
+	for ( auto list: { &stageGroups, &groups } ) {
+		for ( const auto &group: *list ) {
+			for ( const auto &key: group.filter.tagKeys() ) {
+				if ( std::find( keys.begin(), keys.end(), key ) == keys.end() )
+					keys.push_back( key );
+			}
+		}
+	}
+	return keys;
+}
+
+bool FilteredReaders::acceptsAttributes( const Changeset & changeset )
+{
+	FilterResult global = filter.evaluateAttributes( changeset );
+	bool wanted = false;
+	for ( auto list: { &stageGroups, &groups } ) {
+		for ( auto &group: *list ) {
+			if ( global == FILTER_REJECT ) {
+				group.state = FILTER_REJECT;
+				continue;
+			}
+			group.state = group.filter.evaluateAttributes( changeset );
+			if ( group.state != FILTER_REJECT )
+				wanted = true;
+		}
+	}
+	return wanted;
+}
+
+// Stages see each changeset before the readers that depend on them
+void FilteredReaders::process( const Changeset & changeset )
+{
+	if ( !filter.accepts( changeset ) )
+		return;
+	g_Users.update( changeset.uid, changeset.user );
+	changeset.generation = ++g_Generation;
+	for ( auto list: { &stageGroups, &groups } ) {
+		for ( const auto &group: *list ) {
+			if ( group.state == FILTER_REJECT )
+				continue;
+			if ( group.state == FILTER_UNKNOWN && !group.filter.accepts( changeset ) )
+				continue;
+			for ( auto reader: group.readers ) {
+				reader->process( changeset );
+			}
+		}
+	}
+}
+
+void FilteredReaders::retract( const Changeset & changeset )
+{
+	if ( !filter.accepts( changeset ) )
+		return;
+	changeset.generation = ++g_Generation;
+	for ( auto list: { &stageGroups, &groups } ) {
+		for ( const auto &group: *list ) {
+			if ( !group.filter.accepts( changeset ) )
+				continue;
+			for ( auto reader: group.readers ) {
+				reader->retract( changeset );
+			}
+		}
+	}
+}
+
+void FilteredReaders::initialize()
+{
+	for ( auto stage: stages ) {
+		stage->initialize();
+	}
+	for ( auto reader: readers ) {
+		reader->initialize();
+	}
+}
+
+void FilteredReaders::setSampleRate( double rate )
+{
+	for ( auto stage: stages ) {
+		stage->sampleRate = rate;
+	}
+	for ( auto reader: readers ) {
+		reader->sampleRate = rate;
+	}
+}
+
+// Readers are independent once processing is done, so they finalize in parallel.
+// Each writes into its own buffer and the buffers are printed in registration order,
+// so the report is the same as if they had run one after another.
+//
+// Stages are finalized first, since the readers that depend on them may use their results.
+void FilteredReaders::finalize()
+{
+	for ( auto stage: stages ) {
+		stage->finalize();
+	}
+
+	std::vector<char *> text( readers.size() );
+	std::vector<size_t> length( readers.size() );
+	for ( size_t i = 0; i < readers.size(); ++i ) {
+		FILE * buffer = open_memstream( &text[i], &length[i] );
+		if ( buffer )
+			readers[i]->out = buffer;
+	}
+	ParallelFor( readers.size(), [&]( size_t i ) {
+		readers[i]->finalize();
+	});
+	for ( size_t i = 0; i < readers.size(); ++i ) {
+		if ( readers[i]->out == stdout )
+			continue;
+		fclose( readers[i]->out );
+		readers[i]->out = stdout;
+		fwrite( text[i], 1, length[i], stdout );
+		free( text[i] );
+		if ( readers[i]->sampleRate < 1.0 && !readers[i]->scalesSamples() )
+			printf( "(from a %.3g%% sample of the changesets, not scaled to the whole input)\n", 100.0 * readers[i]->sampleRate );
+	}
+	fflush( stdout );
+}
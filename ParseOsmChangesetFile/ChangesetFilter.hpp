@@ -0,0 +1,120 @@
+//
+//  ChangesetFilter.hpp
+//  ParseOsmChangesetFile
+//
+//  Created by Bryce Cogswell on 10/18/26.
+//  Copyright © 2026 Bryce Cogswell. All rights reserved.
+//
+
+#ifndef ChangesetFilter_hpp
+#define ChangesetFilter_hpp
+
+#include <string>
+#include <vector>
+
+class Changeset;
+class ChangesetReader;
+
+enum FilterResult { FILTER_REJECT, FILTER_ACCEPT, FILTER_UNKNOWN };
+
+// A predicate on changesets, compiled once from an expression such as
+//		application = "Go Map!!" and (date >= 2023-01-01 or uid = 1234)
+//
+// Fields are id, uid, user, date, changes, min_lat, max_lat, min_lon, max_lon (the
+// attributes of <changeset>) and application, created_by, comment, locale, quest_type,
+// hashtags (from its tags). Any other tag is compared as tag:<key>, e.g. tag:imagery_used ~ Bing,
+// and is empty when the changeset doesn't have it. The tags with fields of their own
+// can't be compared as tag:<key>. Operators are = != < <= > >= along
+// with ^= (starts with) and ~ (contains) for strings. Comparisons combine with and, or,
+// not and parentheses.
+//
+// The parser only keeps the tags that filters ask for, and ChangesetStore doesn't keep
+// them or hashtags at all, so neither can be used on stored changesets (see usesTags()).
+class ChangesetFilter {
+private:
+	enum NodeType { NODE_AND, NODE_OR, NODE_NOT, NODE_COMPARE };
+	struct Node {
+		NodeType		type;
+		int				left, right;	// children, for and/or/not
+		int				field;			// for comparisons
+		int				op;
+		std::string		text;
+		double			number;
+		std::string		key;			// for tag:<key>
+	};
+	std::vector<Node>	nodes;
+	int					root;
+	std::string			canonical;
+	std::vector<std::string>	keys;	// of the tag:<key> comparisons
+	bool				hashtags = false;	// whether it compares hashtags
+
+	FilterResult evaluate( int node, const Changeset & changeset, bool attributesOnly ) const;
+	std::string describe( int node ) const;
+	friend class FilterCompiler;
+public:
+	ChangesetFilter() : root(-1) {}
+
+	// Returns false and sets error if the expression is malformed. An empty expression accepts everything.
+	bool compile( const std::string & expression, std::string & error );
+
+	bool empty() const						{ return root < 0; }
+
+	// A normalized form of the expression, so equivalent filters can be recognized
+	const std::string & text() const		{ return canonical; }
+
+	// The keys compared with tag:<key>, which only changesets fresh from the parser have
+	const std::vector<std::string> & tagKeys() const	{ return keys; }
+	// Whether it compares tags that stored changesets don't keep: tag:<key> or hashtags
+	bool usesTags() const					{ return keys.size() > 0 || hashtags; }
+
+	// Evaluates the filter using only the attributes of the changeset, so it can be
+	// done before the tags are parsed. Comparisons on tags are FILTER_UNKNOWN.
+	FilterResult evaluateAttributes( const Changeset & changeset ) const;
+
+	bool accepts( const Changeset & changeset ) const;
+};
+
+// Readers grouped by their filter, so readers with the same filter share one evaluation,
+// and changesets that no reader wants can be recognized before their tags are parsed.
+//
+// Stages that readers depend on (see ChangesetReader::stages) are added along with them,
+// once however many readers use them.
+class FilteredReaders {
+private:
+	struct Group {
+		ChangesetFilter					filter;
+		std::vector<ChangesetReader *>	readers;
+		FilterResult					state;		// result for the current changeset
+	};
+	std::vector<Group>				groups;
+	std::vector<Group>				stageGroups;
+	std::vector<ChangesetReader *>	readers;	// in the order they were added
+	std::vector<ChangesetReader *>	stages;
+	ChangesetFilter					filter;		// applies to every reader
+
+	bool addToGroup( std::vector<Group> & groups, ChangesetReader * reader );
+public:
+	// Returns false if the filter of the reader or one of its stages doesn't compile
+	bool add( ChangesetReader * reader );
+	void setFilter( const ChangesetFilter & filter )	{ this->filter = filter; }
+
+	// The tags the parser must keep in Changeset::tags for the filters
+	std::vector<std::string> tagKeys() const;
+
+	// Returns false if no reader can want the changeset, whatever its tags turn out to be.
+	// Must be called for each changeset before process().
+	bool acceptsAttributes( const Changeset & changeset );
+
+	// Passes the changeset to the readers whose filters accept it
+	void process( const Changeset & changeset );
+	// Passes an earlier version of a changeset to retract() of the readers whose filters accept it
+	void retract( const Changeset & changeset );
+
+	void initialize();
+	void finalize();
+
+	// Sets the sampleRate of every reader and stage
+	void setSampleRate( double rate );
+};
+
+#endif /* ChangesetFilter_hpp */
@@ -6,67 +6,49 @@
 //  Copyright © 2023 Bryce Cogswell. All rights reserved.
 //
 
+#include <algorithm>
 #include <map>
 #include <string>
+#include <string.h>
+#include <math.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
 
 #include "ChangesetParser.hpp"
 
 #define PRINT_UNUSED_TAGS	0
 
-static std::string FixEditorName( const std::string & origString )
-{
-	static const char * const names[] = {
-		"Go Map!!",
-		"Paint The Town Red",
-		"Every Door",
-		"MAPS.ME",
-		"OsmAnd",
-		"Organic Maps",
-		"OMaps",
-		"StreetComplete",
-	};
-
-	// Some apps needs to be truncated earlier than the version number
-	const char * orig = origString.c_str();
-	for ( int i = 0; i < sizeof names/sizeof names[0]; ++i ) {
-		const char * name = names[i];
-		if ( memcmp( orig, name, strlen(name) ) == 0 )
-			return name;
-	}
-
-	// truncate at version number:
-	//    ' 1'
-	//    '/1'
-	//    '-1'
-	//    ' v1'
-	for ( const char * s = orig+1; *s; ++s ) {
-		if ( s[0] == ' ' || (s[0] == '/' && s[-1] != '/') || s[0] == '-' ) {
-			if ( isdigit(s[1]) || (s[1] == 'v' && isdigit(s[2])) ) {
-				return origString.substr(0,s-orig);
-			}
-		}
-	}
+long ChangesetParser::defaultErrorBudget = 0;
 
-	return origString;
+std::string ChangesetReader::scaledCount( long count ) const
+{
+	if ( sampleRate < 1.0 )
+		return ScaleCount( count, sampleRate ).format();
+	return std::to_string( count );
 }
 
-
 static bool IsIdent( char c )
 {
 	return isalnum( c ) || c == '_' || c == '?';
 }
 
+// The scanners below never look at end or beyond, so a truncated file can't make them run past the input
+
 // Parses a key: changeset
-static bool GetKey( const char *& s, const char *& k, int & klen )
+static bool GetKey( const char *& s, const char * end, const char *& k, int & klen )
 {
 	const char * p = s;
-	while ( isspace( *p ) )
+	while ( p < end && isspace( *p ) )
 		++p;
-	if ( !isalpha( *p ) && *p != '?' && *p != '/' )
+	if ( p >= end || (!isalpha( *p ) && *p != '?' && *p != '/') )
 		return false;
 	// get key
 	k = p++;
-	while ( IsIdent( *p ) )
+	while ( p < end && IsIdent( *p ) )
 		++p;
 	klen = (int)(p - k);
 	s = p;
@@ -74,16 +56,17 @@ static bool GetKey( const char *& s, const char *& k, int & klen )
 }
 
 // Parses a quoted string: "JOSM 1.2"
-static bool GetValue( const char *& s, const char *& v, int & vlen )
+static bool GetValue( const char *& s, const char * end, const char *& v, int & vlen )
 {
 	const char * p = s;
-	while ( isspace( *p ))
+	while ( p < end && isspace( *p ))
 		++p;
-	if ( *p++ != '"' )
+	if ( p >= end || *p++ != '"' )
 		return false;
 	v = p;
-	while ( *p != '"' )
-		++p;
+	p = (const char *)memchr( p, '"', end - p );
+	if ( p == NULL )
+		return false;
 	vlen = (int)(p - v);
 	++p; // closing quote
 
@@ -93,30 +76,30 @@ static bool GetValue( const char *& s, const char *& v, int & vlen )
 
 // Parses strings in the form:
 // 		k="created_by"
-static bool GetKeyValue( const char *& s, const char *& k, int & klen, const char *& v, int & vlen )
+static bool GetKeyValue( const char *& s, const char * end, const char *& k, int & klen, const char *& v, int & vlen )
 {
 	const char * p = s;
-	if ( !GetKey( p, k, klen ) )
+	if ( !GetKey( p, end, k, klen ) )
 		return false;
 
 	// get =
-	while (isspace( *p ))
+	while ( p < end && isspace( *p ))
 		++p;
-	if ( *p++ != '=' )
+	if ( p >= end || *p++ != '=' )
 		return false;
 
-	if ( !GetValue(p, v, vlen ) )
+	if ( !GetValue(p, end, v, vlen ) )
 		return false;
 
 	s = p;
 	return true;
 }
 
-static bool GetOpeningBracket( const char *& s )
+static bool GetOpeningBracket( const char *& s, const char * end )
 {
-	while ( isspace(*s))
+	while ( s < end && isspace(*s))
 		++s;
-	if ( *s == '<' ) {
+	if ( s < end && *s == '<' ) {
 		++s;
 		return true;
 	}
@@ -124,15 +107,15 @@ static bool GetOpeningBracket( const char *& s )
 }
 
 
-static bool GetClosingBracket( const char *& s )
+static bool GetClosingBracket( const char *& s, const char * end )
 {
-	while ( isspace( *s ) )
+	while ( s < end && isspace( *s ) )
 		++s;
-	if ( (s[0] == '/' || s[0] == '?') && s[1] == '>' ) {
+	if ( s + 1 < end && (s[0] == '/' || s[0] == '?') && s[1] == '>' ) {
 		s += 2;
 		return true;
 	}
-	if ( *s == '>' ) {
+	if ( s < end && *s == '>' ) {
 		++s;
 		return true;
 	}
@@ -140,62 +123,210 @@ static bool GetClosingBracket( const char *& s )
 }
 
 
-static std::string UnescapeString( const char * s, int len )
+// Returns the first '&' in the range, or end if there isn't one
+static const char * FindAmpersand( const char * s, const char * end )
 {
-	if ( memchr( s, '&', len ) == NULL ) {
-		return std::string( s, len );
+#if defined(__SSE2__)
+	const __m128i amp = _mm_set1_epi8( '&' );
+	while ( end - s >= 16 ) {
+		int mask = _mm_movemask_epi8( _mm_cmpeq_epi8( _mm_loadu_si128( (const __m128i *)s ), amp ) );
+		if ( mask )
+			return s + __builtin_ctz( mask );
+		s += 16;
 	}
+#elif defined(__ARM_NEON)
+	const uint8x16_t amp = vdupq_n_u8( '&' );
+	while ( end - s >= 16 ) {
+		uint8x16_t eq = vceqq_u8( vld1q_u8( (const uint8_t *)s ), amp );
+		// narrow the comparison to 4 bits per byte so it fits in a 64-bit mask
+		uint64_t mask = vget_lane_u64( vreinterpret_u64_u8( vshrn_n_u16( vreinterpretq_u16_u8( eq ), 4 ) ), 0 );
+		if ( mask )
+			return s + (__builtin_ctzll( mask ) >> 2);
+		s += 16;
+	}
+#endif
+	while ( s < end && *s != '&' )
+		++s;
+	return s;
+}
 
-	std::string dst;
-	const char * end = s + len;
-	while ( s < end ) {
-		if ( *s == '&' ) {
-			if ( memcmp( s+1, "quot;", 5 ) == 0 ) {
-				dst += '"';
-				s += 5;
-			} else if ( memcmp( s+1, "apos;", 5) == 0 ) {
-				dst += '\'';
-				s += 5;
-			} else if ( memcmp( s+1, "lt;", 3) == 0 ) {
-				dst += '<';
-				s += 3;
-			} else if ( memcmp( s+1, "gt;", 3) == 0 ) {
-				dst += '>';
-				s += 3;
-			} else if ( memcmp( s+1, "amp;", 4) == 0 ) {
-				dst += '&';
-				s += 4;
+// Writes the UTF-8 encoding of a code point and returns its length
+static int EncodeUtf8( unsigned long c, char * dst )
+{
+	if ( c < 0x80 ) {
+		dst[0] = (char)c;
+		return 1;
+	} else if ( c < 0x800 ) {
+		dst[0] = (char)(0xC0 | (c >> 6));
+		dst[1] = (char)(0x80 | (c & 0x3F));
+		return 2;
+	} else if ( c < 0x10000 ) {
+		dst[0] = (char)(0xE0 | (c >> 12));
+		dst[1] = (char)(0x80 | ((c >> 6) & 0x3F));
+		dst[2] = (char)(0x80 | (c & 0x3F));
+		return 3;
+	} else {
+		dst[0] = (char)(0xF0 | (c >> 18));
+		dst[1] = (char)(0x80 | ((c >> 12) & 0x3F));
+		dst[2] = (char)(0x80 | ((c >> 6) & 0x3F));
+		dst[3] = (char)(0x80 | (c & 0x3F));
+		return 4;
+	}
+}
+
+// Decodes the entity at s, which points at a '&'. Returns the number of characters
+// consumed and sets dlen to the number of bytes written, or returns 0 if it isn't a valid entity.
+static int DecodeEntity( const char * s, const char * end, char * dst, int & dlen )
+{
+	static const struct { const char * name; int len; char c; } named[] = {
+		{ "&quot;",	6, '"' },
+		{ "&apos;",	6, '\'' },
+		{ "&lt;",	4, '<' },
+		{ "&gt;",	4, '>' },
+		{ "&amp;",	5, '&' },
+	};
+	long avail = end - s;
+	if ( avail >= 4 && s[1] == '#' ) {
+		// numeric character reference: &#10; or &#x1F600;
+		const char * p = s + 2;
+		bool hex = false;
+		if ( *p == 'x' || *p == 'X' ) {
+			hex = true;
+			++p;
+		}
+		const char * digits = p;
+		unsigned long c = 0;
+		while ( p < end && c <= 0x10FFFF ) {
+			int d;
+			if ( *p >= '0' && *p <= '9' ) {
+				d = *p - '0';
+			} else if ( hex && *p >= 'a' && *p <= 'f' ) {
+				d = *p - 'a' + 10;
+			} else if ( hex && *p >= 'A' && *p <= 'F' ) {
+				d = *p - 'A' + 10;
 			} else {
-				dst += *s;
+				break;
 			}
+			c = c * (hex ? 16 : 10) + d;
+			++p;
+		}
+		if ( p == digits || p >= end || *p != ';' )
+			return 0;
+		if ( c > 0x10FFFF || (c >= 0xD800 && c <= 0xDFFF) )
+			return 0;
+		// the encoding is never longer than the reference, so decoding can be done in place
+		dlen = EncodeUtf8( c, dst );
+		return (int)(p + 1 - s);
+	}
+	for ( const auto &entity: named ) {
+		if ( avail >= entity.len && memcmp( s, entity.name, entity.len ) == 0 ) {
+			dst[0] = entity.c;
+			dlen = 1;
+			return entity.len;
+		}
+	}
+	return 0;
+}
+
+// Decodes XML entities into dst, which must have room for len bytes.
+// Returns the length of the decoded string.
+static int DecodeXmlString( const char * s, int len, char * dst )
+{
+	const char * end = s + len;
+	char * d = dst;
+	for (;;) {
+		// copy everything up to the next entity in bulk
+		const char * amp = FindAmpersand( s, end );
+		memcpy( d, s, amp - s );
+		d += amp - s;
+		s = amp;
+		if ( s == end )
+			break;
+
+		int dlen;
+		int slen = DecodeEntity( s, end, d, dlen );
+		if ( slen > 0 ) {
+			s += slen;
+			d += dlen;
 		} else {
-			dst += *s;
+			// not an entity we recognize, so copy it through
+			*d++ = *s++;
 		}
-		++s;
 	}
+	return (int)(d - dst);
+}
+
+// Decodes into an existing string, reusing its storage
+static void UnescapeString( const char * s, int len, std::string & dst )
+{
+	dst.resize( len );
+	dst.resize( DecodeXmlString( s, len, &dst[0] ) );
+}
+
+static std::string UnescapeString( const char * s, int len )
+{
+	std::string dst;
+	UnescapeString( s, len, dst );
 	return dst;
 }
 
 static bool IsEqual( const char * s1, int len, const char * s2 )
 {
-	return memcmp( s1, s2, len ) == 0 && s2[len] == 0;
+	return strlen( s2 ) == (size_t)len && memcmp( s1, s2, len ) == 0;
+}
+
+// Returns the first occurrence of key in [s, end), or NULL
+static const char * FindText( const char * s, const char * end, const char * key )
+{
+	size_t keylen = strlen( key );
+	while ( s + keylen <= end ) {
+		s = (const char *)memchr( s, key[0], end - s );
+		if ( s == NULL || s + keylen > end )
+			return NULL;
+		if ( memcmp( s, key, keylen ) == 0 )
+			return s;
+		++s;
+	}
+	return NULL;
+}
+
+// Skips changesets before the start date, looking only at their created_at attribute.
+// Returns the first changeset at or after the date, or end if there isn't one.
+static const char * SkipToDate( const char * s, const char * end, const std::string & startDate )
+{
+	const char * key = "<changeset ";
+	const char * attr = "created_at=\"";
+	size_t attrlen = strlen( attr );
+	size_t datelen = std::min( startDate.size(), (size_t)10 );
+	for ( s = FindText( s, end, key ); s != NULL; ) {
+		const char * next = FindText( s + 1, end, key );
+		const char * date = FindText( s, next ? next : end, attr );
+		if ( date && date + attrlen + datelen <= end ) {
+			if ( memcmp( date + attrlen, startDate.data(), datelen ) >= 0 )
+				return s;
+		}
+		if ( next == NULL )
+			break;
+		s = next;
+	}
+	return end;
 }
 
-static bool IgnoreTag( const char *&s2, const char * tag )
+static bool IgnoreTag( const char *&s2, const char * end, const char * tag )
 {
 	const char * s = s2;
 	const char * key, *val;
 	int klen, vlen;
 
-	if ( !GetOpeningBracket(s))
+	if ( !GetOpeningBracket( s, end ))
 		return false;
-	if ( !GetKey( s, key, klen ) )
+	if ( !GetKey( s, end, key, klen ) )
 		return false;
 	if ( !IsEqual( key, klen, tag ) )
 		return false;
-	while ( GetKeyValue( s, key, klen, val, vlen) )
+	while ( GetKeyValue( s, end, key, klen, val, vlen) )
 		continue;
-	if ( !GetClosingBracket( s ))
+	if ( !GetClosingBracket( s, end ))
 		return false;
 
 	s2 = s;
@@ -212,49 +343,55 @@ static void extraTag(const char * key, int klen)
 }
 #endif
 
-ChangesetParser::ParseStatus ChangesetParser::parseChangeset( const char *& s, Changeset & changeset )
+ChangesetParser::ParseStatus ChangesetParser::parseChangeset( const char *& s, const char * end, Changeset & changeset, bool applyFilters )
 {
 	const char *key, *val, *tag;
 	int klen, vlen, taglen;
 
 	changeset.min_lat = changeset.max_lat = changeset.min_lon = changeset.max_lon = 0.0;
-	changeset.date = "";
-	changeset.user = "";
-	changeset.application = "";
-	changeset.comment = "";
+	changeset.hasBox = false;
+	changeset.date.clear();
+	changeset.user.clear();
+	changeset.application.clear();
+	changeset.applicationRaw.clear();
+	changeset.comment.clear();
+	changeset.locale.clear();
 	changeset.ident = 0;
 	changeset.uid = 0;
 	changeset.editCount = 0;
-	changeset.quest_type = "";
-
-	if ( !GetOpeningBracket( s ) )
-		return PARSE_ERROR;
-	if ( !GetKey( s, tag, taglen ) )
-		return PARSE_ERROR;
+	changeset.quest_type.clear();
+	changeset.hashtags.clear();
+	changeset.tags.clear();
+
+	if ( !GetOpeningBracket( s, end ) )
+		return parseError( "expected '<'" );
+	if ( !GetKey( s, end, tag, taglen ) )
+		return parseError( "expected an element" );
 	if ( !IsEqual( tag, taglen, "changeset" ) ) {
 		if ( IsEqual( tag, taglen, "/osm" )) {
-			if ( !GetClosingBracket( s )) {
-				return PARSE_ERROR;
+			if ( !GetClosingBracket( s, end )) {
+				return parseError( "unterminated </osm>" );
 			}
 			return PARSE_FINISHED;
 		}
-		return PARSE_ERROR;
+		return parseError( "expected <changeset>" );
 	}
 
 	// iterate over key/values
-	while ( GetKeyValue( s, key, klen, val, vlen ) ) {
+	while ( GetKeyValue( s, end, key, klen, val, vlen ) ) {
 		if ( IsEqual( key, klen, "id" ) ) {
 			changeset.ident = atol( val );
 		} else if ( IsEqual( key, klen, "created_at" ) ) {
-			changeset.date = UnescapeString( val, 10 );
+			changeset.date.assign( val, std::min( vlen, 10 ) );
 		} else if ( IsEqual( key, klen, "user" ) ) {
-			changeset.user = UnescapeString( val, vlen );
+			UnescapeString( val, vlen, changeset.user );
 		} else if ( IsEqual( key, klen, "uid" ) ) {
 			changeset.uid = atoi( val );
 		} else if ( IsEqual( key, klen, "num_changes" ) ) {
 			changeset.editCount = atoi( val );
 		} else if ( IsEqual( key, klen, "min_lat" ) ) {
 			changeset.min_lat = atof( val );
+			changeset.hasBox = true;
 		} else if ( IsEqual( key, klen, "max_lat" ) ) {
 			changeset.max_lat = atof( val );
 		} else if ( IsEqual( key, klen, "min_lon" ) ) {
@@ -268,8 +405,16 @@ ChangesetParser::ParseStatus ChangesetParser::parseChangeset( const char *& s, C
 #endif
 		}
 	}
-	if ( !GetClosingBracket( s ))
-		return PARSE_ERROR;
+	if ( !GetClosingBracket( s, end ))
+		return parseError( "malformed attribute" );
+
+	// Changesets outside a sample of ids are skipped like filtered ones
+	if ( applyFilters && sampling.scheme == SAMPLE_IDS && !IdInSample( changeset.ident, sampling.rate ) )
+		return PARSE_SKIPPED;
+
+	// If no reader can want this changeset then don't bother parsing its tags
+	if ( applyFilters && !readers.acceptsAttributes( changeset ) && s[-2] != '/' )
+		return PARSE_SKIPPED;
 
 	// If this is a 2005-era changeset then it won't contain any additional tags and we're done
 	if ( s[-2] == '/' )
@@ -278,39 +423,48 @@ ChangesetParser::ParseStatus ChangesetParser::parseChangeset( const char *& s, C
 	// iterate over tags
 	for (;;) {
 		// <tag k="created_by" v="JOSM"/>
-		if ( !GetOpeningBracket( s ) )
-			return PARSE_ERROR;
-		if ( !GetKey( s, tag, taglen ) )
-			return PARSE_ERROR;
+		if ( !GetOpeningBracket( s, end ) )
+			return parseError( "expected '<'" );
+		if ( !GetKey( s, end, tag, taglen ) )
+			return parseError( "expected an element" );
 
 		if ( IsEqual( tag, taglen, "tag" )) {
-			if ( !GetKeyValue( s, key, klen, val, vlen ) )
-				return PARSE_ERROR;
-			if ( !IsEqual( key, klen, "k" ) )
-				return PARSE_ERROR;
+			if ( !GetKeyValue( s, end, key, klen, val, vlen ) || !IsEqual( key, klen, "k" ) )
+				return parseError( "malformed tag" );
 			if ( IsEqual( val, vlen, "created_by" )) {
-				if ( GetKeyValue( s, key, klen, val, vlen)) {
+				if ( GetKeyValue( s, end, key, klen, val, vlen )) {
 					if ( IsEqual(key, klen, "v") ) {
-						changeset.applicationRaw = UnescapeString( val, vlen );
-						changeset.application = FixEditorName( changeset.applicationRaw );
+						// most created_by values have been seen before, so check the cache before unescaping
+						const EditorName * editor = editorNames.lookup( val, vlen );
+						if ( editor == NULL ) {
+							editor = &editorNames.insert( val, vlen, UnescapeString( val, vlen ) );
+						}
+						changeset.applicationRaw = editor->raw;
+						changeset.application = editor->name;
 					}
 				}
 			} else if ( IsEqual( val, vlen, "comment" )) {
-				if ( GetKeyValue( s, key, klen, val, vlen)) {
+				if ( GetKeyValue( s, end, key, klen, val, vlen )) {
 					if ( IsEqual(key, klen, "v") ) {
-						changeset.comment = UnescapeString( val, vlen );
+						UnescapeString( val, vlen, changeset.comment );
 					}
 				}
 			} else if ( IsEqual( val, vlen, "locale" )) {
-				if ( GetKeyValue( s, key, klen, val, vlen)) {
+				if ( GetKeyValue( s, end, key, klen, val, vlen )) {
 					if ( IsEqual(key, klen, "v") ) {
-						changeset.locale = UnescapeString( val, vlen );
+						UnescapeString( val, vlen, changeset.locale );
 					}
 				}
 			} else if ( IsEqual( val, vlen, "StreetComplete:quest_type" )) {
-				if ( GetKeyValue( s, key, klen, val, vlen)) {
+				if ( GetKeyValue( s, end, key, klen, val, vlen )) {
 					if ( IsEqual(key, klen, "v") ) {
-						changeset.quest_type = UnescapeString( val, vlen );
+						UnescapeString( val, vlen, changeset.quest_type );
+					}
+				}
+			} else if ( IsEqual( val, vlen, "hashtags" )) {
+				if ( GetKeyValue( s, end, key, klen, val, vlen )) {
+					if ( IsEqual(key, klen, "v") ) {
+						UnescapeString( val, vlen, changeset.hashtags );
 					}
 				}
 
@@ -320,18 +474,26 @@ ChangesetParser::ParseStatus ChangesetParser::parseChangeset( const char *& s, C
 #if PRINT_UNUSED_TAGS
 				extraTag(val, vlen);
 #endif
-				GetKeyValue( s, key, klen, val, vlen );
+				const char * k = val;
+				int kvlen = vlen;
+				if ( GetKeyValue( s, end, key, klen, val, vlen ) && tagKeys.size() > 0 && IsEqual( key, klen, "v" ) ) {
+					// unless a filter compares it
+					for ( const auto &wanted: tagKeys ) {
+						if ( IsEqual( k, kvlen, wanted.c_str() ) )
+							changeset.tags.push_back( std::make_pair( wanted, UnescapeString( val, vlen ) ) );
+					}
+				}
 			}
-			if ( !GetClosingBracket( s )) {
-				return PARSE_ERROR;
+			if ( !GetClosingBracket( s, end )) {
+				return parseError( "malformed tag" );
 			}
 		} else if ( IsEqual( tag, taglen, "/changeset" )) {
-			if ( !GetClosingBracket( s )) {
-				return PARSE_ERROR;
+			if ( !GetClosingBracket( s, end )) {
+				return parseError( "unterminated </changeset>" );
 			}
 			return PARSE_SUCCESS;
 		} else {
-			return PARSE_ERROR;
+			return parseError( "unexpected element in changeset" );
 		}
 	}
 }
@@ -353,7 +515,7 @@ const char * ChangesetParser::searchForStartDate( const char * start, const char
 	// get the changeset at the midpoint
 	Changeset cs;
 	const char * tmpMid = mid;
-	if ( parseChangeset(tmpMid, cs) != PARSE_SUCCESS ) {
+	if ( parseChangeset(tmpMid, end, cs) != PARSE_SUCCESS ) {
 		// give up
 		return start;
 	}
@@ -364,43 +526,225 @@ const char * ChangesetParser::searchForStartDate( const char * start, const char
 	}
 }
 
-bool ChangesetParser::parseXmlString( const char * xml, long len, std::string startDate )
+// binary search for first changeset for startDate, reading small probes of the file
+// rather than requiring the whole file to be in memory
+long ChangesetParser::searchForStartOffset( InputSource & source, long start, long end,
+										   const std::string & targetDate )
 {
-	// get xml initial header
-	const char * s = xml;
-	IgnoreTag( s, "?xml" );
-	IgnoreTag( s, "osm" );
-	IgnoreTag( s, "bound" );
+	const char * key = "<changeset ";
+	size_t keylen = strlen(key);
+	std::vector<char> probe( 64*1024 );
+	for (;;) {
+		// pick midpoint
+		long mid = start + (end - start)/2;
+		long len = source.readAt( mid, &probe[0], probe.size()-1 );
+		if ( len <= 0 )
+			return start;
+		probe[len] = '\0';
+		const char * buf = &probe[0];
+
+		// scan forward for changeset, and make sure the probe holds all of it
+		const char * cs = FindText( buf, buf+len, key );
+		if ( cs == NULL )
+			return start;
+		long csOffset = mid + (cs - buf);
+		if ( csOffset + (long)keylen >= end )
+			return start;
+		if ( FindText( cs+1, buf+len, key ) == NULL && FindText( cs+1, buf+len, "</osm>" ) == NULL )
+			return start;
+
+		// get the changeset at the midpoint
+		Changeset changeset;
+		if ( parseChangeset(cs, buf+len, changeset) != PARSE_SUCCESS ) {
+			// give up
+			return start;
+		}
+		if ( changeset.date < targetDate ) {
+			start = csOffset;
+		} else {
+			end = csOffset;
+		}
+	}
+}
+
+// Returns the offset of the first changeset at or after offset and sets its id,
+// or returns -1 if there isn't one.
+long ChangesetParser::findRecord( InputSource & source, long offset, long & ident )
+{
+	const char * key = "<changeset ";
+	std::vector<char> probe( 64*1024 );
+	for (;;) {
+		long len = source.readAt( offset, &probe[0], probe.size()-1 );
+		if ( len <= 0 )
+			return -1;
+		probe[len] = '\0';
+		const char * buf = &probe[0];
+		const char * cs = FindText( buf, buf+len, key );
+		if ( cs == NULL ) {
+			if ( len < (long)probe.size()-1 || FindText( buf, buf+len, "</osm>" ) )
+				return -1;
+			// keep looking, overlapping in case the key straddles the probes
+			offset += len - strlen(key);
+			continue;
+		}
+		long csOffset = offset + (cs - buf);
+		if ( FindText( cs+1, buf+len, key ) == NULL && FindText( cs+1, buf+len, "</osm>" ) == NULL ) {
+			if ( cs == buf )
+				return -1;	// larger than the probe
+			// read again starting at the changeset so the probe holds all of it
+			offset = csOffset;
+			continue;
+		}
+		Changeset changeset;
+		if ( parseChangeset(cs, buf+len, changeset) != PARSE_SUCCESS )
+			return -1;
+		ident = changeset.ident;
+		return csOffset;
+	}
+}
 
-	for ( auto reader: readers ) {
-		reader->initialize();
+// Counts the malformed record at the offset, and returns false if that's more than the budget
+bool ChangesetParser::skipMalformed( long offset )
+{
+	++errorTotal;
+	errorCounts[errorReason] += 1;
+	if ( errorList.size() < MAX_ERRORS_KEPT ) {
+		ParseError error = { offset, errorReason };
+		errorList.push_back( error );
+		fprintf( stderr, "Malformed changeset at offset %ld: %s\n", offset, errorReason );
 	}
+	if ( errorTotal > errorBudget ) {
+		if ( errorBudget > 0 )
+			fprintf( stderr, "More than %ld malformed changesets, giving up\n", errorBudget );
+		gaveUp = true;
+		return false;
+	}
+	return true;
+}
 
-	// if a start date is defined then binary search for the changeset at or before it
-	if ( startDate.size() > 0 ) {
-		s = searchForStartDate( s, xml+len, startDate );
+std::string ChangesetParser::errorSummary() const
+{
+	std::string summary = std::to_string( errorTotal ) + " malformed changesets skipped";
+	const char * separator = ": ";
+	for ( const auto &it: errorCounts ) {
+		summary += separator + std::to_string( it.second ) + " " + it.first;
+		separator = ", ";
 	}
+	return summary;
+}
 
-	// iterate over all changesets
+// Parses all changesets in [s, end) and passes them to the readers
+ChangesetParser::ParseStatus ChangesetParser::parseRecords( const char * s, const char * end,
+														   const std::string & startDate, Changeset & changeset )
+{
 	for (;;) {
-		Changeset changeset;
-		auto status = parseChangeset(s, changeset);
+		while ( s < end && isspace( *s ) )
+			++s;
+		if ( s >= end )
+			return PARSE_SUCCESS;
+
+		const char * record = s;
+		auto status = parseChangeset(s, end, changeset, true);
+		changeset.offset = windowOffset + (record - windowStart);
+		changeset.length = s - record;
+		if ( stopIdent >= 0 && (status == PARSE_SUCCESS || status == PARSE_SKIPPED) && changeset.ident >= stopIdent )
+			return PARSE_FINISHED;
 		if ( status == PARSE_SUCCESS ) {
+			if ( endDate.size() > 0 && changeset.date >= endDate )
+				return PARSE_FINISHED;
 			if ( changeset.date >= startDate ) {
-				for ( auto reader = readers.begin(); reader != readers.end(); ++reader ) {
-					(*reader)->process( changeset );
-				}
+				readers.process( changeset );
+				++processedCount;
 			}
-		} else if ( status == PARSE_FINISHED ) {
-			break;
-		} else { // PARSE_ERROR
-			return false;
+		} else if ( status == PARSE_SKIPPED ) {
+			if ( s[-2] == '/' )
+				continue;	// it has no tags
+			const char * close = FindText( s, end, "</changeset>" );
+			if ( close != NULL ) {
+				s = close + strlen( "</changeset>" );
+				continue;
+			}
+			status = parseError( "unterminated changeset" );
+		}
+		if ( status == PARSE_ERROR ) {
+			if ( !skipMalformed( changeset.offset ) )
+				return PARSE_ERROR;
+			// resynchronize at the next changeset
+			s = FindText( record + 1, end, "<changeset " );
+			if ( s == NULL )
+				return PARSE_SUCCESS;
+		} else if ( status != PARSE_SUCCESS && status != PARSE_SKIPPED ) {
+			return status;
 		}
 	}
+}
 
-	for ( auto reader: readers ) {
-		reader->finalize();
+// Divides [begin, end) into strata and parses the changesets whose records start in a run of
+// sampling.runBytes at the same hashed position in each, so the amount read falls with the rate.
+ChangesetParser::ParseStatus ChangesetParser::parseSampleRuns( InputSource & source, long begin, long end,
+															  const std::string & startDate, Changeset & changeset )
+{
+	long span = end - begin;
+	long runs = std::max( 1L, (long)ceil( span * sampling.rate / sampling.runBytes ) );
+	double stride = (double)span / runs;
+	std::vector<char> buffer;
+	auto status = PARSE_SUCCESS;
+	for ( long run = 0; run < runs && status == PARSE_SUCCESS; ++run ) {
+		long stratum = begin + (long)(run * stride);
+		long stratumEnd = run == runs - 1 ? end : begin + (long)((run + 1) * stride);
+		long runLength = std::min( (long)ceil( stride * sampling.rate ), stratumEnd - stratum );
+		long runStart = stratum + (long)(SampleHash( run ) * (stratumEnd - stratum - runLength));
+		long runEnd = runStart + runLength;
+		long processedBefore = processedCount;
+
+		long ident;
+		long first = findRecord( source, runStart, ident );
+		if ( first >= 0 && first < runEnd ) {
+			// read the run and enough past it to finish the last record that starts in it
+			long slack = 64*1024;
+			for (;;) {
+				long want = runEnd - first + slack;
+				buffer.resize( want + 1 );
+				long len = source.readAt( first, &buffer[0], want );
+				if ( len <= 0 ) {
+					fprintf( stderr, "Unable to read the run at offset %ld\n", first );
+					return PARSE_ERROR;
+				}
+				buffer[len] = '\0';
+				const char * buf = &buffer[0];
+				const char * cut = NULL;
+				if ( runEnd - first < len )
+					cut = FindText( buf + (runEnd - first), buf + len, "<changeset " );
+				if ( cut == NULL ) {
+					if ( len == want && slack < (64 << 20) ) {
+						slack *= 4;		// a huge record, or a long run of them with no gap
+						continue;
+					}
+					cut = buf + len;
+				}
+				setWindow( buf, first );
+				status = parseRecords( buf, cut, startDate, changeset );
+				if ( status == PARSE_ERROR )
+					return PARSE_ERROR;
+				break;
+			}
+		}
+		sampleRuns.add( processedCount - processedBefore, (double)runLength / (stratumEnd - stratum) );
 	}
+	return status;
+}
+
+void ChangesetParser::initializeReaders()
+{
+	tagKeys = readers.tagKeys();
+	readers.initialize();
+}
+
+void ChangesetParser::finalizeReaders()
+{
+	if ( isSampling() )
+		readers.setSampleRate( sampling.scheme == SAMPLE_IDS ? sampling.rate : sampleRuns.fraction() );
+	readers.finalize();
 
 #if PRINT_UNUSED_TAGS
 	// Show counts of tags we ignored
@@ -417,38 +761,261 @@ bool ChangesetParser::parseXmlString( const char * xml, long len, std::string st
 	}
 	printf("\n");
 #endif
+}
 
-	return true;
+bool ChangesetParser::parseXmlString( const char * xml, long len, std::string startDate )
+{
+	beginDocuments();
+	bool ok = parseXmlDocument( xml, len, startDate );
+	endDocuments();
+	return ok;
 };
 
-void ChangesetParser::addReader(ChangesetReader * reader)
+void ChangesetParser::beginDocuments()
 {
-	readers.push_back(reader);
+	initializeReaders();
 }
 
-#include <sys/mman.h>
-#include <fcntl.h>
-#include <sys/stat.h>
+void ChangesetParser::endDocuments()
+{
+	finalizeReaders();
+}
+
+bool ChangesetParser::parseXmlDocument( const char * xml, long len, const std::string & startDate )
+{
+	// get xml initial header
+	const char * s = xml;
+	IgnoreTag( s, xml+len, "?xml" );
+	IgnoreTag( s, xml+len, "osm" );
+	IgnoreTag( s, xml+len, "bound" );
+
+	// if a start date is defined then binary search for the changeset at or before it
+	if ( startDate.size() > 0 ) {
+		s = searchForStartDate( s, xml+len, startDate );
+	}
+
+	// iterate over all changesets, reusing the string buffers of a single changeset
+	Changeset changeset;
+	setWindow( xml, 0 );
+	return parseRecords( s, xml+len, startDate, changeset ) != PARSE_ERROR;
+}
 
-bool ChangesetParser::parseXmlFile( std::string path, std::string startDate )
+bool ChangesetParser::parseInput( InputSource & source, std::string startDate )
 {
-	if ( path.compare(path.length()-4, 4, ".bz2") == 0 ) {
+	long offset = 0;
+	bool seekable = source.seekable();
+	if ( seekable ) {
+		// get xml initial header
+		char header[4096];
+		long len = source.readAt( 0, header, sizeof header - 1 );
+		if ( len < 0 )
+			return false;
+		header[len] = '\0';
+		const char * s = header;
+		IgnoreTag( s, header+len, "?xml" );
+		IgnoreTag( s, header+len, "osm" );
+		IgnoreTag( s, header+len, "bound" );
+		offset = s - header;
+	}
+
+	initializeReaders();
+
+	// if a start date is defined then binary search for the changeset at or before it
+	stopIdent = -1;
+	long limit = -1;
+	if ( seekable ) {
+		limit = source.size();
+		if ( rangeEnd >= 0 ) {
+			// changesets are in id order, so the range ends at the id of the first changeset past it
+			long ident;
+			long stop = findRecord( source, std::max( rangeEnd, offset ), ident );
+			if ( stop >= 0 ) {
+				limit = stop;
+				stopIdent = ident;
+			}
+		}
+		if ( rangeBegin > offset ) {
+			long ident;
+			offset = findRecord( source, rangeBegin, ident );
+			if ( offset < 0 || (stopIdent >= 0 && ident >= stopIdent) ) {
+				// nothing starts in the range
+				finalizeReaders();
+				return true;
+			}
+		}
+		if ( startDate.size() > 0 ) {
+			offset = searchForStartOffset( source, offset, limit, startDate );
+		}
+		source.seek( offset );
+	} else if ( rangeBegin > 0 || rangeEnd >= 0 ) {
+		fprintf( stderr, "A byte range requires a seekable input\n" );
 		return false;
 	}
 
-	int fd = open( path.c_str(), O_RDONLY );
-	if ( fd < 0 ) {
-		perror("");
+	if ( sampling.scheme == SAMPLE_BYTES ) {
+		if ( !seekable ) {
+			fprintf( stderr, "Byte-range sampling requires a seekable input\n" );
+			return false;
+		}
+		Changeset changeset;
+		bool ok = parseSampleRuns( source, offset, limit, startDate, changeset ) != PARSE_ERROR;
+		finalizeReaders();
+		return ok;
+	}
+
+	// iterate over all changesets, one window at a time
+	Changeset changeset;
+	const char * start, * end;
+	bool header = !seekable;
+	bool skipping = !seekable && startDate.size() > 0;
+	long windowOffset = seekable ? offset : 0;	// windows follow one another without gaps
+	while ( source.nextWindow( start, end ) ) {
+		setWindow( start, windowOffset );
+		windowOffset += end - start;
+		if ( header ) {
+			// a stream starts with the xml header
+			IgnoreTag( start, end, "?xml" );
+			IgnoreTag( start, end, "osm" );
+			IgnoreTag( start, end, "bound" );
+			header = false;
+		}
+		if ( skipping ) {
+			// we can't binary search a stream, so skip forward to the start date
+			start = SkipToDate( start, end, startDate );
+			if ( start == end )
+				continue;
+			skipping = false;
+		}
+		auto status = parseRecords( start, end, startDate, changeset );
+		if ( status == PARSE_FINISHED ) {
+			break;
+		} else if ( status == PARSE_ERROR ) {
+			// report what was parsed before the error
+			finalizeReaders();
+			return false;
+		}
+	}
+	if ( source.failed() )
+		return false;
+
+	finalizeReaders();
+	return true;
+}
+
+bool ChangesetParser::parseRecordsAt( InputSource & source, const std::vector<std::pair<long,long>> & records,
+									 std::string startDate )
+{
+	if ( !source.seekable() ) {
+		fprintf( stderr, "Reading records by offset requires a seekable input\n" );
 		return false;
 	}
-	struct stat statbuf = { 0 };
-	fstat(fd,&statbuf);
 
-	const void * mem = mmap(NULL, statbuf.st_size, PROT_READ, MAP_FILE|MAP_SHARED|MAP_NOCACHE, fd, 0);
-	madvise( (void*)mem, statbuf.st_size, MADV_SEQUENTIAL );
+	initializeReaders();
+
+	// records that are close together are read together
+	const long gapLimit = 64*1024;
+	const long readLimit = 4 << 20;
+	std::vector<char> buffer;
+	Changeset changeset;
+	for ( size_t first = 0; first < records.size(); ) {
+		long begin = records[first].first;
+		long finish = begin + records[first].second;
+		size_t last = first + 1;
+		while ( last < records.size() &&
+			   records[last].first - finish < gapLimit &&
+			   records[last].first + records[last].second - begin < readLimit ) {
+			finish = records[last].first + records[last].second;
+			++last;
+		}
+		buffer.resize( finish - begin + 1 );
+		long len = source.readAt( begin, &buffer[0], finish - begin );
+		if ( len != finish - begin ) {
+			fprintf( stderr, "Unable to read the record at offset %ld\n", begin );
+			return false;
+		}
+		buffer[len] = '\0';
+		setWindow( &buffer[0], begin );
+
+		for ( ; first < last; ++first ) {
+			const char * s = &buffer[records[first].first - begin];
+			const char * record = s;
+			const char * recordEnd = &buffer[records[first].first + records[first].second - begin];
+			auto status = parseChangeset( s, recordEnd, changeset, true );
+			changeset.offset = records[first].first;
+			changeset.length = s - record;
+			if ( status == PARSE_SUCCESS ) {
+				if ( changeset.date >= startDate && (endDate.size() == 0 || changeset.date < endDate) ) {
+					readers.process( changeset );
+					++processedCount;
+				}
+			} else if ( status != PARSE_SKIPPED ) {
+				if ( status != PARSE_ERROR )
+					errorReason = "no changeset at the offset";
+				if ( !skipMalformed( records[first].first ) ) {
+					finalizeReaders();
+					return false;
+				}
+			}
+		}
+	}
+
+	finalizeReaders();
+	return true;
+}
+
+bool ChangesetParser::addReader(ChangesetReader * reader)
+{
+	return readers.add(reader);
+}
+
+void ChangesetParser::setFilter( const ChangesetFilter & filter )
+{
+	readers.setFilter( filter );
+}
+
+void ChangesetParser::setEndDate( const std::string & date )
+{
+	endDate = date;
+}
+
+void ChangesetParser::setByteRange( long begin, long end )
+{
+	rangeBegin = begin;
+	rangeEnd = end;
+}
+
+void ChangesetParser::setSampling( const SampleSettings & settings )
+{
+	sampling = settings;
+}
 
-	bool ok = parseXmlString( (const char *)mem, statbuf.st_size, startDate );
+std::string ChangesetParser::sampleSummary() const
+{
+	char text[256];
+	if ( sampling.scheme == SAMPLE_IDS ) {
+		snprintf( text, sizeof text, "%ld changesets from %.3g%% of ids, about %s in all",
+				 processedCount, 100 * sampling.rate, ScaleCount( processedCount, sampling.rate ).format().c_str() );
+	} else if ( sampling.scheme == SAMPLE_BYTES ) {
+		snprintf( text, sizeof text, "%ld changesets in %ld runs from %.3g%% of the input, about %s in all",
+				 processedCount, (long)sampleRuns.size(), 100 * sampleRuns.fraction(), sampleRuns.estimate().format().c_str() );
+	} else {
+		return "";
+	}
+	return text;
+}
 
-	munmap( (void *)mem, statbuf.st_size);
+bool ChangesetParser::parseXmlFile( std::string path, std::string startDate, const InputOptions & options )
+{
+	if ( path.length() >= 4 && path.compare(path.length()-4, 4, ".bz2") == 0 ) {
+		return false;
+	}
+
+	InputSource * source = NewInputSource( options );
+	if ( source == NULL ) {
+		fprintf( stderr, "Input backend '%s' is not available\n", options.backend.c_str() );
+		return false;
+	}
+	bool ok = source->open( path ) && parseInput( *source, startDate );
+	delete source;
 	return ok;
 }
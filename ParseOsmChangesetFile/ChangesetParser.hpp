@@ -10,36 +10,169 @@
 #define parser_hpp
 
 #include <stdio.h>
+#include <map>
+#include <string>
 #include <vector>
 
+#include "Arena.hpp"
+#include "ChangesetFilter.hpp"
+#include "EditorNames.hpp"
+#include "InputSource.hpp"
+#include "Sampling.hpp"
+
 // The data returned about each changeset
 class Changeset {
 public:
-	std::string date, user, application, applicationRaw, comment, locale, quest_type;
+	std::string date, user, application, applicationRaw, comment, locale, quest_type, hashtags;
 	long ident;
 	int uid, editCount;
 	double min_lat, max_lat, min_lon, max_lon;
+	// False when the record has no bounding box, as for changesets without edits, and the
+	// box is all zero. Only the parser knows, so other sources of changesets leave it true.
+	bool hasBox = true;
+
+	// Other tags, by key, when a filter compares them with tag:<key>
+	std::vector<std::pair<std::string,std::string>> tags;
+
+	// Where the record is in the input, when the changeset came from parsing it
+	long offset = -1, length = 0;
+
+	// Set as the changeset is passed to the readers, so values derived from it are computed again
+	mutable unsigned long generation = 0;
 };
 
+class RollupCube;
+struct GeoBox;
+
 // Virtual class that defines the callbacks from the parser
 class ChangesetReader {
 public:
+	virtual ~ChangesetReader() {}
 	void virtual initialize() = 0;
 	void virtual process(const Changeset &) = 0;
 	void virtual finalize() = 0;
+
+	// An optional filter expression (see ChangesetFilter). Only changesets it accepts are
+	// passed to process(), and the parser can skip the tags of changesets no reader wants.
+	virtual const char * filter() { return NULL; }
+
+	// Replication updates replace changesets that were already processed. A reader that
+	// can undo process() returns true from canRetract(), and is then passed the old
+	// version to retract() before the new version is passed to process().
+	virtual bool canRetract() { return false; }
+	virtual void retract(const Changeset &) {}
+
+	// A reader whose report only needs the totals in a rollup cube (see RollupCube.hpp) returns
+	// true from usesRollup(), and can then be passed the cube instead of every changeset.
+	virtual bool usesRollup() { return false; }
+	virtual void processRollup(const RollupCube &) {}
+
+	// Stages are readers that compute something other readers use, such as the set of comments
+	// StreetComplete writes. A stage is added along with the first reader that lists it here,
+	// sees each changeset before the readers, and is finalized before them.
+	virtual std::vector<ChangesetReader *> stages() { return std::vector<ChangesetReader *>(); }
+
+	// A reader that ignores changesets whose bounding box doesn't intersect a region returns true
+	// and sets the region, so with a spatial index (see SpatialIndex.hpp) only the changesets there are read.
+	virtual bool region(GeoBox &) { return false; }
+
+	// Where reports are written. Readers finalize concurrently, each into its own
+	// buffer, so finalize() must write here rather than to stdout.
+	FILE * out = stdout;
+
+	// The reader's containers can allocate from its arena, which is freed all at once
+	// when the reader is deleted, and reports how much memory the reader used.
+	Arena arena;
+
+	// The memory the reader used: its arena's, and that of any other arenas it owns
+	virtual void addMemoryUsage( ArenaUsage & usage ) const	{ usage.add( arena ); }
+
+	// The name the reader was created with, for reports about it
+	std::string name;
+
+	// When the parser samples the input (see Sampling.hpp), the fraction of the changesets that
+	// were passed to process(), set before finalize(). Counts are scaled with scaledCount() or ScaleCount().
+	double sampleRate = 1.0;
+
+	// A count for a report: the count itself, or when sampling the estimated total and its margin
+	std::string scaledCount( long count ) const;
+
+	// Readers whose reports can't be scaled from a sample, such as distinct users per day,
+	// return false, and their report is marked as describing only the sample.
+	virtual bool scalesSamples() { return true; }
 };
 
 // The parser for changeset XML files
 class ChangesetParser {
+public:
+	struct ParseError {
+		long			offset;		// of the malformed record in the input
+		std::string		reason;
+	};
+	static const size_t MAX_ERRORS_KEPT = 100;
+	// Malformed records skipped before giving up, unless changed with setErrorBudget()
+	static long defaultErrorBudget;
 private:
-	enum ParseStatus { PARSE_SUCCESS, PARSE_ERROR, PARSE_FINISHED };
-	enum ParseStatus parseChangeset( const char * &s, Changeset & changeset );
+	enum ParseStatus { PARSE_SUCCESS, PARSE_ERROR, PARSE_FINISHED, PARSE_SKIPPED };
+	enum ParseStatus parseChangeset( const char * &s, const char * end, Changeset & changeset, bool applyFilters = false );
+	enum ParseStatus parseError( const char * reason )	{ errorReason = reason; return PARSE_ERROR; }
+	bool skipMalformed( long offset );
+	enum ParseStatus parseRecords( const char * s, const char * end, const std::string & startDate, Changeset & changeset );
+	enum ParseStatus parseSampleRuns( InputSource & source, long begin, long end, const std::string & startDate, Changeset & changeset );
 	const char * searchForStartDate( const char * xml, const char * end, std::string startDate );
-	std::vector<ChangesetReader *> readers;
+	long searchForStartOffset( InputSource & source, long start, long end, const std::string & startDate );
+	long findRecord( InputSource & source, long offset, long & ident );
+	void setWindow( const char * start, long offset )	{ windowStart = start; windowOffset = offset; }
+	void initializeReaders();
+	void finalizeReaders();
+	FilteredReaders readers;
+	std::vector<std::string> tagKeys;	// the tags filters compare, kept in Changeset::tags
+	EditorNameNormalizer editorNames;
+	std::string endDate;
+	long rangeBegin = 0, rangeEnd = -1;
+	long stopIdent = -1;	// the first changeset past the end of the range
+	const char * windowStart = NULL;	// the part of the input being parsed, and its offset in the input
+	long windowOffset = 0;
+	const char * errorReason = NULL;	// why the last record was malformed
+	long errorBudget = defaultErrorBudget;
+	long errorTotal = 0;
+	bool gaveUp = false;				// more errors than the budget, so parsing stopped
+	std::vector<ParseError> errorList;
+	std::map<std::string,long> errorCounts;		// by reason
+	SampleSettings sampling;			// every changeset, unless changed with setSampling()
+	StratifiedTotal sampleRuns;			// SAMPLE_BYTES: the changesets in each run
+	long processedCount = 0;			// changesets passed to the readers
 public:
-	void addReader(ChangesetReader * reader);
+	bool addReader(ChangesetReader * reader);
+	void setFilter( const ChangesetFilter & filter );	// applies to all readers
+	void setEndDate( const std::string & date );		// parsing stops at the first changeset on or after it
+	void setByteRange( long begin, long end );			// only parse changesets starting in [begin,end), end -1 for no limit
+
+	// A malformed record is skipped, and parsing resumes at the next <changeset, until more than
+	// errors records have been skipped. Then parsing stops, as it does at the first one with a budget
+	// of 0: the readers are finalized with what was parsed so far, and the parse returns false.
+	void setErrorBudget( long errors )					{ errorBudget = errors; }
+	bool stoppedByErrors() const						{ return gaveUp; }
+	long errorCount() const								{ return errorTotal; }
+	const std::vector<ParseError> & errors() const		{ return errorList; }	// the first MAX_ERRORS_KEPT
+	std::string errorSummary() const;					// the number of errors of each kind
+
+	// Parses only a sample of the changesets. Byte-range sampling needs a seekable input, and
+	// applies to parseInput(); sampling by id applies everywhere.
+	void setSampling( const SampleSettings & settings );
+	bool isSampling() const								{ return sampling.scheme != SAMPLE_NONE; }
+	std::string sampleSummary() const;					// how many changesets were sampled, and the estimated total
 	bool parseXmlString( const char * xml, long len, std::string startDate );
-	bool parseXmlFile( std::string path, std::string startDate );
+	// The same for a series of documents passed to the same readers, such as replication files:
+	// beginDocuments() initializes the readers, parseXmlDocument() passes each document's
+	// changesets to them, and endDocuments() finalizes them.
+	void beginDocuments();
+	bool parseXmlDocument( const char * xml, long len, const std::string & startDate );
+	void endDocuments();
+	bool parseInput( InputSource & source, std::string startDate );
+	// Parses only the records at the given offset and length in the input, which must be in file order
+	bool parseRecordsAt( InputSource & source, const std::vector<std::pair<long,long>> & records, std::string startDate );
+	bool parseXmlFile( std::string path, std::string startDate, const InputOptions & options = InputOptions() );
 };
 
 #endif /* parser_hpp */
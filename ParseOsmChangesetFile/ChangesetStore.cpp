@@ -0,0 +1,273 @@
+//
+//  ChangesetStore.cpp
+//  ParseOsmChangesetFile
+//
+//  Created by Bryce Cogswell on 10/18/26.
+//  Copyright © 2026 Bryce Cogswell. All rights reserved.
+//
+
+#include <algorithm>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "ChangesetStore.hpp"
+
+static const char	STORE_MAGIC[8]	= { 'O','S','M','S','T','O','R','E' };
+static const uint32_t	STORE_VERSION	= 1;
+
+ChangesetStore::Record ChangesetStore::makeRecord( const Changeset & changeset )
+{
+	Record r;
+	r.ident				= changeset.ident;
+	r.uid				= changeset.uid;
+	r.editCount			= changeset.editCount;
+	r.min_lat			= changeset.min_lat;
+	r.max_lat			= changeset.max_lat;
+	r.min_lon			= changeset.min_lon;
+	r.max_lon			= changeset.max_lon;
+	r.date				= strings.intern( changeset.date );
+	r.user				= strings.intern( changeset.user );
+	r.application		= strings.intern( changeset.application );
+	r.applicationRaw	= strings.intern( changeset.applicationRaw );
+	r.comment			= strings.intern( changeset.comment );
+	r.locale			= strings.intern( changeset.locale );
+	r.quest_type		= strings.intern( changeset.quest_type );
+	return r;
+}
+
+void ChangesetStore::getRecord( const Record & record, Changeset & changeset ) const
+{
+	changeset.ident				= record.ident;
+	changeset.uid				= record.uid;
+	changeset.editCount			= record.editCount;
+	changeset.min_lat			= record.min_lat;
+	changeset.max_lat			= record.max_lat;
+	changeset.min_lon			= record.min_lon;
+	changeset.max_lon			= record.max_lon;
+	changeset.date				= strings.string( record.date );
+	changeset.user				= strings.string( record.user );
+	changeset.application		= strings.string( record.application );
+	changeset.applicationRaw	= strings.string( record.applicationRaw );
+	changeset.comment			= strings.string( record.comment );
+	changeset.locale			= strings.string( record.locale );
+	changeset.quest_type		= strings.string( record.quest_type );
+}
+
+void ChangesetStore::process( const Changeset & changeset )
+{
+	if ( records.size() > 0 && changeset.date < strings.string( records.back().date ) )
+		dateOrder = false;
+	records.push_back( makeRecord( changeset ) );
+	if ( slots.size() > 0 )
+		slot( changeset.ident ) = (int32_t)records.size() - 1;
+}
+
+// Changeset ids are dense, so the id to record table is a flat array starting at the lowest id
+int32_t & ChangesetStore::slot( long ident )
+{
+	if ( slots.size() == 0 || ident < firstIdent ) {
+		// (re)build the table
+		long first = ident;
+		for ( const auto &r: records ) {
+			first = std::min( first, r.ident );
+		}
+		slots.assign( 1, -1 );
+		firstIdent = first;
+		for ( size_t i = 0; i < records.size(); ++i ) {
+			slot( records[i].ident ) = (int32_t)i;
+		}
+	}
+	long index = ident - firstIdent;
+	if ( index >= (long)slots.size() )
+		slots.resize( std::max( index + 1, (long)slots.size() * 5 / 4 ), -1 );
+	return slots[index];
+}
+
+bool ChangesetStore::upsert( const Changeset & changeset, Changeset & previous )
+{
+	int32_t index = slot( changeset.ident );
+	if ( index < 0 ) {
+		process( changeset );	// which fills in the slot
+		return false;
+	}
+	getRecord( records[index], previous );
+	records[index] = makeRecord( changeset );
+	return true;
+}
+
+void ChangesetStore::sortByDate()
+{
+	if ( dateOrder )
+		return;
+	std::stable_sort( records.begin(), records.end(), [this]( const Record & a, const Record & b ) {
+		return strings.string( a.date ) < strings.string( b.date );
+	});
+	dateOrder = true;
+	slots.clear();
+}
+
+// Fields are written one at a time so the file doesn't depend on the struct layout.
+// All the hosts we run on are little-endian, so values are written as they are in memory.
+template <class T> static void Put( FILE * file, T value )
+{
+	fwrite( &value, sizeof value, 1, file );
+}
+
+template <class T> static bool Get( FILE * file, T & value )
+{
+	return fread( &value, sizeof value, 1, file ) == 1;
+}
+
+bool ChangesetStore::save( const std::string & path ) const
+{
+	FILE * file = fopen( path.c_str(), "wb" );
+	if ( file == NULL ) {
+		perror( path.c_str() );
+		return false;
+	}
+	setvbuf( file, NULL, _IOFBF, 1 << 20 );
+	fwrite( STORE_MAGIC, 1, sizeof STORE_MAGIC, file );
+	Put<uint32_t>( file, STORE_VERSION );
+	Put<uint32_t>( file, (uint32_t)strings.size() );
+	for ( size_t i = 0; i < strings.size(); ++i ) {
+		const std::string & text = strings.string( (int)i );
+		Put<uint32_t>( file, (uint32_t)text.size() );
+		fwrite( text.data(), 1, text.size(), file );
+	}
+	Put<uint64_t>( file, records.size() );
+	for ( const auto &r: records ) {
+		Put<int64_t>( file, r.ident );
+		Put<int32_t>( file, r.uid );
+		Put<int32_t>( file, r.editCount );
+		Put<double>( file, r.min_lat );
+		Put<double>( file, r.max_lat );
+		Put<double>( file, r.min_lon );
+		Put<double>( file, r.max_lon );
+		Put<int32_t>( file, r.date );
+		Put<int32_t>( file, r.user );
+		Put<int32_t>( file, r.application );
+		Put<int32_t>( file, r.applicationRaw );
+		Put<int32_t>( file, r.comment );
+		Put<int32_t>( file, r.locale );
+		Put<int32_t>( file, r.quest_type );
+	}
+	bool ok = !ferror( file );
+	if ( fclose( file ) != 0 )
+		ok = false;
+	if ( !ok )
+		perror( path.c_str() );
+	return ok;
+}
+
+bool ChangesetStore::load( const std::string & path )
+{
+	FILE * file = fopen( path.c_str(), "rb" );
+	if ( file == NULL ) {
+		perror( path.c_str() );
+		return false;
+	}
+	setvbuf( file, NULL, _IOFBF, 1 << 20 );
+
+	size_t previousCount = records.size();
+	auto fail = [&]( const char * problem ) {
+		fprintf( stderr, "%s %s\n", path.c_str(), problem );
+		records.resize( previousCount );
+		fclose( file );
+		return false;
+	};
+
+	char magic[sizeof STORE_MAGIC];
+	uint32_t version, stringCount;
+	if ( fread( magic, 1, sizeof magic, file ) != sizeof magic || memcmp( magic, STORE_MAGIC, sizeof magic ) != 0 ||
+		!Get( file, version ) || version != STORE_VERSION || !Get( file, stringCount ) ) {
+		return fail( "is not a changeset store" );
+	}
+	std::vector<int> ids;	// the ids in this file mapped to ours
+	std::string text;
+	for ( uint32_t i = 0; i < stringCount; ++i ) {
+		uint32_t len;
+		if ( !Get( file, len ) )
+			return fail( "is truncated" );
+		text.resize( len );
+		if ( len > 0 && fread( &text[0], 1, len, file ) != len )
+			return fail( "is truncated" );
+		ids.push_back( strings.intern( text ) );
+	}
+	uint64_t recordCount;
+	if ( !Get( file, recordCount ) )
+		return fail( "is truncated" );
+	for ( uint64_t i = 0; i < recordCount; ++i ) {
+		int64_t ident;
+		int32_t uid, editCount;
+		int32_t fields[7];
+		Record r;
+		if ( !Get( file, ident ) || !Get( file, uid ) || !Get( file, editCount ) ||
+			!Get( file, r.min_lat ) || !Get( file, r.max_lat ) || !Get( file, r.min_lon ) || !Get( file, r.max_lon ) ||
+			fread( fields, sizeof fields[0], 7, file ) != 7 )
+			return fail( "is truncated" );
+		for ( int32_t field: fields ) {
+			if ( field < 0 || field >= (int32_t)ids.size() )
+				return fail( "is corrupt" );
+		}
+		r.ident				= ident;
+		r.uid				= uid;
+		r.editCount			= editCount;
+		r.date				= ids[fields[0]];
+		r.user				= ids[fields[1]];
+		r.application		= ids[fields[2]];
+		r.applicationRaw	= ids[fields[3]];
+		r.comment			= ids[fields[4]];
+		r.locale			= ids[fields[5]];
+		r.quest_type		= ids[fields[6]];
+		records.push_back( r );
+	}
+	fclose( file );
+
+	// replay() relies on date order, which partials loaded out of order would break
+	if ( previousCount > 0 && previousCount < records.size() &&
+		strings.string( records[previousCount-1].date ) > strings.string( records[previousCount].date ) ) {
+		dateOrder = false;
+	}
+	sortByDate();
+	slots.clear();
+	return true;
+}
+
+void ChangesetStore::replay( const std::vector<ChangesetReader *> & readers,
+							const std::string & startDate, const std::string & endDate,
+							const ChangesetFilter & filter ) const
+{
+	FilteredReaders filtered;
+	filtered.setFilter( filter );
+	for ( auto reader: readers ) {
+		filtered.add( reader );
+	}
+	filtered.initialize();
+	replay( filtered, startDate, endDate );
+	filtered.finalize();
+}
+
+void ChangesetStore::replay( FilteredReaders & filtered, const std::string & startDate, const std::string & endDate ) const
+{
+	// changesets are stored in date order, so binary search for the start
+	auto record = records.begin();
+	if ( startDate.size() > 0 ) {
+		record = std::lower_bound( records.begin(), records.end(), startDate,
+								  [this]( const Record & r, const std::string & date ) {
+			return strings.string( r.date ) < date;
+		});
+	}
+
+	Changeset changeset;
+	for ( ; record != records.end(); ++record ) {
+		const std::string & date = strings.string( record->date );
+		if ( endDate.size() > 0 && date >= endDate )
+			break;
+
+		getRecord( *record, changeset );
+		if ( filtered.acceptsAttributes( changeset ) ) {
+			filtered.process( changeset );
+		}
+	}
+}
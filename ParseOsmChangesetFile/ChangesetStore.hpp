@@ -0,0 +1,79 @@
+//
+//  ChangesetStore.hpp
+//  ParseOsmChangesetFile
+//
+//  Created by Bryce Cogswell on 10/18/26.
+//  Copyright © 2026 Bryce Cogswell. All rights reserved.
+//
+
+#ifndef ChangesetStore_hpp
+#define ChangesetStore_hpp
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "ChangesetParser.hpp"
+#include "StringTable.hpp"
+
+// A reader that keeps a compact copy of every changeset in memory, so they
+// can be passed to other readers again without re-parsing the XML.
+//
+// The store can also be saved to a file, which is the partial state written by each
+// worker of a sharded run (see ShardManifest.hpp). The file is little-endian:
+//		char[8]		"OSMSTORE"
+//		uint32		version, currently 1
+//		uint32		number of strings, then for each:
+//			uint32		length
+//			char[]		bytes, not terminated
+//		uint64		number of changesets, then for each:
+//			int64		id
+//			int32		uid, number of changes
+//			float64		min_lat, max_lat, min_lon, max_lon
+//			int32		date, user, application, created_by, comment, locale, quest_type,
+//						each the index of a string above
+class ChangesetStore: public ChangesetReader {
+	struct Record {
+		long	ident;
+		int		uid, editCount;
+		double	min_lat, max_lat, min_lon, max_lon;
+		int		date, user, application, applicationRaw, comment, locale, quest_type;	// ids in strings
+	};
+	std::vector<Record>		records;
+	StringTable				strings;
+	std::vector<int32_t>	slots;			// index in records of each id from firstIdent on, -1 if none
+	long					firstIdent = 0;
+	bool					dateOrder = true;
+
+	Record makeRecord( const Changeset & changeset );
+	void getRecord( const Record & record, Changeset & changeset ) const;
+	int32_t & slot( long ident );
+public:
+	void initialize() {}
+	void process( const Changeset & changeset );
+	void finalize() {}
+
+	size_t size() const		{ return records.size(); }
+
+	// Writes the changesets to a file in the format above
+	bool save( const std::string & path ) const;
+	// Adds the changesets in a file written by save(), keeping them in date order
+	bool load( const std::string & path );
+
+	// Adds the changeset, or if one with the same id is already stored replaces it and
+	// returns true with the stored version in previous. Updates keep their place, so
+	// call sortByDate() before replaying if new changesets might arrive out of order.
+	bool upsert( const Changeset & changeset, Changeset & previous );
+	void sortByDate();
+
+	// Passes the stored changesets with startDate <= date < endDate to the readers.
+	// An empty date means no limit. The filter and the readers' own filters are applied as
+	// they are when parsing.
+	void replay( const std::vector<ChangesetReader *> & readers,
+				const std::string & startDate, const std::string & endDate,
+				const ChangesetFilter & filter ) const;
+	// The same, for readers that are already initialized and that the caller will finalize
+	void replay( FilteredReaders & readers, const std::string & startDate, const std::string & endDate ) const;
+};
+
+#endif /* ChangesetStore_hpp */
@@ -0,0 +1,482 @@
+//
+//  CommentIndex.cpp
+//  ParseOsmChangesetFile
+//
+//  Created by Bryce Cogswell on 10/18/26.
+//  Copyright © 2026 Bryce Cogswell. All rights reserved.
+//
+
+#include <algorithm>
+#include <ctype.h>
+#include <iterator>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "CommentIndex.hpp"
+
+static const char		INDEX_MAGIC[8]		= { 'O','S','M','T','E','R','M','S' };
+static const uint32_t	INDEX_VERSION		= 2;
+static const long		HEADER_SIZE			= 72;
+static const size_t		MAX_TERM_LENGTH		= 64;	// longer runs are usually URLs or noise
+
+static bool IsWordChar( unsigned char c )
+{
+	return isalnum( c ) || c == '_' || c >= 0x80;
+}
+
+static void AddTerm( const char * s, size_t len, std::vector<std::string> & terms )
+{
+	if ( len > MAX_TERM_LENGTH )
+		return;
+	std::string term( s, len );
+	for ( auto &c: term ) {
+		c = tolower( (unsigned char)c );
+	}
+	terms.push_back( term );
+}
+
+// Appends the words and hashtags in the text
+static void AddTerms( const std::string & text, std::vector<std::string> & terms )
+{
+	const char * s = text.c_str();
+	while ( *s ) {
+		if ( *s == '#' && IsWordChar( s[1] ) ) {
+			const char * start = s++;
+			while ( IsWordChar( *s ) || *s == '-' )
+				++s;
+			size_t len = s - start;
+			while ( start[len-1] == '-' )
+				--len;
+			AddTerm( start, len, terms );
+			// the words of the hashtag are terms too
+			s = start + 1;
+		} else if ( IsWordChar( *s ) ) {
+			const char * start = s;
+			while ( IsWordChar( *s ) )
+				++s;
+			AddTerm( start, s - start, terms );
+		} else {
+			++s;
+		}
+	}
+}
+
+template <class Vector> static void PutVarint( Vector & bytes, uint64_t value )
+{
+	while ( value >= 0x80 ) {
+		bytes.push_back( (uint8_t)(value | 0x80) );
+		value >>= 7;
+	}
+	bytes.push_back( (uint8_t)value );
+}
+
+static bool GetVarint( const uint8_t *& p, const uint8_t * end, uint64_t & value )
+{
+	value = 0;
+	for ( int shift = 0; p < end && shift < 64; shift += 7 ) {
+		uint8_t byte = *p++;
+		value |= (uint64_t)(byte & 0x7F) << shift;
+		if ( (byte & 0x80) == 0 )
+			return true;
+	}
+	return false;
+}
+
+void CommentIndexBuilder::process( const Changeset & changeset )
+{
+	if ( changeset.offset < 0 )
+		return;		// not from a file, so there's nothing to point to
+	if ( recordCount > 0 && changeset.ident <= lastIdent ) {
+		ordered = false;
+		return;
+	}
+
+	if ( recordCount % CommentIndex::BLOCK_SIZE == 0 ) {
+		CommentIndex::Block block = { changeset.ident, changeset.offset, records.size() };
+		blocks.push_back( block );
+	} else {
+		PutVarint( records, changeset.ident - lastIdent );
+		PutVarint( records, changeset.offset - lastOffset );
+	}
+	PutVarint( records, changeset.length );
+	++recordCount;
+	lastIdent = changeset.ident;
+	lastOffset = changeset.offset;
+
+	terms.clear();
+	AddTerms( changeset.comment, terms );
+	AddTerms( changeset.hashtags, terms );
+	std::sort( terms.begin(), terms.end() );
+	terms.erase( std::unique( terms.begin(), terms.end() ), terms.end() );
+	for ( const auto &term: terms ) {
+		auto it = postings.find( term );
+		if ( it == postings.end() )
+			it = postings.insert( std::pair<std::string,Posting>( term, Posting( &arena ) ) ).first;
+		Posting & posting = it->second;
+		PutVarint( posting.bytes, changeset.ident - posting.last );
+		posting.last = changeset.ident;
+		posting.count += 1;
+	}
+}
+
+template <class T> static void Put( FILE * file, T value )
+{
+	fwrite( &value, sizeof value, 1, file );
+}
+
+bool CommentIndexBuilder::save( const std::string & path, long inputSize, int64_t inputTime )
+{
+	if ( !ordered ) {
+		fprintf( stderr, "%s: changesets must be in id order to be indexed\n", path.c_str() );
+		return false;
+	}
+	std::vector<PostingMap::const_iterator> sorted;
+	sorted.reserve( postings.size() );
+	for ( auto it = postings.begin(); it != postings.end(); ++it ) {
+		sorted.push_back( it );
+	}
+	std::sort( sorted.begin(), sorted.end(), []( PostingMap::const_iterator a, PostingMap::const_iterator b ) {
+		return a->first < b->first;
+	});
+	uint64_t textBytes = 0, postingBytes = 0;
+	for ( auto it: sorted ) {
+		textBytes += it->first.size();
+		postingBytes += it->second.bytes.size();
+	}
+
+	FILE * file = fopen( path.c_str(), "wb" );
+	if ( file == NULL ) {
+		perror( path.c_str() );
+		return false;
+	}
+	setvbuf( file, NULL, _IOFBF, 1 << 20 );
+	fwrite( INDEX_MAGIC, 1, sizeof INDEX_MAGIC, file );
+	Put<uint32_t>( file, INDEX_VERSION );
+	Put<uint32_t>( file, CommentIndex::BLOCK_SIZE );
+	Put<uint64_t>( file, inputSize );
+	Put<int64_t>( file, inputTime );
+	Put<uint64_t>( file, sorted.size() );
+	Put<uint64_t>( file, recordCount );
+	Put<uint64_t>( file, textBytes );
+	Put<uint64_t>( file, postingBytes );
+	Put<uint64_t>( file, records.size() );
+	uint64_t textOffset = 0, postingOffset = 0;
+	for ( auto it: sorted ) {
+		Put<uint64_t>( file, textOffset );
+		Put<uint64_t>( file, postingOffset );
+		Put<uint32_t>( file, (uint32_t)it->first.size() );
+		Put<uint32_t>( file, it->second.count );
+		textOffset += it->first.size();
+		postingOffset += it->second.bytes.size();
+	}
+	for ( const auto &block: blocks ) {
+		Put<int64_t>( file, block.ident );
+		Put<int64_t>( file, block.offset );
+		Put<uint64_t>( file, block.data );
+	}
+	for ( auto it: sorted ) {
+		fwrite( it->first.data(), 1, it->first.size(), file );
+	}
+	for ( auto it: sorted ) {
+		fwrite( it->second.bytes.data(), 1, it->second.bytes.size(), file );
+	}
+	fwrite( records.data(), 1, records.size(), file );
+	bool ok = !ferror( file );
+	if ( fclose( file ) != 0 )
+		ok = false;
+	if ( !ok )
+		perror( path.c_str() );
+	return ok;
+}
+
+bool CommentIndex::open( const std::string & path )
+{
+	close();
+	int fd = ::open( path.c_str(), O_RDONLY );
+	if ( fd < 0 ) {
+		perror( path.c_str() );
+		return false;
+	}
+	struct stat statbuf;
+	if ( fstat( fd, &statbuf ) != 0 ) {
+		perror( path.c_str() );
+		::close( fd );
+		return false;
+	}
+	mapSize = statbuf.st_size;
+	if ( mapSize >= HEADER_SIZE ) {
+		void * mem = mmap( NULL, mapSize, PROT_READ, MAP_SHARED, fd, 0 );
+		if ( mem == MAP_FAILED ) {
+			perror( path.c_str() );
+			::close( fd );
+			mapSize = 0;
+			return false;
+		}
+		map = (const char *)mem;
+	}
+	::close( fd );
+
+	auto fail = [&]( const char * problem ) {
+		fprintf( stderr, "%s %s\n", path.c_str(), problem );
+		close();
+		return false;
+	};
+	if ( map == NULL || memcmp( map, INDEX_MAGIC, sizeof INDEX_MAGIC ) != 0 )
+		return fail( "is not a comment index" );
+	uint32_t version, blockSize;
+	uint64_t fileSize, textBytes;
+	memcpy( &version, map + 8, 4 );
+	memcpy( &blockSize, map + 12, 4 );
+	memcpy( &fileSize, map + 16, 8 );
+	memcpy( &inputTime, map + 24, 8 );
+	memcpy( &termCount, map + 32, 8 );
+	memcpy( &recordCount, map + 40, 8 );
+	memcpy( &textBytes, map + 48, 8 );
+	memcpy( &postingBytes, map + 56, 8 );
+	memcpy( &recordBytes, map + 64, 8 );
+	if ( version != INDEX_VERSION || blockSize != BLOCK_SIZE )
+		return fail( "is not a comment index" );
+	inputSize = (long)fileSize;
+
+	// the sections must add up to the size of the file
+	uint64_t blockCount = (recordCount + BLOCK_SIZE - 1) / BLOCK_SIZE;
+	uint64_t limit = (uint64_t)mapSize;
+	if ( termCount > limit / sizeof(Term) || blockCount > limit / sizeof(Block) ||
+		textBytes > limit || postingBytes > limit || recordBytes > limit ||
+		HEADER_SIZE + termCount * sizeof(Term) + blockCount * sizeof(Block) + textBytes + postingBytes + recordBytes != limit )
+		return fail( "is truncated" );
+	terms		= (const Term *)(map + HEADER_SIZE);
+	blocks		= (const Block *)(terms + termCount);
+	text		= (const char *)(blocks + blockCount);
+	postings	= (const uint8_t *)(text + textBytes);
+	recordData	= postings + postingBytes;
+
+	// so lookups don't need to check where terms and blocks point
+	for ( uint64_t i = 0; i < termCount; ++i ) {
+		uint64_t postingEnd = i + 1 < termCount ? terms[i+1].postings : postingBytes;
+		if ( terms[i].text + terms[i].textLength > textBytes || terms[i].postings > postingEnd || postingEnd > postingBytes )
+			return fail( "is corrupt" );
+	}
+	for ( uint64_t i = 0; i < blockCount; ++i ) {
+		if ( blocks[i].data > (i + 1 < blockCount ? blocks[i+1].data : recordBytes) )
+			return fail( "is corrupt" );
+	}
+	return true;
+}
+
+void CommentIndex::close()
+{
+	if ( map ) {
+		munmap( (void *)map, mapSize );
+		map = NULL;
+	}
+	mapSize = 0;
+	termCount = recordCount = postingBytes = recordBytes = 0;
+	terms = NULL;
+	blocks = NULL;
+	text = NULL;
+	postings = recordData = NULL;
+}
+
+const CommentIndex::Term * CommentIndex::find( const std::string & term ) const
+{
+	const Term * end = terms + termCount;
+	const Term * it = std::lower_bound( terms, end, term, [this]( const Term & entry, const std::string & term ) {
+		return term.compare( 0, std::string::npos, text + entry.text, entry.textLength ) > 0;
+	});
+	if ( it == end || term.compare( 0, std::string::npos, text + it->text, it->textLength ) != 0 )
+		return NULL;
+	return it;
+}
+
+std::vector<long> CommentIndex::postingList( const std::string & term ) const
+{
+	std::vector<long> idents;
+	const Term * entry = find( term );
+	if ( entry == NULL )
+		return idents;
+	size_t index = entry - terms;
+	const uint8_t * p = postings + entry->postings;
+	const uint8_t * end = postings + (index + 1 < termCount ? terms[index+1].postings : postingBytes);
+	idents.reserve( entry->count );
+	long ident = 0;
+	uint64_t delta;
+	while ( p < end && GetVarint( p, end, delta ) ) {
+		ident += (long)delta;
+		idents.push_back( ident );
+	}
+	return idents;
+}
+
+// The changesets containing every term in the word, since "hot-osm" is searched as "hot" and "osm"
+std::vector<long> CommentIndex::tokenList( const std::string & word ) const
+{
+	std::vector<std::string> tokens;
+	AddTerms( word, tokens );
+	std::vector<long> idents = postingList( tokens[0] );
+	for ( size_t i = 1; i < tokens.size() && idents.size() > 0; ++i ) {
+		std::vector<long> other = postingList( tokens[i] );
+		std::vector<long> both;
+		std::set_intersection( idents.begin(), idents.end(), other.begin(), other.end(), std::back_inserter( both ) );
+		idents.swap( both );
+	}
+	return idents;
+}
+
+// Evaluates a query by recursive descent:
+//		or		= and { "or" and }
+//		and		= primary { ["and"] primary }
+//		primary	= "(" or ")" | word
+class CommentQuery {
+	const CommentIndex &	index;
+	const char			*	s;
+	std::string				error;
+
+	void skipSpace()
+	{
+		while ( isspace( (unsigned char)*s ) )
+			++s;
+	}
+	// The next word, without consuming it
+	std::string peek()
+	{
+		skipSpace();
+		const char * end = s;
+		while ( *end && !isspace( (unsigned char)*end ) && *end != '(' && *end != ')' )
+			++end;
+		return std::string( s, end - s );
+	}
+	bool keyword( const char * word )
+	{
+		std::string next = peek();
+		if ( strcasecmp( next.c_str(), word ) != 0 )
+			return false;
+		s += next.size();
+		return true;
+	}
+	bool fail( const std::string & message )
+	{
+		if ( error.empty() )
+			error = message;
+		return false;
+	}
+
+	bool primary( std::vector<long> & idents )
+	{
+		skipSpace();
+		if ( *s == '(' ) {
+			++s;
+			if ( !disjunction( idents ) )
+				return false;
+			skipSpace();
+			if ( *s != ')' )
+				return fail( "Expected ')'" );
+			++s;
+			return true;
+		}
+		std::string word = peek();
+		if ( word.empty() )
+			return fail( "Expected a term" );
+		std::vector<std::string> tokens;
+		AddTerms( word, tokens );
+		if ( tokens.empty() )
+			return fail( "'" + word + "' has nothing to search for" );
+		s += word.size();
+		idents = index.tokenList( word );
+		return true;
+	}
+
+	bool conjunction( std::vector<long> & idents )
+	{
+		if ( !primary( idents ) )
+			return false;
+		for (;;) {
+			skipSpace();
+			if ( *s == '\0' || *s == ')' || strcasecmp( peek().c_str(), "or" ) == 0 )
+				return true;
+			keyword( "and" );
+			std::vector<long> other, both;
+			if ( !primary( other ) )
+				return false;
+			std::set_intersection( idents.begin(), idents.end(), other.begin(), other.end(), std::back_inserter( both ) );
+			idents.swap( both );
+		}
+	}
+
+	bool disjunction( std::vector<long> & idents )
+	{
+		if ( !conjunction( idents ) )
+			return false;
+		while ( keyword( "or" ) ) {
+			std::vector<long> other, either;
+			if ( !conjunction( other ) )
+				return false;
+			std::set_union( idents.begin(), idents.end(), other.begin(), other.end(), std::back_inserter( either ) );
+			idents.swap( either );
+		}
+		return true;
+	}
+public:
+	CommentQuery( const CommentIndex & index, const std::string & query ) : index(index), s(query.c_str()) {}
+
+	bool run( std::vector<long> & idents, std::string & message )
+	{
+		bool ok = disjunction( idents );
+		skipSpace();
+		if ( ok && *s != '\0' )
+			ok = fail( "Unexpected '" + std::string( s ) + "'" );
+		message = error;
+		return ok;
+	}
+};
+
+bool CommentIndex::search( const std::string & query, std::vector<long> & idents, std::string & error ) const
+{
+	idents.clear();
+	return CommentQuery( *this, query ).run( idents, error );
+}
+
+std::vector<std::pair<long,long>> CommentIndex::recordLocations( const std::vector<long> & idents ) const
+{
+	std::vector<std::pair<long,long>> locations;
+	uint64_t blockCount = (recordCount + BLOCK_SIZE - 1) / BLOCK_SIZE;
+	uint64_t current = blockCount;	// the block decoded below
+	long blockIdents[BLOCK_SIZE], blockOffsets[BLOCK_SIZE], blockLengths[BLOCK_SIZE];
+	size_t blockLength = 0;
+	for ( long ident: idents ) {
+		const Block * next = std::upper_bound( blocks, blocks + blockCount, ident, []( long ident, const Block & block ) {
+			return ident < block.ident;
+		});
+		if ( next == blocks )
+			continue;
+		uint64_t b = next - 1 - blocks;
+		if ( b != current ) {
+			current = b;
+			const uint8_t * p = recordData + blocks[b].data;
+			const uint8_t * end = recordData + (b + 1 < blockCount ? blocks[b+1].data : recordBytes);
+			long recordIdent = blocks[b].ident, recordOffset = blocks[b].offset;
+			uint64_t identDelta = 0, offsetDelta = 0, length;
+			for ( blockLength = 0; blockLength < BLOCK_SIZE && p < end; ++blockLength ) {
+				if ( blockLength > 0 && (!GetVarint( p, end, identDelta ) || !GetVarint( p, end, offsetDelta )) )
+					break;
+				if ( !GetVarint( p, end, length ) )
+					break;
+				recordIdent += (long)identDelta;
+				recordOffset += (long)offsetDelta;
+				blockIdents[blockLength] = recordIdent;
+				blockOffsets[blockLength] = recordOffset;
+				blockLengths[blockLength] = (long)length;
+			}
+		}
+		const long * found = std::lower_bound( blockIdents, blockIdents + blockLength, ident );
+		if ( found < blockIdents + blockLength && *found == ident ) {
+			size_t i = found - blockIdents;
+			locations.push_back( std::make_pair( blockOffsets[i], blockLengths[i] ) );
+		}
+	}
+	return locations;
+}
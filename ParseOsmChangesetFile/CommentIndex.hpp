@@ -0,0 +1,133 @@
+//
+//  CommentIndex.hpp
+//  ParseOsmChangesetFile
+//
+//  Created by Bryce Cogswell on 10/18/26.
+//  Copyright © 2026 Bryce Cogswell. All rights reserved.
+//
+
+#ifndef CommentIndex_hpp
+#define CommentIndex_hpp
+
+#include <stdint.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "ChangesetParser.hpp"
+
+// An inverted index of the words and hashtags in changeset comments and hashtags tags, which
+// says which changesets mention a campaign without reading every comment.
+//
+// Terms have their ASCII letters lowercased. Words are runs of letters, digits, underscores and non-ASCII
+// characters. Hashtags are '#' followed by those and '-', and are kept with their '#', so
+// "#missingmaps" and "missingmaps" are different terms. A hashtag's words are terms too.
+//
+// Each term has a posting list of the ids of the changesets that use it, stored as the
+// differences between successive ids in variable length integers (7 bits per byte, high bit
+// set on all but the last). Finding the changesets' records then uses a table of every
+// changeset's id, offset and length in the input, stored the same way in blocks of
+// BLOCK_SIZE with a directory of where each block starts.
+//
+// The file is little-endian and mapped into memory rather than read:
+//		char[8]		"OSMTERMS"
+//		uint32		version, currently 2
+//		uint32		block size
+//		uint64		size of the changeset file it indexes, to notice when that changes
+//		int64		modification time of the changeset file in nanoseconds, likewise
+//		uint64		number of terms, number of changesets
+//		uint64		bytes of term text, of posting lists, of record blocks
+//		the terms in sorted order, for each:
+//			uint64		offset of its text and of its posting list
+//			uint32		length of its text, number of changesets
+//		each block of records:
+//			int64		first id, first offset
+//			uint64		offset of the block
+//		char[]		the text of the terms, not terminated
+//		byte[]		the posting lists: id delta
+//		byte[]		the record blocks: for each changeset id delta, offset delta, length
+class CommentIndex {
+public:
+	static const uint32_t BLOCK_SIZE = 64;
+
+	struct Term {
+		uint64_t	text;
+		uint64_t	postings;
+		uint32_t	textLength;
+		uint32_t	count;
+	};
+	struct Block {
+		int64_t		ident;
+		int64_t		offset;
+		uint64_t	data;
+	};
+private:
+	const char		*	map = NULL;
+	long				mapSize = 0;
+	long				inputSize = 0;
+	int64_t				inputTime = 0;
+	uint64_t			termCount = 0;
+	uint64_t			recordCount = 0;
+	const Term		*	terms = NULL;
+	const Block		*	blocks = NULL;
+	const char		*	text = NULL;
+	const uint8_t	*	postings = NULL;
+	uint64_t			postingBytes = 0;
+	const uint8_t	*	recordData = NULL;
+	uint64_t			recordBytes = 0;
+
+	const Term * find( const std::string & term ) const;
+	std::vector<long> postingList( const std::string & term ) const;
+	std::vector<long> tokenList( const std::string & word ) const;
+	friend class CommentQuery;
+public:
+	CommentIndex() {}
+	~CommentIndex()		{ close(); }
+
+	// Maps a file written by CommentIndexBuilder
+	bool open( const std::string & path );
+	void close();
+
+	size_t size() const				{ return termCount; }
+	long indexedFileSize() const	{ return inputSize; }
+	int64_t indexedFileTime() const	{ return inputTime; }
+
+	// The ids of the changesets matching a query of terms combined with and, or and
+	// parentheses, such as "#missingmaps and (building or buildings)", in increasing order.
+	// Returns false and sets error if the query is malformed.
+	bool search( const std::string & query, std::vector<long> & idents, std::string & error ) const;
+
+	// The offset and length of the records of the changesets, which must be in increasing order,
+	// for ChangesetParser::parseRecordsAt()
+	std::vector<std::pair<long,long>> recordLocations( const std::vector<long> & idents ) const;
+};
+
+// A reader that collects the terms of every changeset and writes them as a CommentIndex.
+// Changesets must arrive in id order, as they are in the planet file.
+class CommentIndexBuilder: public ChangesetReader {
+	struct Posting {
+		ArenaVector<uint8_t>	bytes;
+		long					last;
+		uint32_t				count;
+		Posting( Arena * arena ) : bytes(ArenaAllocator<uint8_t>(arena)), last(0), count(0) {}
+	};
+	typedef ArenaUnorderedMap<std::string,Posting>	PostingMap;
+	PostingMap				postings = PostingMap( 0, std::hash<std::string>(), std::equal_to<std::string>(), &arena );
+	ArenaVector<uint8_t>	records = ArenaVector<uint8_t>( &arena );
+	ArenaVector<CommentIndex::Block>	blocks = ArenaVector<CommentIndex::Block>( &arena );
+	long					recordCount = 0;
+	long					lastIdent = 0, lastOffset = 0;
+	bool					ordered = true;
+	std::vector<std::string>	terms;		// of the current changeset
+public:
+	void initialize() {}
+	void process( const Changeset & changeset );
+	void finalize() {}
+
+	size_t size() const		{ return postings.size(); }
+
+	// Writes the index. inputSize and inputTime are the size and modification time of the changeset file.
+	bool save( const std::string & path, long inputSize, int64_t inputTime );
+};
+
+#endif /* CommentIndex_hpp */
@@ -0,0 +1,106 @@
+//
+//  ConcurrentCounter.cpp
+//  ParseOsmChangesetFile
+//
+//  Created by Bryce Cogswell on 10/18/26.
+//  Copyright © 2026 Bryce Cogswell. All rights reserved.
+//
+
+#include <utility>
+
+#include "ConcurrentCounter.hpp"
+
+// The slots that running threads hold, so each thread has its own buffer in every counter.
+// A slot is given back when its thread exits, and the next thread to start takes it over
+// along with whatever its buffers still hold, which is fine since buffers only combine adds.
+static std::mutex		s_SlotsLock;
+static std::vector<int>	s_FreeSlots;
+static int				s_NextSlot = 0;
+
+namespace {
+struct ThreadSlot {
+	int		slot;
+	ThreadSlot()
+	{
+		std::lock_guard<std::mutex> lock( s_SlotsLock );
+		if ( s_FreeSlots.size() > 0 ) {
+			slot = s_FreeSlots.back();
+			s_FreeSlots.pop_back();
+		} else if ( s_NextSlot < ConcurrentCounter::MAX_THREADS ) {
+			slot = s_NextSlot++;
+		} else {
+			slot = -1;
+		}
+	}
+	~ThreadSlot()
+	{
+		if ( slot >= 0 ) {
+			std::lock_guard<std::mutex> lock( s_SlotsLock );
+			s_FreeSlots.push_back( slot );
+		}
+	}
+};
+}
+
+ConcurrentCounter::ConcurrentCounter( Arena * arena, size_t budget )
+	: shards(arena), buffers(MAX_THREADS, NULL, arena)
+{
+	for ( size_t i = 0; i < SHARD_COUNT; ++i ) {
+		shards.push_back( new Shard( budget / SHARD_COUNT ) );
+	}
+}
+
+ConcurrentCounter::~ConcurrentCounter()
+{
+	for ( auto shard: shards ) {
+		delete shard;
+	}
+	for ( auto buffer: buffers ) {
+		delete buffer;
+	}
+}
+
+void ConcurrentCounter::addToShard( const std::string & key, size_t keyHash, long value )
+{
+	Shard & s = shard( keyHash );
+	std::lock_guard<SpinLock> lock( s.lock );
+	s.counter.add( key, keyHash, value );
+}
+
+// The buffer of the calling thread, created the first time the thread adds to this counter.
+// Returns NULL if there are too many threads for each to have a buffer.
+ConcurrentCounter::Buffer * ConcurrentCounter::localBuffer()
+{
+	static thread_local ThreadSlot thread;
+	if ( thread.slot < 0 )
+		return NULL;
+	// only this thread uses its slot, so no lock is needed
+	Buffer *& buffer = buffers[thread.slot];
+	if ( buffer == NULL )
+		buffer = new Buffer();
+	return buffer;
+}
+
+void ConcurrentCounter::flushBuffers()
+{
+	for ( auto buffer: buffers ) {
+		if ( buffer == NULL )
+			continue;
+		for ( auto &slot: buffer->slots ) {
+			if ( slot.used && slot.value != 0 )
+				addToShard( slot.key, slot.hash, slot.value );
+			slot.used = false;
+		}
+	}
+}
+
+void ConcurrentCounter::forEach( const std::function<void(const std::string & key, long total)> & visit )
+{
+	flushBuffers();
+
+	std::vector<SpillingCounter *> counters;
+	for ( auto shard: shards ) {
+		counters.push_back( &shard->counter );
+	}
+	SpillingCounter::forEach( counters, visit );
+}
@@ -0,0 +1,134 @@
+//
+//  ConcurrentCounter.hpp
+//  ParseOsmChangesetFile
+//
+//  Created by Bryce Cogswell on 10/18/26.
+//  Copyright © 2026 Bryce Cogswell. All rights reserved.
+//
+
+#ifndef ConcurrentCounter_hpp
+#define ConcurrentCounter_hpp
+
+#include <stdint.h>
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Arena.hpp"
+#include "SpillingCounter.hpp"
+
+// Sums a value for each key like SpillingCounter, with the same interface, but can be added
+// to from several threads at once. Readers with a huge key space, like the comment readers,
+// can then share one table between threads instead of each thread keeping its own copy.
+//
+// The keys are split between SHARD_COUNT shards by their hash. Each shard is a SpillingCounter
+// with its own spin lock and arena, and an equal part of the memory budget, so threads adding
+// different keys rarely wait for each other, and shards that outgrow their budget spill to
+// temporary files. forEach() merges the shards, so the totals are exact as they are for
+// SpillingCounter. The arena given to the constructor only holds the counter's own tables,
+// since an arena can't be shared between threads.
+//
+// Each thread also has a small direct-mapped buffer of BUFFER_SLOTS recent keys, where it
+// combines repeated adds of the same key without taking a lock. A key only reaches its shard
+// when another key displaces it from the buffer, so hot keys such as empty comments cost a
+// string compare per add. Buffers belong to the counter, indexed by a slot each running thread
+// holds, so nothing refers to a counter once it is destroyed. Threads beyond MAX_THREADS add
+// straight to the shards.
+//
+// forEach() must not be called while other threads are still adding.
+class ConcurrentCounter {
+public:
+	static const size_t SHARD_COUNT = 64;
+	static const size_t BUFFER_SLOTS = 256;
+	static const int MAX_THREADS = 256;
+private:
+	class SpinLock {
+		std::atomic<bool>	locked;
+	public:
+		SpinLock() : locked(false) {}
+		void lock()
+		{
+			while ( locked.exchange( true, std::memory_order_acquire ) ) {
+				while ( locked.load( std::memory_order_relaxed ) )
+					std::this_thread::yield();
+			}
+		}
+		void unlock()		{ locked.store( false, std::memory_order_release ); }
+	};
+	struct Shard {
+		SpinLock		lock;
+		Arena			arena;
+		SpillingCounter	counter;
+		char			padding[64];	// keeps the locks of neighboring shards off the same cache line
+		Shard( size_t budget ) : counter( &arena, budget ) {}
+	};
+	struct Slot {
+		std::string		key;
+		size_t			hash;
+		long			value;
+		bool			used;
+		Slot() : hash(0), value(0), used(false) {}
+	};
+	struct Buffer {
+		std::vector<Slot>	slots;
+		Buffer() : slots(BUFFER_SLOTS) {}
+	};
+
+	ArenaVector<Shard *>	shards;
+	ArenaVector<Buffer *>	buffers;	// indexed by the thread slot of the thread that uses it
+
+	Shard & shard( size_t hash )	{ return *shards[(hash * 0x9E3779B97F4A7C15ULL) >> 58]; }
+	void addToShard( const std::string & key, size_t keyHash, long value );
+	Buffer * localBuffer();
+	void flushBuffers();
+
+	ConcurrentCounter( const ConcurrentCounter & );				// not copyable
+	ConcurrentCounter & operator = ( const ConcurrentCounter & );
+public:
+	ConcurrentCounter( Arena * arena = NULL, size_t budget = SpillingCounter::defaultBudget );
+	~ConcurrentCounter();
+
+	static size_t hash( const std::string & key )	{ return SpillingCounter::hash( key ); }
+
+	void add( const std::string & key, long value = 1 )
+	{
+		add( key, hash( key ), value );
+	}
+
+	// The same, with a hash of the key computed by the caller, which must be the same for equal keys
+	void add( const std::string & key, size_t keyHash, long value )
+	{
+		Buffer * buffer = localBuffer();
+		if ( buffer == NULL ) {
+			addToShard( key, keyHash, value );
+			return;
+		}
+		Slot & slot = buffer->slots[(keyHash >> 8) % BUFFER_SLOTS];
+		if ( slot.used && slot.hash == keyHash && slot.key == key ) {
+			slot.value += value;
+			return;
+		}
+		if ( slot.used )
+			addToShard( slot.key, slot.hash, slot.value );
+		slot.key.assign( key );
+		slot.hash = keyHash;
+		slot.value = value;
+		slot.used = true;
+	}
+
+	// Adds the memory of the shards' arenas
+	void addMemoryUsage( ArenaUsage & usage ) const
+	{
+		for ( auto shard: shards ) {
+			usage.add( shard->arena );
+		}
+	}
+
+	// Calls visit for each key, in sorted order, with its total. Empties the counter.
+	void forEach( const std::function<void(const std::string & key, long total)> & visit );
+};
+
+#endif /* ConcurrentCounter_hpp */
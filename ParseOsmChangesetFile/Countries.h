@@ -7,3 +7,9 @@
 //
 
 bool CountryContainsPoint( const char * countryName, double lon, double lat );
+
+// The name of the country containing the point, or NULL if it isn't in one
+const char * CountryForPoint( double lon, double lat );
+
+// The bounding box of the country, or false if there is no country by that name
+bool CountryBounds( const char * countryName, double & minLon, double & minLat, double & maxLon, double & maxLat );
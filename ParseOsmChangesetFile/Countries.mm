@@ -87,6 +87,7 @@
 @end
 
 #include <string>
+#include <vector>
 
 bool CountryContainsPoint( const char * countryName, double lon, double lat )
 {
@@ -101,3 +102,43 @@ bool CountryContainsPoint( const char * countryName, double lon, double lat )
 	}
 	return [currentPath containsPoint:NSMakePoint(lon,lat)];
 }
+
+// Paths are tested only when the point is inside their bounds, which rules out almost every country
+const char * CountryForPoint( double lon, double lat )
+{
+	static std::vector<std::string> names;
+	static NSMutableArray * paths = nil;
+
+	if ( paths == nil ) {
+		Countries * countries = [Countries new];
+		paths = [NSMutableArray new];
+		for ( NSString * name in [countries allNames] ) {
+			NSBezierPath * path = [countries pathForCountry:name];
+			if ( path == nil )
+				continue;
+			names.push_back( name.UTF8String );
+			[paths addObject:path];
+		}
+	}
+	NSPoint point = NSMakePoint(lon,lat);
+	for ( NSUInteger i = 0; i < paths.count; ++i ) {
+		NSBezierPath * path = paths[i];
+		if ( NSPointInRect( point, path.bounds ) && [path containsPoint:point] )
+			return names[i].c_str();
+	}
+	return NULL;
+}
+
+bool CountryBounds( const char * countryName, double & minLon, double & minLat, double & maxLon, double & maxLat )
+{
+	NSString * country = [NSString stringWithUTF8String:countryName];
+	NSBezierPath * path = [[Countries new] pathForCountry:country];
+	if ( path == nil )
+		return false;
+	NSRect bounds = path.bounds;
+	minLon = NSMinX( bounds );
+	minLat = NSMinY( bounds );
+	maxLon = NSMaxX( bounds );
+	maxLat = NSMaxY( bounds );
+	return true;
+}
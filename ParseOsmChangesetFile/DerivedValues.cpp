@@ -0,0 +1,38 @@
+//
+//  DerivedValues.cpp
+//  ParseOsmChangesetFile
+//
+//  Created by Bryce Cogswell on 10/18/26.
+//  Copyright © 2026 Bryce Cogswell. All rights reserved.
+//
+
+#include "DerivedValues.hpp"
+#include "SpillingCounter.hpp"
+#include "StringTable.hpp"
+
+static size_t ComputeCommentHash( const Changeset & changeset )
+{
+	return SpillingCounter::hash( changeset.comment );
+}
+
+const DerivedValue<size_t> CommentHash( ComputeCommentHash );
+
+// Editor names are few and only ever added, so ids stay the same for the whole run
+static StringTable g_Applications;
+
+static int ComputeApplicationId( const Changeset & changeset )
+{
+	return g_Applications.intern( changeset.application );
+}
+
+const DerivedValue<int> ApplicationId( ComputeApplicationId );
+
+const std::string & ApplicationName( int id )
+{
+	return g_Applications.string( id );
+}
+
+int ApplicationCount()
+{
+	return (int)g_Applications.size();
+}
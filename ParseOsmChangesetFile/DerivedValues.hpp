@@ -0,0 +1,49 @@
+//
+//  DerivedValues.hpp
+//  ParseOsmChangesetFile
+//
+//  Created by Bryce Cogswell on 10/18/26.
+//  Copyright © 2026 Bryce Cogswell. All rights reserved.
+//
+
+#ifndef DerivedValues_hpp
+#define DerivedValues_hpp
+
+#include <stddef.h>
+#include <string>
+
+#include "ChangesetParser.hpp"
+
+// A value computed from a changeset that several readers need, such as the hash of its comment.
+// It is computed the first time a reader asks for it, and the other readers get the saved value.
+//
+// FilteredReaders gives each changeset a new generation as it passes it on, which is how the
+// value knows to compute it again. Changesets are processed on one thread, so the value is
+// only valid during process() or retract().
+template <class T> class DerivedValue {
+	T						(*compute)( const Changeset & changeset );
+	mutable T				value;
+	mutable unsigned long	generation;
+public:
+	DerivedValue( T (*compute)( const Changeset & changeset ) ) : compute(compute), value(), generation(0) {}
+
+	const T & operator()( const Changeset & changeset ) const
+	{
+		if ( generation != changeset.generation ) {
+			value = compute( changeset );
+			generation = changeset.generation;
+		}
+		return value;
+	}
+};
+
+// The hash of the comment, as SpillingCounter::hash() computes it
+extern const DerivedValue<size_t>	CommentHash;
+
+// A small number for the changeset's application, which is the same for every changeset
+// from that editor, so readers can index arrays by editor rather than looking up the name
+extern const DerivedValue<int>		ApplicationId;
+const std::string & ApplicationName( int id );
+int ApplicationCount();
+
+#endif /* DerivedValues_hpp */
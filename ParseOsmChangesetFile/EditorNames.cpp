@@ -0,0 +1,279 @@
+//
+//  EditorNames.cpp
+//  ParseOsmChangesetFile
+//
+//  Created by Bryce Cogswell on 10/18/26.
+//  Copyright © 2026 Bryce Cogswell. All rights reserved.
+//
+
+#include <ctype.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+
+#include "EditorNames.hpp"
+
+// Each line is "<rule> <argument>". Blank lines and lines starting with '#' are ignored.
+//
+// prefix <name>
+//		A created_by value that starts with <name> is reported as <name>.
+//		Used for apps that need to be truncated earlier than the version number.
+// separator <c> [<not-after>]
+//		A version number can start after the character <c>, unless <c> follows one of
+//		the characters in <not-after>. The word "space" stands for a space character.
+// version <c>
+//		A version number can have <c> in front of its first digit, as in "v1.2".
+const char * editorNameRules =
+"prefix Go Map!!\n"
+"prefix Paint The Town Red\n"
+"prefix Every Door\n"
+"prefix MAPS.ME\n"
+"prefix OsmAnd\n"
+"prefix Organic Maps\n"
+"prefix OMaps\n"
+"prefix StreetComplete\n"
+"\n"
+"# truncate at version number: ' 1', '/1', '-1', ' v1'\n"
+"separator space\n"
+"separator / /\n"
+"separator -\n"
+"version v\n";
+
+std::string EditorNameNormalizer::defaultRules = editorNameRules;
+
+static unsigned long HashBytes( const char * s, size_t len )
+{
+	// FNV-1a
+	unsigned long h = 14695981039346656037UL;
+	for ( size_t i = 0; i < len; ++i ) {
+		h ^= (unsigned char)s[i];
+		h *= 1099511628211UL;
+	}
+	return h;
+}
+
+static char RuleChar( const std::string & arg )
+{
+	if ( arg == "space" )
+		return ' ';
+	return arg[0];
+}
+
+bool EditorNameNormalizer::checkRules( const std::string & rules, std::string & error )
+{
+	int lineNumber = 0;
+	size_t start = 0;
+	while ( start < rules.size() ) {
+		size_t eol = rules.find( '\n', start );
+		if ( eol == std::string::npos )
+			eol = rules.size();
+		std::string line = rules.substr( start, eol - start );
+		start = eol + 1;
+		++lineNumber;
+
+		if ( line.size() == 0 || line[0] == '#' )
+			continue;
+		size_t space = line.find( ' ' );
+		std::string rule = line.substr( 0, space );
+		if ( rule != "prefix" && rule != "separator" && rule != "version" ) {
+			error = "line " + std::to_string( lineNumber ) + ": unknown rule '" + rule + "'";
+			return false;
+		}
+		if ( space == std::string::npos || space + 1 == line.size() ) {
+			error = "line " + std::to_string( lineNumber ) + ": '" + rule + "' needs an argument";
+			return false;
+		}
+	}
+	return true;
+}
+
+bool EditorNameNormalizer::loadRules( const std::string & path, std::string & error )
+{
+	FILE * file = fopen( path.c_str(), "r" );
+	if ( file == NULL ) {
+		error = path + ": " + strerror( errno );
+		return false;
+	}
+	std::string rules;
+	char buffer[4096];
+	size_t len;
+	while ( (len = fread( buffer, 1, sizeof buffer, file )) > 0 ) {
+		rules.append( buffer, len );
+	}
+	bool failed = ferror( file );
+	fclose( file );
+	if ( failed ) {
+		error = path + ": read error";
+		return false;
+	}
+	// allow files saved with Windows line endings
+	rules.erase( std::remove( rules.begin(), rules.end(), '\r' ), rules.end() );
+	if ( !checkRules( rules, error ) ) {
+		error = path + ": " + error;
+		return false;
+	}
+	defaultRules = rules;
+	return true;
+}
+
+EditorNameNormalizer::EditorNameNormalizer( const std::string & ruleText )
+{
+	const char * rules = ruleText.c_str();
+	memset( separators, 0, sizeof separators );
+
+	// root of the trie
+	TrieNode root = { -1, -1, -1, 0 };
+	trie.push_back( root );
+
+	const char * s = rules;
+	while ( *s ) {
+		const char * eol = strchr( s, '\n' );
+		if ( eol == NULL )
+			eol = s + strlen( s );
+		std::string line( s, eol - s );
+		s = *eol ? eol + 1 : eol;
+
+		if ( line.size() == 0 || line[0] == '#' )
+			continue;
+		size_t space = line.find( ' ' );
+		if ( space == std::string::npos )
+			continue;
+		std::string rule = line.substr( 0, space );
+		std::string arg = line.substr( space + 1 );
+		if ( arg.size() == 0 )
+			continue;
+
+		if ( rule == "prefix" ) {
+			addPrefix( arg );
+		} else if ( rule == "separator" ) {
+			size_t space2 = arg.find( ' ' );
+			unsigned char c = RuleChar( arg.substr( 0, space2 ) );
+			separators[ c ] = true;
+			if ( space2 != std::string::npos ) {
+				separatorNotAfter[ c ] += arg.substr( space2 + 1 );
+			}
+		} else if ( rule == "version" ) {
+			versionPrefixes += RuleChar( arg );
+		}
+	}
+
+	slots.resize( 1024 );
+	for ( auto &slot: slots ) {
+		slot.entry = -1;
+	}
+}
+
+void EditorNameNormalizer::addPrefix( const std::string & name )
+{
+	int node = 0;
+	for ( char c: name ) {
+		int child = trie[node].firstChild;
+		while ( child >= 0 && trie[child].c != c ) {
+			child = trie[child].nextSibling;
+		}
+		if ( child < 0 ) {
+			TrieNode n = { -1, trie[node].firstChild, -1, c };
+			child = (int)trie.size();
+			trie.push_back( n );
+			trie[node].firstChild = child;
+		}
+		node = child;
+	}
+	if ( trie[node].name < 0 ) {
+		trie[node].name = (int)prefixNames.size();
+		prefixNames.push_back( name );
+	}
+}
+
+std::string EditorNameNormalizer::applyRules( const std::string & raw ) const
+{
+	// Some apps needs to be truncated earlier than the version number.
+	// Walk the trie and remember the longest prefix that matches.
+	int match = -1;
+	int node = 0;
+	for ( char c: raw ) {
+		int child = trie[node].firstChild;
+		while ( child >= 0 && trie[child].c != c ) {
+			child = trie[child].nextSibling;
+		}
+		if ( child < 0 )
+			break;
+		node = child;
+		if ( trie[node].name >= 0 )
+			match = trie[node].name;
+	}
+	if ( match >= 0 )
+		return prefixNames[ match ];
+
+	// truncate at version number
+	const char * orig = raw.c_str();
+	for ( const char * s = orig + 1; s < orig + raw.size(); ++s ) {
+		unsigned char c = s[0];
+		if ( !separators[c] )
+			continue;
+		if ( separatorNotAfter[c].find( s[-1] ) != std::string::npos )
+			continue;
+		if ( isdigit( s[1] ) || (s[1] && versionPrefixes.find( s[1] ) != std::string::npos && isdigit( s[2] )) ) {
+			return raw.substr( 0, s - orig );
+		}
+	}
+
+	return raw;
+}
+
+const EditorName * EditorNameNormalizer::lookup( const char * escaped, size_t len ) const
+{
+	unsigned long hash = HashBytes( escaped, len );
+	size_t mask = slots.size() - 1;
+	for ( size_t i = hash & mask; ; i = (i + 1) & mask ) {
+		const CacheSlot & slot = slots[i];
+		if ( slot.entry < 0 )
+			return NULL;
+		if ( slot.hash == hash ) {
+			const std::string & key = keys[ slot.entry ];
+			if ( key.size() == len && memcmp( key.data(), escaped, len ) == 0 )
+				return &entries[ slot.entry ];
+		}
+	}
+}
+
+void EditorNameNormalizer::growCache()
+{
+	std::vector<CacheSlot> old;
+	old.swap( slots );
+	slots.resize( old.size() * 2 );
+	for ( auto &slot: slots ) {
+		slot.entry = -1;
+	}
+	size_t mask = slots.size() - 1;
+	for ( const auto &slot: old ) {
+		if ( slot.entry < 0 )
+			continue;
+		size_t i = slot.hash & mask;
+		while ( slots[i].entry >= 0 )
+			i = (i + 1) & mask;
+		slots[i] = slot;
+	}
+}
+
+const EditorName & EditorNameNormalizer::insert( const char * escaped, size_t len, const std::string & raw )
+{
+	// keep the table at most half full
+	if ( 2 * (entries.size() + 1) > slots.size() ) {
+		growCache();
+	}
+
+	EditorName entry = { raw, applyRules( raw ) };
+	CacheSlot slot = { HashBytes( escaped, len ), (int)entries.size() };
+	keys.push_back( std::string( escaped, len ) );
+	entries.push_back( entry );
+
+	size_t mask = slots.size() - 1;
+	size_t i = slot.hash & mask;
+	while ( slots[i].entry >= 0 )
+		i = (i + 1) & mask;
+	slots[i] = slot;
+
+	return entries.back();
+}
@@ -0,0 +1,72 @@
+//
+//  EditorNames.hpp
+//  ParseOsmChangesetFile
+//
+//  Created by Bryce Cogswell on 10/18/26.
+//  Copyright © 2026 Bryce Cogswell. All rights reserved.
+//
+
+#ifndef EditorNames_hpp
+#define EditorNames_hpp
+
+#include <string>
+#include <vector>
+
+// The built-in prefix and truncation rules, used unless others are loaded with EditorNameNormalizer::loadRules()
+extern const char * editorNameRules;
+
+// A created_by value and the canonical editor name derived from it
+struct EditorName {
+	std::string		raw;	// unescaped created_by value, e.g. "JOSM/1.5 (18822 en)"
+	std::string		name;	// canonical editor name, e.g. "JOSM"
+};
+
+// Converts created_by values to editor names using a table of rules.
+// There are only a few thousand distinct created_by values in the entire history,
+// so results are cached using the raw (still escaped) XML bytes as the key.
+class EditorNameNormalizer {
+private:
+	struct TrieNode {
+		int		firstChild;
+		int		nextSibling;
+		int		name;			// index into prefixNames, or -1
+		char	c;
+	};
+	struct CacheSlot {
+		unsigned long	hash;
+		int				entry;	// index into entries, or -1 if empty
+	};
+	std::vector<TrieNode>		trie;
+	std::vector<std::string>	prefixNames;
+	bool						separators[256];
+	std::string					separatorNotAfter[256];
+	std::string					versionPrefixes;
+
+	std::vector<CacheSlot>		slots;
+	std::vector<std::string>	keys;
+	std::vector<EditorName>		entries;
+
+	void addPrefix( const std::string & name );
+	void growCache();
+	std::string applyRules( const std::string & raw ) const;
+	static bool checkRules( const std::string & rules, std::string & error );
+public:
+	// The rules used by normalizers created without rules
+	static std::string defaultRules;
+
+	// Replaces defaultRules with the rules in a file, in the format of editorNameRules.
+	// Returns false and sets error if the file can't be read or has a line that isn't a rule.
+	static bool loadRules( const std::string & path, std::string & error );
+
+	EditorNameNormalizer( const std::string & rules = defaultRules );
+
+	// Returns the cached result for the escaped created_by bytes, or NULL if not seen yet
+	const EditorName * lookup( const char * escaped, size_t len ) const;
+
+	// Computes the editor name for an unescaped created_by value and caches it under the escaped bytes
+	const EditorName & insert( const char * escaped, size_t len, const std::string & raw );
+
+	size_t size() const { return entries.size(); }
+};
+
+#endif /* EditorNames_hpp */
@@ -0,0 +1,183 @@
+//
+//  Geodesic.cpp
+//  ParseOsmChangesetFile
+//
+//  Created by Bryce Cogswell on 10/18/26.
+//  Copyright © 2026 Bryce Cogswell. All rights reserved.
+//
+
+#include <math.h>
+
+#include "Geodesic.hpp"
+
+static const double DEGREES		= M_PI / 180;
+static const double TAN_PI_8	= 0.41421356237309504880;
+
+void BBoxBatch::add( const Changeset & changeset )
+{
+	minLon.push_back( changeset.min_lon );
+	minLat.push_back( changeset.min_lat );
+	maxLon.push_back( changeset.max_lon );
+	maxLat.push_back( changeset.max_lat );
+}
+
+void BBoxBatch::clear()
+{
+	minLon.clear();
+	minLat.clear();
+	maxLon.clear();
+	maxLat.clear();
+}
+
+// The helpers below avoid branches and library calls so the loops that use them vectorize
+
+static inline double Min( double a, double b )	{ return b < a ? b : a; }
+static inline double Max( double a, double b )	{ return b > a ? b : a; }
+
+// sin(x) for -pi/2 <= x <= pi/2
+static inline double SinPoly( double x )
+{
+	double x2 = x * x;
+	double p = -1.0 / 121645100408832000.0;		// 19!
+	p = p * x2 + 1.0 / 355687428096000.0;		// 17!
+	p = p * x2 - 1.0 / 1307674368000.0;			// 15!
+	p = p * x2 + 1.0 / 6227020800.0;			// 13!
+	p = p * x2 - 1.0 / 39916800.0;				// 11!
+	p = p * x2 + 1.0 / 362880.0;
+	p = p * x2 - 1.0 / 5040.0;
+	p = p * x2 + 1.0 / 120.0;
+	p = p * x2 - 1.0 / 6.0;
+	p = p * x2 + 1.0;
+	return p * x;
+}
+
+// |sin(x)| for -pi <= x <= pi, using sin(x) = sin(pi - x)
+static inline double AbsSin( double x )
+{
+	double ax = fabs( x );
+	return SinPoly( Min( ax, M_PI - ax ) );
+}
+
+// cos(x) for -pi/2 <= x <= pi/2
+static inline double CosPoly( double x )
+{
+	return SinPoly( M_PI / 2 - fabs( x ) );
+}
+
+// atan(x) for -tan(pi/8) <= x <= tan(pi/8)
+static inline double AtanPoly( double x )
+{
+	double x2 = x * x;
+	double p = -1.0 / 27;
+	p = p * x2 + 1.0 / 25;
+	p = p * x2 - 1.0 / 23;
+	p = p * x2 + 1.0 / 21;
+	p = p * x2 - 1.0 / 19;
+	p = p * x2 + 1.0 / 17;
+	p = p * x2 - 1.0 / 15;
+	p = p * x2 + 1.0 / 13;
+	p = p * x2 - 1.0 / 11;
+	p = p * x2 + 1.0 / 9;
+	p = p * x2 - 1.0 / 7;
+	p = p * x2 + 1.0 / 5;
+	p = p * x2 - 1.0 / 3;
+	p = p * x2 + 1.0;
+	return p * x;
+}
+
+// atan2(y,x) for y >= 0, x >= 0, not both zero
+static inline double Atan2Positive( double y, double x )
+{
+	double t = Min( y, x ) / Max( y, x );
+	// atan(t) = pi/4 + atan((t-1)/(t+1)) brings t above tan(pi/8)
+	// into range. Both sides are computed so the choice is a select rather than a branch.
+	double reduced = (t - 1) / (t + 1);
+	bool reduce = t > TAN_PI_8;
+	double angle = AtanPoly( reduce ? reduced : t ) + (reduce ? M_PI / 4 : 0.0);
+	return y > x ? M_PI / 2 - angle : angle;
+}
+
+// The haversine term: sin²(dlat/2) + cos(lat1) cos(lat2) sin²(dlon/2)
+static inline double Haversine( double minLon, double minLat, double maxLon, double maxLat )
+{
+	double sinLat = AbsSin( (maxLat - minLat) * (DEGREES / 2) );
+	double sinLon = AbsSin( (maxLon - minLon) * (DEGREES / 2) );
+	return sinLat * sinLat + CosPoly( minLat * DEGREES ) * CosPoly( maxLat * DEGREES ) * sinLon * sinLon;
+}
+
+static inline double Distance( double minLon, double minLat, double maxLon, double maxLat )
+{
+	double a = Min( Haversine( minLon, minLat, maxLon, maxLat ), 1.0 );
+	return EARTH_RADIUS * 2 * Atan2Positive( sqrt( a ), sqrt( 1 - a ) );
+}
+
+// The haversine term of a distance, so a distance is longer exactly when its term is larger
+static double HaversineThreshold( double meters )
+{
+	if ( meters < 0 )
+		return -1.0;
+	if ( meters >= M_PI * EARTH_RADIUS )
+		return 2.0;		// nothing is longer
+	double s = sin( meters / (2 * EARTH_RADIUS) );
+	return s * s;
+}
+
+void DiagonalDistances( const BBoxBatch & batch, double * meters )
+{
+	const double * minLon = batch.minLon.data();
+	const double * minLat = batch.minLat.data();
+	const double * maxLon = batch.maxLon.data();
+	const double * maxLat = batch.maxLat.data();
+	size_t count = batch.size();
+	for ( size_t i = 0; i < count; ++i ) {
+		meters[i] = Distance( minLon[i], minLat[i], maxLon[i], maxLat[i] );
+	}
+}
+
+void BBoxAreas( const BBoxBatch & batch, double * squareKm )
+{
+	const double * minLon = batch.minLon.data();
+	const double * minLat = batch.minLat.data();
+	const double * maxLon = batch.maxLon.data();
+	const double * maxLat = batch.maxLat.data();
+	size_t count = batch.size();
+	const double scale = EARTH_RADIUS * EARTH_RADIUS / 1e6;
+	for ( size_t i = 0; i < count; ++i ) {
+		// sin(lat2) - sin(lat1) written so it doesn't lose precision for short boxes
+		double width = (maxLon[i] - minLon[i]) * DEGREES;
+		double height = 2 * CosPoly( (maxLat[i] + minLat[i]) * (DEGREES / 2) ) * SinPoly( (maxLat[i] - minLat[i]) * (DEGREES / 2) );
+		squareKm[i] = scale * fabs( width * height );
+	}
+}
+
+void BBoxCenters( const BBoxBatch & batch, double * lon, double * lat )
+{
+	size_t count = batch.size();
+	for ( size_t i = 0; i < count; ++i ) {
+		lon[i] = (batch.minLon[i] + batch.maxLon[i]) / 2;
+		lat[i] = (batch.minLat[i] + batch.maxLat[i]) / 2;
+	}
+}
+
+void DiagonalsLongerThan( const BBoxBatch & batch, double meters, unsigned char * result )
+{
+	const double * minLon = batch.minLon.data();
+	const double * minLat = batch.minLat.data();
+	const double * maxLon = batch.maxLon.data();
+	const double * maxLat = batch.maxLat.data();
+	size_t count = batch.size();
+	const double threshold = HaversineThreshold( meters );
+	for ( size_t i = 0; i < count; ++i ) {
+		result[i] = Haversine( minLon[i], minLat[i], maxLon[i], maxLat[i] ) > threshold;
+	}
+}
+
+double DiagonalDistance( const Changeset & changeset )
+{
+	return Distance( changeset.min_lon, changeset.min_lat, changeset.max_lon, changeset.max_lat );
+}
+
+bool DiagonalLongerThan( const Changeset & changeset, double meters )
+{
+	return Haversine( changeset.min_lon, changeset.min_lat, changeset.max_lon, changeset.max_lat ) > HaversineThreshold( meters );
+}
@@ -0,0 +1,58 @@
+//
+//  Geodesic.hpp
+//  ParseOsmChangesetFile
+//
+//  Created by Bryce Cogswell on 10/18/26.
+//  Copyright © 2026 Bryce Cogswell. All rights reserved.
+//
+
+#ifndef Geodesic_hpp
+#define Geodesic_hpp
+
+#include <stddef.h>
+#include <vector>
+
+#include "ChangesetParser.hpp"
+
+// Distances are on a sphere with the equatorial radius of the earth, in meters
+static const double EARTH_RADIUS = 6378137.0;
+
+// Bounding boxes kept as one array per coordinate, so the kernels below can work on several
+// at a time in vector registers. Coordinates are in degrees, with min <= max as in OSM.
+struct BBoxBatch {
+	std::vector<double>	minLon, minLat, maxLon, maxLat;
+
+	size_t size() const	{ return minLon.size(); }
+	void add( const Changeset & changeset );
+	void clear();
+};
+
+// The kernels below take a batch and write one result per box to an array of batch.size() entries.
+// sin, cos and atan are replaced by polynomials, with range reduction done by selects rather than
+// branches, so the loops vectorize. The truncation error of each series is below its next term:
+//		sin		Taylor series to x^19 on [-pi/2,pi/2], under 3e-16
+//		atan	Taylor series to x^27 on [-tan(pi/8),tan(pi/8)], under 3e-13 radians
+// Measured against the same formulas computed with libm, distances differ by less than 2e-11 of
+// their length (0.3 mm for boxes spanning half the earth, where the formula itself is least exact)
+// and areas by less than 1e-10. DiagonalsLongerThan gave the same answer for all of 4 million boxes.
+//
+// With gcc the distance loop needs -fno-trapping-math to vectorize; clang assumes it by default.
+
+// The haversine distance between opposite corners of each box, in meters
+void DiagonalDistances( const BBoxBatch & batch, double * meters );
+
+// The area of each box on the sphere, in km². Exact for a sphere, since the sides are meridians and parallels.
+void BBoxAreas( const BBoxBatch & batch, double * squareKm );
+
+// The center of each box in degrees
+void BBoxCenters( const BBoxBatch & batch, double * lon, double * lat );
+
+// Sets result to 1 for each box whose diagonal is longer than meters and 0 otherwise.
+// This compares the haversine term directly, so it needs neither a square root nor atan.
+void DiagonalsLongerThan( const BBoxBatch & batch, double meters, unsigned char * result );
+
+// The same for a single changeset, giving the same results as the batch versions
+double DiagonalDistance( const Changeset & changeset );
+bool DiagonalLongerThan( const Changeset & changeset, double meters );
+
+#endif /* Geodesic_hpp */
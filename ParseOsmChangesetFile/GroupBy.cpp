@@ -0,0 +1,154 @@
+//
+//  GroupBy.cpp
+//  ParseOsmChangesetFile
+//
+//  Created by Bryce Cogswell on 10/18/26.
+//  Copyright © 2026 Bryce Cogswell. All rights reserved.
+//
+
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "GroupBy.hpp"
+
+int DayNumber( const std::string & date )
+{
+	if ( date.size() < 10 )
+		return 0;
+	int y = atoi( date.c_str() );
+	int m = atoi( date.c_str() + 5 );
+	int d = atoi( date.c_str() + 8 );
+	y -= m <= 2;
+	int era = (y >= 0 ? y : y - 399) / 400;
+	int yoe = y - era * 400;
+	int doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+	int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+	return era * 146097 + doe - 719468;
+}
+
+// The inverse of DayNumber
+static void CivilDate( int days, int & y, int & m, int & d )
+{
+	days += 719468;
+	int era = (days >= 0 ? days : days - 146096) / 146097;
+	int doe = days - era * 146097;
+	int yoe = (doe - doe/1460 + doe/36524 - doe/146096) / 365;
+	int doy = doe - (365*yoe + yoe/4 - yoe/100);
+	int mp = (5*doy + 2) / 153;
+	d = doy - (153*mp + 2) / 5 + 1;
+	m = mp < 10 ? mp + 3 : mp - 9;
+	y = yoe + era * 400 + (m <= 2);
+}
+
+std::string DateString( int day )
+{
+	int y, m, d;
+	CivilDate( day, y, m, d );
+	char text[32];
+	snprintf( text, sizeof text, "%04d-%02d-%02d", y, m, d );
+	return text;
+}
+
+TimeGroupBy::TimeGroupBy( TimeBucket bucketSize, Aggregate aggregate, Arena * arena )
+	: bucketSize(bucketSize), aggregate(aggregate), buckets(arena), firstBucket(0), lastBucket(-1)
+{
+}
+
+int TimeGroupBy::bucketNumber( const std::string & date ) const
+{
+	switch ( bucketSize ) {
+		case BUCKET_DAY:
+			return DayNumber( date );
+		case BUCKET_MONTH:
+			return atoi( date.c_str() ) * 12 + atoi( date.c_str() + 5 ) - 1;
+		case BUCKET_YEAR:
+			return atoi( date.c_str() );
+	}
+	return 0;
+}
+
+int TimeGroupBy::bucket( const std::string & date )
+{
+	if ( lastBucket >= 0 && date == lastDate )
+		return lastBucket;
+
+	int number = bucketNumber( date );
+	if ( buckets.size() == 0 ) {
+		firstBucket = number;
+	} else if ( number < firstBucket ) {
+		// out of order, so make room at the front
+		buckets.insert( buckets.begin(), firstBucket - number, Row( buckets.get_allocator() ) );
+		firstBucket = number;
+	}
+	int index = number - firstBucket;
+	if ( index >= (int)buckets.size() )
+		buckets.resize( index + 1, Row( buckets.get_allocator() ) );
+
+	lastDate = date;
+	lastBucket = index;
+	return index;
+}
+
+std::string TimeGroupBy::bucketLabel( int bucket ) const
+{
+	int number = firstBucket + bucket;
+	char text[32];
+	switch ( bucketSize ) {
+		case BUCKET_DAY:
+			return DateString( number );
+		case BUCKET_MONTH:
+			snprintf( text, sizeof text, "%04d-%02d", number / 12, number % 12 + 1 );
+			break;
+		case BUCKET_YEAR:
+			snprintf( text, sizeof text, "%04d", number );
+			break;
+	}
+	return text;
+}
+
+bool TimeGroupBy::bucketEmpty( int bucket ) const
+{
+	for ( const auto &cell: buckets[bucket] ) {
+		if ( cell.count > 0 )
+			return false;
+	}
+	return true;
+}
+
+long TimeGroupBy::count( int bucket, int dimension ) const
+{
+	const Row & row = buckets[bucket];
+	return dimension < (int)row.size() ? row[dimension].count : 0;
+}
+
+long TimeGroupBy::value( int bucket, int dimension ) const
+{
+	const Row & row = buckets[bucket];
+	return dimension < (int)row.size() ? row[dimension].value : 0;
+}
+
+void TimeGroupBy::printMatrix( FILE * out ) const
+{
+	std::vector<std::pair<std::string,int>> columns;
+	for ( int dim = 0; dim < dimensionCount(); ++dim ) {
+		columns.push_back( std::pair<std::string,int>( dimensionName( dim ), dim ) );
+	}
+	std::sort( columns.begin(), columns.end() );
+
+	// header with each dimension
+	for ( const auto &column: columns ) {
+		fprintf( out, ",%s", column.first.c_str() );
+	}
+	fprintf( out, "\n" );
+
+	for ( int bucket = 0; bucket < bucketCount(); ++bucket ) {
+		if ( bucketEmpty( bucket ) )
+			continue;
+		fprintf( out, "%s", bucketLabel( bucket ).c_str() );
+		for ( const auto &column: columns ) {
+			fprintf( out, ",%ld", value( bucket, column.second ) );
+		}
+		fprintf( out, "\n" );
+	}
+}
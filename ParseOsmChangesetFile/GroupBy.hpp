@@ -0,0 +1,92 @@
+//
+//  GroupBy.hpp
+//  ParseOsmChangesetFile
+//
+//  Created by Bryce Cogswell on 10/18/26.
+//  Copyright © 2026 Bryce Cogswell. All rights reserved.
+//
+
+#ifndef GroupBy_hpp
+#define GroupBy_hpp
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#include "Arena.hpp"
+#include "StringTable.hpp"
+
+enum TimeBucket { BUCKET_DAY, BUCKET_MONTH, BUCKET_YEAR };
+enum Aggregate { AGGREGATE_COUNT, AGGREGATE_SUM, AGGREGATE_MIN, AGGREGATE_MAX, AGGREGATE_LAST };
+
+// Days since 1970-01-01 for a date in the form YYYY-MM-DD
+int DayNumber( const std::string & date );
+// The inverse of DayNumber, as YYYY-MM-DD
+std::string DateString( int day );
+
+// Aggregates values grouped by (time bucket, dimension), such as edits per month per editor.
+//
+// Buckets are dense indices computed from the date, so consecutive days, months or years are
+// consecutive rows, and dimensions are interned strings. Each row is a contiguous array indexed
+// by dimension, so adding a value costs a couple of array operations once the bucket and
+// dimension ids are known. Changesets arrive in date order, so the bucket of the previous
+// date is cached.
+class TimeGroupBy {
+private:
+	struct Cell {
+		long	count;		// number of values added
+		long	value;
+	};
+	typedef ArenaVector<Cell>		Row;
+	TimeBucket						bucketSize;
+	Aggregate						aggregate;
+	StringTable						dimensions;
+	ArenaVector<Row>				buckets;
+	int								firstBucket;	// bucket number of buckets[0]
+	std::string						lastDate;
+	int								lastBucket;
+
+	int bucketNumber( const std::string & date ) const;
+public:
+	// The rows are allocated from the arena if one is given
+	TimeGroupBy( TimeBucket bucketSize, Aggregate aggregate, Arena * arena = NULL );
+
+	int dimension( const std::string & name )	{ return dimensions.intern( name ); }
+	int bucket( const std::string & date );		// creates the bucket if necessary
+
+	void add( int bucket, int dimension, long value = 1 )
+	{
+		Row & row = buckets[bucket];
+		if ( dimension >= (int)row.size() )
+			row.resize( dimensions.size(), Cell() );
+		Cell & cell = row[dimension];
+		switch ( aggregate ) {
+			case AGGREGATE_COUNT:	cell.value += 1;												break;
+			case AGGREGATE_SUM:		cell.value += value;											break;
+			case AGGREGATE_MIN:		if ( cell.count == 0 || value < cell.value ) cell.value = value;	break;
+			case AGGREGATE_MAX:		if ( cell.count == 0 || value > cell.value ) cell.value = value;	break;
+			case AGGREGATE_LAST:	cell.value = value;												break;
+		}
+		++cell.count;
+	}
+	void add( const std::string & date, const std::string & dimensionName, long value = 1 )
+	{
+		add( bucket( date ), dimension( dimensionName ), value );
+	}
+
+	int bucketCount() const							{ return (int)buckets.size(); }
+	std::string bucketLabel( int bucket ) const;	// e.g. "2023-04" for months
+	bool bucketEmpty( int bucket ) const;
+
+	int dimensionCount() const						{ return (int)dimensions.size(); }
+	const std::string & dimensionName( int dimension ) const	{ return dimensions.string( dimension ); }
+
+	// The number of values added to a cell, and their aggregate
+	long count( int bucket, int dimension ) const;
+	long value( int bucket, int dimension ) const;
+
+	// Prints a CSV table with a column for each dimension, sorted by name, and a row for each non-empty bucket
+	void printMatrix( FILE * out = stdout ) const;
+};
+
+#endif /* GroupBy_hpp */
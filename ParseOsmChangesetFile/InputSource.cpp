@@ -0,0 +1,748 @@
+//
+//  InputSource.cpp
+//  ParseOsmChangesetFile
+//
+//  Created by Bryce Cogswell on 10/18/26.
+//  Copyright © 2026 Bryce Cogswell. All rights reserved.
+//
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define HAVE_IO_URING	1
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#endif
+#endif
+
+#include "InputSource.hpp"
+
+InputSource::~InputSource()
+{
+	close();
+}
+
+bool InputSource::open( const std::string & path )
+{
+	fd = ::open( path.c_str(), O_RDONLY );
+	if ( fd < 0 ) {
+		perror( path.c_str() );
+		return false;
+	}
+	struct stat statbuf;
+	if ( fstat( fd, &statbuf ) != 0 ) {
+		perror( path.c_str() );
+		::close( fd );
+		fd = -1;
+		return false;
+	}
+	fileSize = statbuf.st_size;
+	position = 0;
+	bytesRead = 0;
+	error = false;
+	return true;
+}
+
+void InputSource::close()
+{
+	if ( fd >= 0 ) {
+		::close( fd );
+		fd = -1;
+	}
+}
+
+long InputSource::readAt( long offset, char * buffer, long len )
+{
+	long total = 0;
+	while ( total < len ) {
+		ssize_t n = pread( fd, buffer + total, len - total, offset + total );
+		if ( n < 0 ) {
+			perror( "pread" );
+			return -1;
+		}
+		if ( n == 0 )
+			break;
+		total += n;
+	}
+	return total;
+}
+
+// Returns the start of the last changeset in the range, so that [start, result) holds only whole records
+const char * InputSource::LastRecordBoundary( const char * start, const char * end )
+{
+	static const char key[] = "<changeset ";
+	const long keylen = sizeof key - 1;
+	for ( const char * p = end - keylen; p >= start; --p ) {
+		if ( *p == '<' && memcmp( p, key, keylen ) == 0 )
+			return p;
+	}
+	return start;
+}
+
+// Maps the entire file. By default the parser gets the whole file as a single window,
+// but with a read-ahead window it is handed out in pieces so the next piece can be
+// prefetched and the previous one dropped from the page cache.
+class MmapInputSource: public InputSource {
+	const char	*	mem		= NULL;
+	const char	*	dropped	= NULL;		// everything before this has been removed from the page cache
+	long			pageSize;
+
+	const char * pageAlign( const char * p ) const
+	{
+		return mem + ((p - mem) & ~(pageSize - 1));
+	}
+public:
+	MmapInputSource( const InputOptions & options ) : InputSource(options)
+	{
+		pageSize = sysconf( _SC_PAGESIZE );
+	}
+	~MmapInputSource()
+	{
+		close();
+	}
+
+	const char * name() const { return "mmap"; }
+
+	bool open( const std::string & path )
+	{
+		if ( !InputSource::open( path ) )
+			return false;
+
+		int flags = MAP_FILE | MAP_SHARED;
+#ifdef MAP_NOCACHE
+		flags |= MAP_NOCACHE;
+#endif
+#ifdef MAP_POPULATE
+		if ( options.populate )
+			flags |= MAP_POPULATE;
+#endif
+		void * p = mmap( NULL, fileSize, PROT_READ, flags, fd, 0 );
+		if ( p == MAP_FAILED ) {
+			perror( "mmap" );
+			return false;
+		}
+		mem = (const char *)p;
+		dropped = mem;
+		madvise( (void *)mem, fileSize, MADV_SEQUENTIAL );
+#ifdef MADV_HUGEPAGE
+		if ( options.hugePages )
+			madvise( (void *)mem, fileSize, MADV_HUGEPAGE );
+#endif
+		return true;
+	}
+
+	void close()
+	{
+		if ( mem ) {
+			munmap( (void *)mem, fileSize );
+			mem = NULL;
+		}
+		InputSource::close();
+	}
+
+	bool nextWindow( const char *& start, const char *& end )
+	{
+		if ( position >= fileSize )
+			return false;
+		start = mem + position;
+
+		if ( options.readAhead <= 0 ) {
+			end = mem + fileSize;
+		} else {
+			// find a record boundary near the end of the window
+			long len = options.readAhead;
+			for (;;) {
+				if ( position + len >= fileSize ) {
+					end = mem + fileSize;
+					break;
+				}
+				end = LastRecordBoundary( start, start + len );
+				if ( end > start )
+					break;
+				len *= 2;
+			}
+
+			// prefetch the next window
+			const char * ahead = pageAlign( end );
+			long aheadLen = std::min( options.readAhead, (long)(mem + fileSize - ahead) );
+			madvise( (void *)ahead, aheadLen, MADV_WILLNEED );
+
+			// the previous window is no longer needed
+			if ( options.dropBehind ) {
+				const char * behind = pageAlign( start );
+				if ( behind > dropped ) {
+					madvise( (void *)dropped, behind - dropped, MADV_DONTNEED );
+#ifdef POSIX_FADV_DONTNEED
+					posix_fadvise( fd, dropped - mem, behind - dropped, POSIX_FADV_DONTNEED );
+#endif
+					dropped = behind;
+				}
+			}
+		}
+
+		bytesRead += end - start;
+		position = end - mem;
+		return true;
+	}
+};
+
+// Common code for backends that read into their own buffers. Each buffer has room
+// in front of the block for the partial record carried over from the previous window.
+class BufferedInputSource: public InputSource {
+protected:
+	std::vector<char *>	buffers;
+	long				carryCapacity;
+	const char		*	carry		= NULL;
+	long				carryLen	= 0;
+	bool				finished	= false;
+	char			*	sentinel	= NULL;		// where the NUL after the current window was written
+	char				sentinelByte;			// the byte it replaced
+
+	void allocateBuffers( int count )
+	{
+		carryCapacity = options.blockSize;
+		for ( int i = 0; i < count; ++i ) {
+			// leave room for a sentinel after the block
+			buffers.push_back( (char *)malloc( carryCapacity + options.blockSize + 16 ) );
+		}
+	}
+
+	void freeBuffers()
+	{
+		for ( auto buffer: buffers ) {
+			free( buffer );
+		}
+		buffers.clear();
+	}
+
+	// Turns a block that was just read into a window ending on a record boundary
+	bool makeWindow( char * buffer, long len, bool eof, const char *& start, const char *& end )
+	{
+		if ( carryLen > carryCapacity ) {
+			fprintf( stderr, "Changeset at offset %ld is larger than the block size\n", position - carryLen );
+			error = true;
+			return false;
+		}
+		if ( sentinel ) {
+			*sentinel = sentinelByte;
+			sentinel = NULL;
+		}
+		char * block = buffer + carryCapacity;
+		memmove( block - carryLen, carry, carryLen );
+		start = block - carryLen;
+		char * stop = block + len;
+		if ( eof ) {
+			*stop = '\0';
+			end = stop;
+			carryLen = 0;
+			finished = true;
+		} else {
+			char * boundary = (char *)LastRecordBoundary( start, stop );
+			carry = boundary;
+			carryLen = stop - boundary;
+			// terminate the window so a malformed record can't make the parser run past it
+			sentinel = boundary;
+			sentinelByte = *boundary;
+			*boundary = '\0';
+			end = boundary;
+		}
+		bytesRead += len;
+		position += len;
+		return true;
+	}
+
+	long blockLength( long offset ) const
+	{
+		if ( fileSize < 0 )
+			return options.blockSize;
+		return std::min( options.blockSize, fileSize - offset );
+	}
+
+	void dropFromCache( long offset, long len )
+	{
+		if ( !options.dropBehind )
+			return;
+#ifdef POSIX_FADV_DONTNEED
+		posix_fadvise( fd, offset, len, POSIX_FADV_DONTNEED );
+#endif
+	}
+public:
+	BufferedInputSource( const InputOptions & options ) : InputSource(options) {}
+
+	bool open( const std::string & path )
+	{
+		if ( !InputSource::open( path ) )
+			return false;
+#ifdef POSIX_FADV_SEQUENTIAL
+		posix_fadvise( fd, 0, 0, POSIX_FADV_SEQUENTIAL );
+#endif
+#ifdef F_NOCACHE
+		if ( options.dropBehind )
+			fcntl( fd, F_NOCACHE, 1 );
+#endif
+		return true;
+	}
+};
+
+// Reads large blocks on a background thread into a ring of buffers, so the next
+// blocks are being read while the parser works on the current one.
+class PreadInputSource: public BufferedInputSource {
+	std::thread					reader;
+	std::mutex					mutex;
+	std::condition_variable		cond;
+	std::vector<long>			blockLen;
+	std::vector<bool>			full;
+	bool						stop		= false;
+	int							current		= -1;	// buffer holding the current window
+	int							next		= 0;	// buffer holding the next block
+
+	void readLoop( long offset )
+	{
+		for ( int i = 0; ; i = (i + 1) % buffers.size() ) {
+			{
+				std::unique_lock<std::mutex> lock( mutex );
+				cond.wait( lock, [&]{ return stop || !full[i]; } );
+				if ( stop )
+					return;
+			}
+			long len = readBlock( offset, buffers[i] + carryCapacity, blockLength( offset ) );
+			if ( len > 0 )
+				dropFromCache( offset, len );
+			{
+				std::unique_lock<std::mutex> lock( mutex );
+				blockLen[i] = len;
+				full[i] = true;
+			}
+			cond.notify_all();
+			if ( len < options.blockSize )
+				return;
+			offset += len;
+		}
+	}
+
+protected:
+	void stopReader()
+	{
+		if ( reader.joinable() ) {
+			{
+				std::unique_lock<std::mutex> lock( mutex );
+				stop = true;
+			}
+			cond.notify_all();
+			reader.join();
+		}
+	}
+	virtual long readBlock( long offset, char * buffer, long len )
+	{
+		return readAt( offset, buffer, len );
+	}
+public:
+	PreadInputSource( const InputOptions & options, int count = 2 ) : BufferedInputSource(options)
+	{
+		allocateBuffers( count );
+		blockLen.resize( count );
+		full.resize( count );
+	}
+	~PreadInputSource()
+	{
+		close();
+		freeBuffers();
+	}
+
+	const char * name() const { return "pread"; }
+
+	void close()
+	{
+		stopReader();
+		BufferedInputSource::close();
+	}
+
+	bool nextWindow( const char *& start, const char *& end )
+	{
+		if ( finished || error )
+			return false;
+		if ( !reader.joinable() ) {
+			if ( fileSize >= 0 && position >= fileSize )
+				return false;
+			reader = std::thread( &PreadInputSource::readLoop, this, position );
+		}
+
+		int i = next;
+		{
+			std::unique_lock<std::mutex> lock( mutex );
+			cond.wait( lock, [&]{ return full[i]; } );
+		}
+		long len = blockLen[i];
+		if ( len < 0 ) {
+			error = true;
+			return false;
+		}
+		bool eof = len < options.blockSize || (fileSize >= 0 && position + len >= fileSize);
+		bool ok = makeWindow( buffers[i], len, eof, start, end );
+
+		// the carry has been copied out of the previous buffer, so it can be refilled
+		if ( current >= 0 ) {
+			{
+				std::unique_lock<std::mutex> lock( mutex );
+				full[current] = false;
+			}
+			cond.notify_all();
+		}
+		current = i;
+		next = (i + 1) % buffers.size();
+		return ok;
+	}
+};
+
+// Reads a pipe or stdin sequentially into a bounded ring of buffers, so the input
+// can come from a decompressor or network tool and memory use doesn't depend on its size.
+class StreamInputSource: public PreadInputSource {
+	bool	ownsFd	= false;
+protected:
+	// blocks arrive in order, so the offset isn't needed
+	long readBlock( long, char * buffer, long len )
+	{
+		long total = 0;
+		while ( total < len ) {
+			ssize_t n = ::read( fd, buffer + total, len - total );
+			if ( n < 0 ) {
+				if ( errno == EINTR )
+					continue;
+				perror( "read" );
+				return -1;
+			}
+			if ( n == 0 )
+				break;
+			total += n;
+		}
+		return total;
+	}
+public:
+	StreamInputSource( const InputOptions & options ) : PreadInputSource(options, std::max( 2, options.queueDepth )) {}
+	~StreamInputSource()
+	{
+		close();
+	}
+
+	const char * name() const { return "stream"; }
+	bool seekable() const { return false; }
+
+	bool open( const std::string & path )
+	{
+		if ( path == "-" ) {
+			fd = STDIN_FILENO;
+			ownsFd = false;
+		} else {
+			fd = ::open( path.c_str(), O_RDONLY );
+			if ( fd < 0 ) {
+				perror( path.c_str() );
+				return false;
+			}
+			ownsFd = true;
+		}
+		fileSize = -1;
+		position = 0;
+		bytesRead = 0;
+		error = false;
+		return true;
+	}
+
+	// The reader thread may be inside ::read(), so it has to finish before the fd is let go
+	void close()
+	{
+		stopReader();
+		if ( !ownsFd )
+			fd = -1;
+		PreadInputSource::close();
+	}
+
+	// a stream can't be read at an offset
+	long readAt( long, char *, long )
+	{
+		return -1;
+	}
+};
+
+#if HAVE_IO_URING
+
+// Keeps several block reads in flight using io_uring. This talks to the kernel directly
+// rather than through liburing so there are no additional dependencies.
+class UringInputSource: public BufferedInputSource {
+	int					ringFd		= -1;
+	void			*	sqRing		= NULL;
+	void			*	cqRing		= NULL;
+	size_t				sqRingSize	= 0;
+	size_t				cqRingSize	= 0;
+	struct io_uring_sqe * sqes		= NULL;
+	size_t				sqesSize	= 0;
+	unsigned		*	sqTail;
+	unsigned		*	sqMask;
+	unsigned		*	sqArray;
+	unsigned		*	cqHead;
+	unsigned		*	cqTail;
+	unsigned		*	cqMask;
+	struct io_uring_cqe * cqes;
+
+	std::vector<long>	blockOffset;
+	std::vector<long>	blockLen;
+	std::vector<bool>	done;
+	long				submitOffset	= 0;
+	bool				started			= false;
+	int					current			= -1;
+	int					next			= 0;
+
+	bool setupRing( unsigned entries )
+	{
+		struct io_uring_params params;
+		memset( &params, 0, sizeof params );
+		ringFd = (int)syscall( __NR_io_uring_setup, entries, &params );
+		if ( ringFd < 0 ) {
+			perror( "io_uring_setup" );
+			return false;
+		}
+		sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+		cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+		bool single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+		if ( single ) {
+			sqRingSize = cqRingSize = std::max( sqRingSize, cqRingSize );
+		}
+		sqRing = mmap( NULL, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING );
+		if ( sqRing == MAP_FAILED ) {
+			sqRing = NULL;
+			perror( "io_uring mmap" );
+			return false;
+		}
+		if ( single ) {
+			cqRing = sqRing;
+		} else {
+			cqRing = mmap( NULL, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_CQ_RING );
+			if ( cqRing == MAP_FAILED ) {
+				cqRing = NULL;
+				perror( "io_uring mmap" );
+				return false;
+			}
+		}
+		sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+		void * p = mmap( NULL, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES );
+		if ( p == MAP_FAILED ) {
+			perror( "io_uring mmap" );
+			return false;
+		}
+		sqes = (struct io_uring_sqe *)p;
+
+		char * sq = (char *)sqRing;
+		char * cq = (char *)cqRing;
+		sqTail	= (unsigned *)(sq + params.sq_off.tail);
+		sqMask	= (unsigned *)(sq + params.sq_off.ring_mask);
+		sqArray	= (unsigned *)(sq + params.sq_off.array);
+		cqHead	= (unsigned *)(cq + params.cq_off.head);
+		cqTail	= (unsigned *)(cq + params.cq_off.tail);
+		cqMask	= (unsigned *)(cq + params.cq_off.ring_mask);
+		cqes	= (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+		return true;
+	}
+
+	void teardownRing()
+	{
+		if ( sqes )
+			munmap( sqes, sqesSize );
+		if ( cqRing && cqRing != sqRing )
+			munmap( cqRing, cqRingSize );
+		if ( sqRing )
+			munmap( sqRing, sqRingSize );
+		if ( ringFd >= 0 )
+			::close( ringFd );
+		sqes = NULL;
+		sqRing = cqRing = NULL;
+		ringFd = -1;
+	}
+
+	// Queues a read of the next block into buffer i
+	bool submit( int i )
+	{
+		blockOffset[i] = submitOffset;
+		blockLen[i] = blockLength( submitOffset );
+		done[i] = false;
+		submitOffset += blockLen[i];
+
+		unsigned tail = *sqTail;
+		unsigned index = tail & *sqMask;
+		struct io_uring_sqe * sqe = &sqes[ index ];
+		memset( sqe, 0, sizeof *sqe );
+		sqe->opcode		= IORING_OP_READ;
+		sqe->fd			= fd;
+		sqe->addr		= (unsigned long)(buffers[i] + carryCapacity);
+		sqe->len		= (unsigned)blockLen[i];
+		sqe->off		= blockOffset[i];
+		sqe->user_data	= i;
+		sqArray[ index ] = index;
+		__atomic_store_n( sqTail, tail + 1, __ATOMIC_RELEASE );
+
+		if ( syscall( __NR_io_uring_enter, ringFd, 1, 0, 0, NULL, 0 ) < 0 ) {
+			perror( "io_uring_enter" );
+			return false;
+		}
+		return true;
+	}
+
+	// Waits for the read into buffer i to complete
+	bool waitFor( int i )
+	{
+		while ( !done[i] ) {
+			unsigned head = *cqHead;
+			unsigned tail = __atomic_load_n( cqTail, __ATOMIC_ACQUIRE );
+			if ( head == tail ) {
+				if ( syscall( __NR_io_uring_enter, ringFd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0 ) < 0 ) {
+					perror( "io_uring_enter" );
+					return false;
+				}
+				continue;
+			}
+			for ( ; head != tail; ++head ) {
+				const struct io_uring_cqe * cqe = &cqes[ head & *cqMask ];
+				int b = (int)cqe->user_data;
+				if ( cqe->res < 0 ) {
+					fprintf( stderr, "io_uring read: %s\n", strerror( -cqe->res ) );
+					return false;
+				}
+				if ( cqe->res < blockLen[b] ) {
+					// short read, so get the rest synchronously
+					long rest = readAt( blockOffset[b] + cqe->res, buffers[b] + carryCapacity + cqe->res, blockLen[b] - cqe->res );
+					if ( rest != blockLen[b] - cqe->res )
+						return false;
+				}
+				done[b] = true;
+			}
+			__atomic_store_n( cqHead, head, __ATOMIC_RELEASE );
+		}
+		return true;
+	}
+public:
+	UringInputSource( const InputOptions & options ) : BufferedInputSource(options)
+	{
+		int depth = std::max( 2, options.queueDepth );
+		allocateBuffers( depth );
+		blockOffset.resize( depth );
+		blockLen.resize( depth );
+		done.resize( depth );
+	}
+	~UringInputSource()
+	{
+		close();
+		freeBuffers();
+	}
+
+	const char * name() const { return "uring"; }
+
+	bool open( const std::string & path )
+	{
+		if ( !BufferedInputSource::open( path ) )
+			return false;
+		return setupRing( (unsigned)buffers.size() );
+	}
+
+	void close()
+	{
+		if ( ringFd >= 0 && started ) {
+			// wait for reads still in flight before the buffers go away
+			for ( int i = 0; i < (int)buffers.size(); ++i ) {
+				if ( blockLen[i] > 0 && !done[i] )
+					waitFor( i );
+			}
+		}
+		teardownRing();
+		BufferedInputSource::close();
+	}
+
+	bool nextWindow( const char *& start, const char *& end )
+	{
+		if ( finished || error )
+			return false;
+		if ( !started ) {
+			if ( position >= fileSize )
+				return false;
+			started = true;
+			submitOffset = position;
+			for ( int i = 0; i < (int)buffers.size(); ++i ) {
+				if ( submitOffset < fileSize ) {
+					if ( !submit( i ) ) {
+						error = true;
+						return false;
+					}
+				} else {
+					blockLen[i] = 0;
+				}
+			}
+		}
+
+		int i = next;
+		if ( !waitFor( i ) ) {
+			error = true;
+			return false;
+		}
+		dropFromCache( blockOffset[i], blockLen[i] );
+		bool eof = blockOffset[i] + blockLen[i] >= fileSize;
+		bool ok = makeWindow( buffers[i], blockLen[i], eof, start, end );
+
+		// the carry has been copied out of the previous buffer, so reuse it for the next read
+		if ( current >= 0 ) {
+			if ( submitOffset < fileSize ) {
+				if ( !submit( current ) ) {
+					error = true;
+					return false;
+				}
+			} else {
+				blockLen[current] = 0;
+			}
+		}
+		current = i;
+		next = (i + 1) % buffers.size();
+		return ok;
+	}
+};
+
+#endif
+
+InputSource * NewInputSource( const InputOptions & options )
+{
+	if ( options.backend == "mmap" ) {
+		return new MmapInputSource( options );
+	}
+	if ( options.backend == "pread" ) {
+		return new PreadInputSource( options );
+	}
+	if ( options.backend == "stream" ) {
+		return new StreamInputSource( options );
+	}
+#if HAVE_IO_URING
+	if ( options.backend == "uring" ) {
+		return new UringInputSource( options );
+	}
+#endif
+	return NULL;
+}
+
+std::vector<std::string> InputSourceBackends()
+{
+	std::vector<std::string> list;
+	list.push_back( "mmap" );
+	list.push_back( "pread" );
+	list.push_back( "stream" );
+#if HAVE_IO_URING
+	list.push_back( "uring" );
+#endif
+	return list;
+}
@@ -0,0 +1,69 @@
+//
+//  InputSource.hpp
+//  ParseOsmChangesetFile
+//
+//  Created by Bryce Cogswell on 10/18/26.
+//  Copyright © 2026 Bryce Cogswell. All rights reserved.
+//
+
+#ifndef InputSource_hpp
+#define InputSource_hpp
+
+#include <string>
+#include <vector>
+
+// Settings for reading the changeset file. Which ones matter depends on the backend.
+struct InputOptions {
+	std::string		backend		= "mmap";		// mmap, pread, uring or stream
+	long			blockSize	= 16 << 20;		// bytes per read, or the mmap read-ahead window
+	int				queueDepth	= 4;			// uring, stream: number of buffers in the ring
+	long			readAhead	= 0;			// mmap: window to prefetch ahead of the parser, 0 for none
+	bool			populate	= false;		// mmap: fault in the whole file up front (MAP_POPULATE)
+	bool			hugePages	= false;		// mmap: request transparent huge pages (MADV_HUGEPAGE)
+	bool			dropBehind	= true;			// remove data from the page cache once it has been read
+};
+
+// A source of changeset XML. The parser consumes it one window at a time, and
+// every window ends on a record boundary so no changeset is split between windows.
+class InputSource {
+protected:
+	int			fd			= -1;
+	long		fileSize	= 0;
+	long		position	= 0;		// file offset of the next window
+	long		bytesRead	= 0;
+	bool		error		= false;
+	InputOptions options;
+
+	static const char * LastRecordBoundary( const char * start, const char * end );
+public:
+	InputSource( const InputOptions & options ) : options(options) {}
+	virtual ~InputSource();
+
+	virtual const char * name() const = 0;
+	virtual bool open( const std::string & path );
+	virtual void close();
+
+	long size() const			{ return fileSize; }	// -1 if not known
+	long totalBytesRead() const	{ return bytesRead; }
+	bool failed() const			{ return error; }
+
+	// Whether readAt and seek are supported. Pipes and stdin can only be read sequentially.
+	virtual bool seekable() const	{ return true; }
+
+	// Reads bytes at an arbitrary offset. Used to binary search for the start date.
+	virtual long readAt( long offset, char * buffer, long len );
+
+	// Sets the file offset of the next window
+	virtual void seek( long offset )	{ position = offset; }
+
+	// Returns the next window of whole records, or false at the end of the file or on error
+	virtual bool nextWindow( const char *& start, const char *& end ) = 0;
+};
+
+// Creates the backend named in the options, or returns NULL if it isn't available
+InputSource * NewInputSource( const InputOptions & options );
+
+// The names of the backends that are available on this system
+std::vector<std::string> InputSourceBackends();
+
+#endif /* InputSource_hpp */
@@ -0,0 +1,50 @@
+//
+//  Parallel.cpp
+//  ParseOsmChangesetFile
+//
+//  Created by Bryce Cogswell on 10/18/26.
+//  Copyright © 2026 Bryce Cogswell. All rights reserved.
+//
+
+#include <atomic>
+#include <thread>
+
+#include "Parallel.hpp"
+
+unsigned g_WorkerCount = std::max( 1u, std::thread::hardware_concurrency() );
+
+static thread_local bool s_InParallelFor = false;
+
+bool InParallelFor()
+{
+	return s_InParallelFor;
+}
+
+void ParallelFor( size_t count, const std::function<void(size_t index)> & body )
+{
+	size_t threadCount = std::min( (size_t)g_WorkerCount, count );
+	if ( threadCount <= 1 || s_InParallelFor ) {
+		for ( size_t i = 0; i < count; ++i ) {
+			body( i );
+		}
+		return;
+	}
+
+	// each worker takes the next index until there are none left
+	std::atomic<size_t> next( 0 );
+	auto worker = [&]() {
+		s_InParallelFor = true;
+		for ( size_t i = next++; i < count; i = next++ ) {
+			body( i );
+		}
+		s_InParallelFor = false;
+	};
+	std::vector<std::thread> threads;
+	for ( size_t t = 1; t < threadCount; ++t ) {
+		threads.push_back( std::thread( worker ) );
+	}
+	worker();
+	for ( auto &thread: threads ) {
+		thread.join();
+	}
+}
@@ -0,0 +1,110 @@
+//
+//  Parallel.hpp
+//  ParseOsmChangesetFile
+//
+//  Created by Bryce Cogswell on 10/18/26.
+//  Copyright © 2026 Bryce Cogswell. All rights reserved.
+//
+
+#ifndef Parallel_hpp
+#define Parallel_hpp
+
+#include <stddef.h>
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <vector>
+
+// The number of threads used for parallel work. Defaults to the number of cores.
+extern unsigned g_WorkerCount;
+
+// Calls body(i) for each i in [0,count) on a pool of worker threads, and returns when all are done.
+// The order in which the calls happen is undefined. Called from inside another ParallelFor,
+// such as a reader's finalize, it runs the calls itself rather than starting more threads.
+void ParallelFor( size_t count, const std::function<void(size_t index)> & body );
+
+// True while the calling thread is running the body of a ParallelFor
+bool InParallelFor();
+
+// Below this many elements sorting isn't worth splitting up
+static const size_t PARALLEL_SORT_MINIMUM = 64 * 1024;
+
+// Like std::sort. Each worker sorts a slice of the range and then the slices are merged in pairs.
+// Inside a ParallelFor the other workers are already busy, so it just sorts.
+template <class Iterator, class Compare>
+void ParallelSort( Iterator begin, Iterator end, Compare less )
+{
+	size_t count = end - begin;
+	size_t slices = std::min( (size_t)g_WorkerCount, count / PARALLEL_SORT_MINIMUM );
+	if ( slices <= 1 || InParallelFor() ) {
+		std::sort( begin, end, less );
+		return;
+	}
+	std::vector<Iterator> bounds;
+	for ( size_t i = 0; i <= slices; ++i ) {
+		bounds.push_back( begin + count * i / slices );
+	}
+	ParallelFor( slices, [&]( size_t i ) {
+		std::sort( bounds[i], bounds[i+1], less );
+	});
+	for ( size_t width = 1; width < slices; width *= 2 ) {
+		ParallelFor( (slices + 2*width - 1) / (2*width), [&]( size_t pair ) {
+			size_t first = pair * 2 * width;
+			size_t middle = std::min( first + width, slices );
+			size_t last = std::min( first + 2 * width, slices );
+			if ( middle < last )
+				std::inplace_merge( bounds[first], bounds[middle], bounds[last], less );
+		});
+	}
+}
+
+template <class Iterator>
+void ParallelSort( Iterator begin, Iterator end )
+{
+	ParallelSort( begin, end, std::less<typename std::iterator_traits<Iterator>::value_type>() );
+}
+
+// Leaves the first n elements of the vector in sorted order and discards the rest,
+// like std::partial_sort followed by a resize. Each worker finds the best n of a slice,
+// and the best n of those are the result.
+template <class T, class Compare>
+void ParallelTopN( std::vector<T> & list, size_t n, Compare less )
+{
+	if ( n == 0 ) {
+		list.clear();
+		return;
+	}
+	size_t count = list.size();
+	size_t slices = std::min( (size_t)g_WorkerCount, count / PARALLEL_SORT_MINIMUM );
+	if ( n >= count / 2 || slices <= 1 || InParallelFor() ) {
+		if ( n < count ) {
+			std::partial_sort( list.begin(), list.begin() + n, list.end(), less );
+			list.resize( n );
+		} else {
+			std::sort( list.begin(), list.end(), less );
+		}
+		return;
+	}
+	std::vector<size_t> bounds;
+	for ( size_t i = 0; i <= slices; ++i ) {
+		bounds.push_back( count * i / slices );
+	}
+	std::vector<size_t> kept( slices );
+	ParallelFor( slices, [&]( size_t i ) {
+		auto first = list.begin() + bounds[i];
+		auto last = list.begin() + bounds[i+1];
+		kept[i] = std::min( n, (size_t)(last - first) );
+		std::nth_element( first, first + kept[i] - 1, last, less );
+	});
+	// gather the candidates at the front and choose among them
+	size_t candidates = 0;
+	for ( size_t i = 0; i < slices; ++i ) {
+		if ( candidates != bounds[i] )
+			std::move( list.begin() + bounds[i], list.begin() + bounds[i] + kept[i], list.begin() + candidates );
+		candidates += kept[i];
+	}
+	std::partial_sort( list.begin(), list.begin() + n, list.begin() + candidates, less );
+	list.resize( n );
+}
+
+#endif /* Parallel_hpp */
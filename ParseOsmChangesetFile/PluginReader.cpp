@@ -0,0 +1,129 @@
+//
+//  PluginReader.cpp
+//  ParseOsmChangesetFile
+//
+//  Created by Bryce Cogswell on 10/18/26.
+//  Copyright © 2026 Bryce Cogswell. All rights reserved.
+//
+
+#include <dlfcn.h>
+#include <errno.h>
+#include <string.h>
+#include <vector>
+
+#include "PluginReader.hpp"
+#include "ReaderPlugin.h"
+#include "Readers.hpp"
+
+// Adapts a reader from a plugin to the ChangesetReader interface
+class PluginReader: public ChangesetReader {
+	const ReaderPlugin *			plugin;
+	void *							state;
+	struct ReaderPluginChangeset	record;
+
+	PluginReader( const ReaderPlugin * plugin, void * state ) : plugin(plugin), state(state) {}
+public:
+	static ChangesetReader * create( const ReaderPlugin * plugin, const std::string & path,
+									const ReaderParameters & params, std::string & error )
+	{
+		const ReaderPluginParameter list[] = {
+			{ "startDate",	params.startDate.c_str() },
+			{ "endDate",	params.endDate.c_str() },
+			{ "country",	params.country.c_str() },
+			{ "editor",		params.editor.c_str() },
+		};
+		errno = 0;
+		void * state = plugin->create( list, sizeof list / sizeof list[0] );
+		if ( state == NULL ) {
+			// the interface has no way to return a reason, but a failed allocation or
+			// file open leaves one in errno, else the parameters are the likely cause
+			int code = errno;
+			error = std::string( "plugin reader '" ) + plugin->name + "' from " + path + " failed to start: ";
+			if ( code != 0 ) {
+				error += strerror( code );
+			} else {
+				error += "create() returned NULL for";
+				for ( const auto &param: list ) {
+					error += std::string( " " ) + param.key + "='" + param.value + "'";
+				}
+			}
+			return NULL;
+		}
+		return new PluginReader( plugin, state );
+	}
+
+	~PluginReader()
+	{
+		plugin->destroy( state );
+	}
+
+	const char * filter()
+	{
+		return plugin->filter;
+	}
+
+	void initialize() {}
+
+	// plugins report however they like, so their counts aren't scaled
+	bool scalesSamples() { return false; }
+
+	void process( const Changeset & changeset )
+	{
+		record.ident			= changeset.ident;
+		record.uid				= changeset.uid;
+		record.editCount		= changeset.editCount;
+		record.min_lat			= changeset.min_lat;
+		record.max_lat			= changeset.max_lat;
+		record.min_lon			= changeset.min_lon;
+		record.max_lon			= changeset.max_lon;
+		record.date				= changeset.date.c_str();
+		record.user				= changeset.user.c_str();
+		record.application		= changeset.application.c_str();
+		record.applicationRaw	= changeset.applicationRaw.c_str();
+		record.comment			= changeset.comment.c_str();
+		record.locale			= changeset.locale.c_str();
+		record.questType		= changeset.quest_type.c_str();
+		plugin->process( state, &record );
+	}
+
+	void finalize()
+	{
+		plugin->finalize( state, out );
+	}
+};
+
+bool LoadReaderPlugin( const std::string & path, std::string & error )
+{
+	// the library is never unloaded, since its readers may be used until we exit
+	void * library = dlopen( path.c_str(), RTLD_NOW | RTLD_LOCAL );
+	if ( library == NULL ) {
+		error = dlerror();
+		return false;
+	}
+	ReaderPluginEntry entry = (ReaderPluginEntry)dlsym( library, READER_PLUGIN_ENTRY );
+	if ( entry == NULL ) {
+		error = path + " has no " READER_PLUGIN_ENTRY "()";
+		return false;
+	}
+	int count = 0;
+	const ReaderPlugin * plugins = entry( READER_PLUGIN_VERSION, &count );
+	if ( plugins == NULL ) {
+		error = path + " doesn't support plugin version " + std::to_string( READER_PLUGIN_VERSION );
+		return false;
+	}
+	for ( int i = 0; i < count; ++i ) {
+		const ReaderPlugin * plugin = &plugins[i];
+		if ( plugin->name == NULL || plugin->create == NULL || plugin->process == NULL ||
+			plugin->finalize == NULL || plugin->destroy == NULL ) {
+			error = path + " has an incomplete reader";
+			return false;
+		}
+		if ( !registerReader( plugin->name, [plugin, path]( const ReaderParameters & params, std::string & error ) {
+				return PluginReader::create( plugin, path, params, error );
+			}) ) {
+			error = std::string( "a reader named '" ) + plugin->name + "' already exists";
+			return false;
+		}
+	}
+	return true;
+}
@@ -0,0 +1,18 @@
+//
+//  PluginReader.hpp
+//  ParseOsmChangesetFile
+//
+//  Created by Bryce Cogswell on 10/18/26.
+//  Copyright © 2026 Bryce Cogswell. All rights reserved.
+//
+
+#ifndef PluginReader_hpp
+#define PluginReader_hpp
+
+#include <string>
+
+// Loads a shared library of readers (see ReaderPlugin.h) and registers each of them
+// by name, so they can be selected like the built-in readers.
+bool LoadReaderPlugin( const std::string & path, std::string & error );
+
+#endif /* PluginReader_hpp */
@@ -0,0 +1,75 @@
+//
+//  ReaderPlugin.h
+//  ParseOsmChangesetFile
+//
+//  Created by Bryce Cogswell on 10/18/26.
+//  Copyright © 2026 Bryce Cogswell. All rights reserved.
+//
+
+// The interface for readers loaded from a shared library with --plugin=<library>.
+//
+// This is plain C so a plugin doesn't need to be built with the same compiler or
+// standard library as the parser. Structures are only ever extended by adding a new
+// version, so a plugin built against version 1 keeps working.
+//
+// A plugin exports one function:
+//
+//		const struct ReaderPlugin * ParseOsmChangesetReaderPlugins( int version, int * count );
+//
+// which returns an array of *count readers written for the given interface version,
+// or NULL if it doesn't support that version.
+
+#ifndef ReaderPlugin_h
+#define ReaderPlugin_h
+
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define READER_PLUGIN_VERSION	1
+#define READER_PLUGIN_ENTRY		"ParseOsmChangesetReaderPlugins"
+
+// A changeset. The strings are only valid until process() returns.
+struct ReaderPluginChangeset {
+	long			ident;
+	int				uid;
+	int				editCount;
+	double			min_lat, max_lat, min_lon, max_lon;
+	const char *	date;
+	const char *	user;
+	const char *	application;		// normalized editor name
+	const char *	applicationRaw;		// created_by as written, with the version
+	const char *	comment;
+	const char *	locale;
+	const char *	questType;
+};
+
+// A parameter from the command line, such as "country" = "China".
+// Parameters are startDate, endDate, country and editor.
+struct ReaderPluginParameter {
+	const char *	key;
+	const char *	value;
+};
+
+struct ReaderPlugin {
+	const char *	name;		// what it's called in --readers=
+	const char *	filter;		// a filter expression, or NULL to see every changeset
+
+	// Returns the reader's state, which is passed to the other calls, or NULL on failure,
+	// with errno set to say why, e.g. EINVAL for a parameter it can't use
+	void *	(*create)( const struct ReaderPluginParameter * params, int count );
+	void	(*process)( void * reader, const struct ReaderPluginChangeset * changeset );
+	// Writes the report. Readers finalize concurrently, so only write to out.
+	void	(*finalize)( void * reader, FILE * out );
+	void	(*destroy)( void * reader );
+};
+
+typedef const struct ReaderPlugin * (*ReaderPluginEntry)( int version, int * count );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ReaderPlugin_h */
@@ -11,8 +11,11 @@
 #include <map>
 #include <set>
 #include <list>
+#include <memory>
 #include <algorithm>
+#include <functional>
 #include <regex>
+#include <unordered_map>
 
 #include <math.h>
 #include <stdlib.h>
@@ -20,52 +23,148 @@
 #include <errno.h>
 
 #include "Countries.h"
+#include "ConcurrentCounter.hpp"
 #include "ChangesetParser.hpp"
+#include "DerivedValues.hpp"
+#include "Geodesic.hpp"
+#include "GroupBy.hpp"
+#include "Parallel.hpp"
 #include "Readers.hpp"
+#include "RollupCube.hpp"
+#include "SlidingWindow.hpp"
+#include "SpatialIndex.hpp"
+#include "SpillingCounter.hpp"
+#include "UserSet.hpp"
+#include "UserTable.hpp"
+
+// Keeps the largest n entries added to it
+template <class T> class TopEntries {
+	size_t			n;
+	std::vector<T>	heap;	// smallest entry at the front
+public:
+	TopEntries( size_t n ) : n(n) {}
+	void add( const T & entry )
+	{
+		if ( heap.size() < n ) {
+			heap.push_back( entry );
+			std::push_heap( heap.begin(), heap.end(), std::greater<T>() );
+		} else if ( n > 0 && heap.front() < entry ) {
+			std::pop_heap( heap.begin(), heap.end(), std::greater<T>() );
+			heap.back() = entry;
+			std::push_heap( heap.begin(), heap.end(), std::greater<T>() );
+		}
+	}
+	// Largest first. Must be called last.
+	const std::vector<T> & sorted()
+	{
+		std::sort( heap.begin(), heap.end(), std::greater<T>() );
+		return heap;
+	}
+};
 
 class EditorDailyUsersReader: public ChangesetReader {
-	struct EditorInfo {
-		long					changesets;
-		long					edits;
-		std::set<std::string>	usersPerDay;
-		long					uniqueUsersPerDaySum;
+	TimeGroupBy		dailyUsers = TimeGroupBy( BUCKET_DAY, AGGREGATE_SUM, &arena );	// unique users per day for each editor
+	std::vector<long>	edits;							// indexed by editor
+	// The days a user was counted for an editor: the latest, and a bit for each of the RECENT_DAYS
+	// up to it, so a changeset that arrives after later days isn't counted twice
+	struct daysSeen {
+		int			editor = -1;	// -1 for an empty slot
+		int			lastDay = 0;
+		uint32_t	recent = 0;		// bit n is lastDay - n
+		int			next = -1;		// the user's next editor in moreSeen, or -1
 	};
-	typedef std::map<std::string,EditorInfo> EditorMap;	// map editor name to info
-	EditorMap		editors;
-
-	std::string		prevDate = "";
-	long			dateCount = 0;
+	static const int RECENT_DAYS = 32;
+	// Most users only use one editor, so each user's slot holds the first, and any others are chained through moreSeen
+	PerUser<daysSeen>		seen = PerUser<daysSeen>( &arena );
+	ArenaVector<daysSeen>	moreSeen = ArenaVector<daysSeen>( &arena );
+	std::vector<int>	editorDimensions;				// ApplicationId to the editor's dimension in dailyUsers
+	std::string		prevDate;
+	int				dayNumber = 0;
 
 	void initialize() {
 	}
 
+	// a user is counted once a day however many of their changesets are in the sample
+	bool scalesSamples() { return false; }
+
+	daysSeen & userDays(int uid, int editor)
+	{
+		daysSeen * days = &seen[uid];
+		if ( days->editor < 0 ) {
+			days->editor = editor;
+			days->lastDay = dayNumber;
+			return *days;
+		}
+		while ( days->editor != editor ) {
+			if ( days->next < 0 ) {
+				days->next = (int)moreSeen.size();
+				moreSeen.push_back( daysSeen() );
+				daysSeen & added = moreSeen.back();
+				added.editor = editor;
+				added.lastDay = dayNumber;
+				return added;
+			}
+			days = &moreSeen[days->next];
+		}
+		return *days;
+	}
+
+	int editorDimension(const Changeset & changeset)
+	{
+		int application = ApplicationId( changeset );
+		if ( application >= (int)editorDimensions.size() )
+			editorDimensions.resize( application + 1, -1 );
+		int & editor = editorDimensions[application];
+		if ( editor < 0 )
+			editor = dailyUsers.dimension( changeset.application );
+		return editor;
+	}
+
 	void process(const Changeset & changeset)
 	{
 		if ( changeset.date != prevDate ) {
 			prevDate = changeset.date;
-			for ( auto &editor_pair : editors ) {
-				auto &editor = editor_pair.second;
-				editor.uniqueUsersPerDaySum += editor.usersPerDay.size();
-				editor.usersPerDay.clear();
-			}
-			++dateCount;
+			dayNumber = DayNumber( changeset.date );
 		}
-
-		auto it = editors.find(changeset.application);
-		if ( it == editors.end() ) {
-			it = editors.insert( std::pair<std::string,EditorInfo>(changeset.application, EditorInfo()) ).first;
+		int day = dailyUsers.bucket( changeset.date );
+		int editor = editorDimension( changeset );
+		daysSeen & days = userDays( changeset.uid, editor );
+		int age = days.lastDay - dayNumber;
+		if ( age < 0 ) {
+			days.recent = -age < RECENT_DAYS ? days.recent << -age : 0;
+			days.lastDay = dayNumber;
+			age = 0;
+		}
+		// a day older than the bits we keep is assumed not to have been counted
+		if ( age >= RECENT_DAYS || (days.recent & (1u << age)) == 0 ) {
+			if ( age < RECENT_DAYS )
+				days.recent |= 1u << age;
+			dailyUsers.add( day, editor );
 		}
-		EditorInfo & e = it->second;
-		e.usersPerDay.insert( changeset.user );
-		e.edits += changeset.editCount;
-		e.changesets += 1;
+		if ( editor >= (int)edits.size() )
+			edits.resize( editor + 1, 0 );
+		edits[editor] += changeset.editCount;
+	}
+
+	bool usesRollup() { return true; }
+	void processRollup(const RollupCube & cube)
+	{
+		cube.forEachDailyUsers( [&]( const RollupCube::DailyUsers & users ) {
+			dailyUsers.add( cube.string( users.date ), cube.string( users.editor ), users.users );
+		});
+		cube.forEachCell( [&]( const RollupCube::Cell & cell ) {
+			int editor = dailyUsers.dimension( cube.string( cell.editor ) );
+			if ( editor >= (int)edits.size() )
+				edits.resize( editor + 1, 0 );
+			edits[editor] += cell.edits;
+		});
 	}
 
 	void finalize()
 	{
 		// print average number of unique daily users for each editor
-		printf("\n");
-		printf( "Average daily users and edits/user:\n");
+		fprintf(out, "\n");
+		fprintf( out, "Average daily users and edits/user:\n");
 
 		struct stats {
 			double user_rate;
@@ -74,22 +173,30 @@ class EditorDailyUsersReader: public ChangesetReader {
 			bool operator<(const stats & a) const { return user_rate < a.user_rate; }
 		};
 
+		long dateCount = 0;
+		for ( int day = 0; day < dailyUsers.bucketCount(); ++day ) {
+			if ( !dailyUsers.bucketEmpty( day ) )
+				++dateCount;
+		}
+
 		std::vector<stats>	list;
-		for ( const auto &editor_pair: editors ) {
-			const auto &editor = editor_pair.second;
+		for ( int editor = 0; editor < dailyUsers.dimensionCount(); ++editor ) {
+			long uniqueUsersPerDaySum = 0;
+			for ( int day = 0; day < dailyUsers.bucketCount(); ++day ) {
+				uniqueUsersPerDaySum += dailyUsers.value( day, editor );
+			}
 			stats s = {
-				(double)editor.uniqueUsersPerDaySum / dateCount,
-				editor.edits / (double)editor.uniqueUsersPerDaySum,
-				editor_pair.first
+				(double)uniqueUsersPerDaySum / dateCount,
+				edits[editor] / (double)uniqueUsersPerDaySum,
+				dailyUsers.dimensionName( editor )
 			};
 			list.push_back(s);
 		}
-		std::sort( list.begin(), list.end() );
-		std::reverse( list.begin(), list.end() );
+		ParallelSort( list.begin(), list.end(), [](const stats & a, const stats & b) { return b < a; } );
 
 		for ( const auto &item: list ) {
 			if ( item.user_rate > 0.1 ) {
-				printf( "%6.1f %12.1f  %s\n",
+				fprintf( out, "%6.1f %12.1f  %s\n",
 					   item.user_rate,
 					   item.edit_rate,
 					   item.editor.c_str() );
@@ -99,44 +206,81 @@ class EditorDailyUsersReader: public ChangesetReader {
 };
 
 
+static const double LARGE_AREA_METERS = 1000*1000.0;
+
+bool IsLargeArea( const Changeset & changeset )
+{
+	return DiagonalLongerThan( changeset, LARGE_AREA_METERS );
+}
+
 class LargeAreaReader: public ChangesetReader {
-	typedef std::map<std::string,long>	LargeAreaMap;	// for each editor count the number of large changesets
-	LargeAreaMap	largeAreaMap;
+	typedef ArenaMap<std::string,long>	LargeAreaMap;	// for each editor count the number of large changesets
+	LargeAreaMap	largeAreaMap = LargeAreaMap( &arena );
 
-	void initialize() {}
-	void process(const Changeset & changeset)
+	// Changesets are tested a batch at a time so the test runs in vector registers
+	static const size_t BATCH_SIZE = 1024;
+	BBoxBatch			batch;
+	std::vector<int>	batchApplications;	// ApplicationId of each changeset in the batch
+	std::vector<int>	batchCounts;		// 1 if processed, -1 if retracted
+	unsigned char		batchLarge[BATCH_SIZE];
+
+	void add(const Changeset & changeset, int count)
+	{
+		batch.add( changeset );
+		batchApplications.push_back( ApplicationId( changeset ) );
+		batchCounts.push_back( count );
+		if ( batch.size() == BATCH_SIZE )
+			flush();
+	}
+
+	void flush()
 	{
-		if ( GreatCircleDistance(changeset.min_lon, changeset.min_lat, changeset.max_lon, changeset.max_lat) > 1000*1000.0 ) {
-			std::pair<LargeAreaMap::iterator,bool> result = largeAreaMap.insert(std::pair<std::string,long>(changeset.application,1));
-			if ( !result.second ) {
-				result.first->second += 1;
+		DiagonalsLongerThan( batch, LARGE_AREA_METERS, batchLarge );
+		for ( size_t i = 0; i < batch.size(); ++i ) {
+			if ( batchLarge[i] ) {
+				largeAreaMap[ApplicationName( batchApplications[i] )] += batchCounts[i];
 			}
 		}
+		batch.clear();
+		batchApplications.clear();
+		batchCounts.clear();
+	}
+
+	void initialize() {}
+	void process(const Changeset & changeset)
+	{
+		add( changeset, 1 );
+	}
+
+	bool canRetract() { return true; }
+	void retract(const Changeset & changeset)
+	{
+		add( changeset, -1 );
+	}
+
+	bool usesRollup() { return true; }
+	void processRollup(const RollupCube & cube)
+	{
+		cube.forEachCell( [&]( const RollupCube::Cell & cell ) {
+			if ( cell.largeAreas > 0 )
+				largeAreaMap[cube.string( cell.editor )] += cell.largeAreas;
+		});
 	}
 
 	void finalize()
 	{
+		flush();
+
 		// print large edit area counts
-		printf("\n");
-		printf( "Number of large changeset areas:\n");
+		fprintf(out, "\n");
+		fprintf( out, "Number of large changeset areas:\n");
 		for ( LargeAreaMap::iterator editor = largeAreaMap.begin(); editor != largeAreaMap.end(); ++editor ) {
 			long rate = editor->second;
-			printf( "%-30s %6ld\n", editor->first.c_str(), rate );
+			if ( rate == 0 )
+				continue;
+			fprintf( out, "%-30s %6s\n", editor->first.c_str(), scaledCount( rate ).c_str() );
 		}
 	}
-	
-	double GreatCircleDistance(double lon1, double lat1, double lon2, double lat2)
-	{
-		double EarthRadius = 6378137.0;
-
-		// haversine formula
-		double dlon = (lon2 - lon1) * M_PI / 180;
-		double dlat = (lat2 - lat1) * M_PI / 180;
-		double a = pow(sin(dlat / 2), 2) + cos(lat1 * M_PI / 180) * cos(lat2 * M_PI / 180) * pow(sin(dlon / 2), 2);
-		double c = 2 * atan2(sqrt(a), sqrt(1 - a));
-		double meters = EarthRadius * c;
-		return meters;
-	}
 };
 
 
@@ -146,34 +290,53 @@ class BiggestMappersByApp: public ChangesetReader {
 		long			editCount;
 		std::string		lastDate;
 		long			lastChangesetId;
-		UserStats() : editCount(0), changesetCount(0) {}
+		UserStats() : changesetCount(0), editCount(0), lastChangesetId(0) {}
 	};
-	typedef std::map<std::string,UserStats>	PerUserMap;	// map user-name to edit stats
-	typedef std::map<std::string,PerUserMap> PerAppMap; // map editor name to stats
-	PerAppMap perAppMap;
+	typedef PerUser<UserStats>	PerUserMap;	// map uid to edit stats
+	typedef ArenaMap<std::string,PerUserMap> PerAppMap; // map editor name to stats
+	PerAppMap perAppMap = PerAppMap( &arena );
+	std::vector<PerUserMap *> byApplication;	// indexed by ApplicationId, NULL for editors we don't track
 
 	void initialize() {
-		perAppMap.insert(std::pair<std::string,PerUserMap>("Go Map!!",PerUserMap()));
-		perAppMap.insert(std::pair<std::string,PerUserMap>("Vespucci",PerUserMap()));
-		perAppMap.insert(std::pair<std::string,PerUserMap>("StreetComplete",PerUserMap()));
-		perAppMap.insert(std::pair<std::string,PerUserMap>("MapComplete",PerUserMap()));
+		perAppMap.insert(std::pair<std::string,PerUserMap>("Go Map!!",PerUserMap(&arena)));
+		perAppMap.insert(std::pair<std::string,PerUserMap>("Vespucci",PerUserMap(&arena)));
+		perAppMap.insert(std::pair<std::string,PerUserMap>("StreetComplete",PerUserMap(&arena)));
+		perAppMap.insert(std::pair<std::string,PerUserMap>("MapComplete",PerUserMap(&arena)));
 	}
 
-	void process(const Changeset & changeset)
+	PerUserMap * userMap(const Changeset & changeset)
 	{
-		auto it = perAppMap.find( changeset.application );
-		if ( it != perAppMap.end() ) {
-			PerUserMap & userMap = it->second;
+		int application = ApplicationId( changeset );
+		while ( application >= (int)byApplication.size() ) {
+			// each editor's name is only looked up once
+			auto it = perAppMap.find( ApplicationName( (int)byApplication.size() ) );
+			byApplication.push_back( it != perAppMap.end() ? &it->second : NULL );
+		}
+		return byApplication[application];
+	}
 
-			auto it = userMap.find(changeset.application);
-			if ( it == userMap.end() ) {
-				it = userMap.insert( std::pair<std::string,UserStats>(changeset.user,UserStats()) ).first;
-			}
-			UserStats & userStats = it->second;
+	void process(const Changeset & changeset)
+	{
+		if ( PerUserMap * users = userMap( changeset ) ) {
+			UserStats & userStats = (*users)[changeset.uid];
 			userStats.changesetCount	+= 1;
 			userStats.editCount			+= changeset.editCount;
-			userStats.lastDate			= changeset.date;
-			userStats.lastChangesetId = changeset.ident;
+			// replication updates can arrive after later changesets
+			if ( changeset.ident > userStats.lastChangesetId ) {
+				userStats.lastDate			= changeset.date;
+				userStats.lastChangesetId	= changeset.ident;
+			}
+		}
+	}
+
+	// the most recent changeset stays the same, since an update has the same id and date
+	bool canRetract() { return true; }
+	void retract(const Changeset & changeset)
+	{
+		if ( PerUserMap * users = userMap( changeset ) ) {
+			UserStats & userStats = (*users)[changeset.uid];
+			userStats.changesetCount	-= 1;
+			userStats.editCount			-= changeset.editCount;
 		}
 	}
 
@@ -185,8 +348,8 @@ class BiggestMappersByApp: public ChangesetReader {
 		for ( const auto &it: perAppMap ) {
 			const char * editorName = it.first.c_str();
 			const PerUserMap & perUserMap = it.second;
-			printf( "\n");
-			printf( "%s top %d prolific users:\n", editorName, TOP_COUNT);
+			fprintf( out, "\n");
+			fprintf( out, "%s top %d prolific users:\n", editorName, TOP_COUNT);
 			struct PerEditorUser {
 				const std::string	name;
 				UserStats			count;
@@ -196,11 +359,13 @@ class BiggestMappersByApp: public ChangesetReader {
 			std::list<PerEditorUser> perEditorUserVector;
 			long totalEdits = 0;
 			long totalChangesets = 0;
-			for ( const auto &user: perUserMap ) {
-				perEditorUserVector.push_back(PerEditorUser(user.first,user.second));
-				totalEdits += user.second.editCount;
-				totalChangesets += user.second.changesetCount;
+			for ( size_t i = 0; i < perUserMap.size(); ++i ) {
+				perEditorUserVector.push_back(PerEditorUser(g_Users.name(perUserMap.uid(i)),perUserMap.value(i)));
+				totalEdits += perUserMap.value(i).editCount;
+				totalChangesets += perUserMap.value(i).changesetCount;
 			}
+			// users with the same number of edits are listed by name
+			perEditorUserVector.sort( [](PerEditorUser const& a, PerEditorUser const& b) { return a.name < b.name; });
 
 			perEditorUserVector.sort( [](PerEditorUser const& a, PerEditorUser const& b) { return a.count.editCount > b.count.editCount; });
 			while ( perEditorUserVector.size() > TOP_COUNT ) {
@@ -210,12 +375,12 @@ class BiggestMappersByApp: public ChangesetReader {
 			perEditorUserVector.push_front(PerEditorUser("<Total>",UserStats()));
 			perEditorUserVector.front().count.lastDate = "          ";
 
-			printf( "    edits    sets  most recent     last set   user\n");
+			fprintf( out, "    edits    sets  most recent     last set   user\n");
 			for ( const auto &user: perEditorUserVector ) {
 				if ( user.count.editCount > 0 ) {
-					printf( "%9ld %7ld   %s  %11ld   %s\n",
-						   user.count.editCount,
-						   user.count.changesetCount,
+					fprintf( out, "%9s %7s   %s  %11ld   %s\n",
+						   scaledCount( user.count.editCount ).c_str(),
+						   scaledCount( user.count.changesetCount ).c_str(),
 						   user.count.lastDate.c_str(),
 						   user.count.lastChangesetId,
 						   user.name.c_str() );
@@ -226,27 +391,58 @@ class BiggestMappersByApp: public ChangesetReader {
 };
 
 
+// Returns a filter expression that accepts only the given editor
+static std::string EditorFilter( const std::string & editor )
+{
+	return "application = \"" + editor + "\"";
+}
+
 class GoMapInCountryReader: public ChangesetReader {
-	const char * COUNTRY = "China";
+	std::string		country;
+	std::string		editorFilter;
 	struct User {
 		long	changesets;
 		long	edits;
 	};
-	std::map<std::string,User>	users;
+	PerUser<User>	users;
+public:
+	GoMapInCountryReader( const ReaderParameters & params )
+		: country(params.country), editorFilter(EditorFilter(params.editor)), users(&arena) {}
+private:
 	void initialize() {}
+	const char * filter() { return editorFilter.c_str(); }
 
-	void process(const Changeset & changeset)
+	bool inCountry(const Changeset & changeset)
 	{
-		if ( changeset.application != "Go Map!!" )
-			return;
-		if ( CountryContainsPoint( COUNTRY, changeset.min_lon, changeset.min_lat ) &&
+		const char * COUNTRY = country.c_str();
+		return CountryContainsPoint( COUNTRY, changeset.min_lon, changeset.min_lat ) &&
 			CountryContainsPoint( COUNTRY, changeset.min_lon, changeset.max_lat ) &&
 			CountryContainsPoint( COUNTRY, changeset.max_lon, changeset.min_lat ) &&
-			CountryContainsPoint( COUNTRY, changeset.max_lon, changeset.max_lat ) )
-		{
-			auto it = users.insert(std::pair<std::string,User>(changeset.user,User())).first;
-			it->second.edits += changeset.editCount;
-			it->second.changesets += 1;
+			CountryContainsPoint( COUNTRY, changeset.max_lon, changeset.max_lat );
+	}
+
+	// every corner has to be in the country, so the box is within the country's bounds
+	bool region(GeoBox & box)
+	{
+		return CountryBounds( country.c_str(), box.minLon, box.minLat, box.maxLon, box.maxLat );
+	}
+
+	void process(const Changeset & changeset)
+	{
+		if ( inCountry( changeset ) ) {
+			User & user = users[changeset.uid];
+			user.edits += changeset.editCount;
+			user.changesets += 1;
+		}
+	}
+
+	bool canRetract() { return true; }
+	void retract(const Changeset & changeset)
+	{
+		if ( inCountry( changeset ) ) {
+			User & user = users[changeset.uid];
+			user.edits -= changeset.editCount;
+			user.changesets -= 1;
 		}
 	}
 
@@ -260,23 +456,27 @@ class GoMapInCountryReader: public ChangesetReader {
 		};
 		std::vector<UserInfo>	list;
 
-		for ( const auto &it: users ) {
+		for ( size_t i = 0; i < users.size(); ++i ) {
+			if ( users.value(i).changesets == 0 )
+				continue;
 			UserInfo info = {
-				it.second.edits,
-				it.second.changesets,
-				it.first
+				users.value(i).edits,
+				users.value(i).changesets,
+				g_Users.name(users.uid(i))
 			};
 			list.push_back(info);
 		}
-		std::sort( list.begin(), list.end() );
-		std::reverse( list.begin(), list.end() );
-
-		printf( "\n");
-		printf( "Top editors in %s:\n", COUNTRY);
-		printf( "    edits    changesets    user\n");
+		// most edits first, with ties in name order
+		ParallelSort( list.begin(), list.end(), [](const UserInfo & a, const UserInfo & b) {
+			return a.edits != b.edits ? a.edits > b.edits : a.user < b.user;
+		});
+
+		fprintf( out, "\n");
+		fprintf( out, "Top editors in %s:\n", country.c_str());
+		fprintf( out, "    edits    changesets    user\n");
 		for ( const auto &user: list ) {
-			printf( "%9ld   %7ld   %s\n",
-				   user.edits, user.changesets, user.user.c_str());
+			fprintf( out, "%9s   %7s   %s\n",
+				   scaledCount( user.edits ).c_str(), scaledCount( user.changesets ).c_str(), user.user.c_str());
 		}
 	}
 };
@@ -284,134 +484,145 @@ class GoMapInCountryReader: public ChangesetReader {
 
 // Shows which locale changesets are using
 class GoMapLocaleReader: public ChangesetReader {
-	std::map<std::string,long>	locales;
-
+	std::string					editor;
+	std::string					editorFilter;
+	ArenaMap<std::string,long>	locales;
+public:
+	GoMapLocaleReader( const ReaderParameters & params )
+		: editor(params.editor), editorFilter(EditorFilter(params.editor)), locales(&arena) {}
+private:
 	void initialize() {}
+	const char * filter() { return editorFilter.c_str(); }
 	void process(const Changeset & changeset)
 	{
-		if ( changeset.application == "Go Map!!" ) {
-			auto it = locales.find(changeset.locale);
-			if ( it == locales.end() ) {
-				it = locales.insert( std::pair<std::string,long>(changeset.locale, 0) ).first;
-			}
-			++it->second;
+		auto it = locales.find(changeset.locale);
+		if ( it == locales.end() ) {
+			it = locales.insert( std::pair<std::string,long>(changeset.locale, 0) ).first;
 		}
+		++it->second;
+	}
+
+	bool canRetract() { return true; }
+	void retract(const Changeset & changeset)
+	{
+		--locales[changeset.locale];
 	}
 
 	void finalize()
 	{
 		std::vector<std::pair<long, std::string>> list;
 		for ( const auto &loc: locales ) {
+			if ( loc.second == 0 )
+				continue;
 			list.push_back(std::pair<long, std::string>(loc.second,loc.first));
 		}
-		std::sort(list.begin(),list.end());
-		std::reverse(list.begin(),list.end());
-		printf("\n");
-		printf("Most common locales in Go Map!!\n");
+		ParallelSort(list.begin(),list.end(),std::greater<std::pair<long,std::string>>());
+		fprintf(out, "\n");
+		fprintf(out, "Most common locales in %s\n", editor.c_str());
 		for ( const auto &loc: list ) {
-			printf("%9ld  %s\n", loc.first, loc.second.c_str());
+			fprintf(out, "%9s  %s\n", scaledCount( loc.first ).c_str(), loc.second.c_str());
 		}
 	}
 };
 
 
-// Shows which locale changesets are using
+// Shows which versions of the editor are in use each month
 class GoMapVersionsReader: public ChangesetReader {
-
-	typedef std::map<std::string,long>	CountForVersion;
-	std::map<std::string, CountForVersion>	months;
-
+	TimeGroupBy		versions = TimeGroupBy( BUCKET_MONTH, AGGREGATE_COUNT, &arena );
+	std::string		version;
+	std::string		editorFilter;
+	size_t			prefixLength;	// the editor name and a space, before the version
+public:
+	GoMapVersionsReader( const ReaderParameters & params )
+		: editorFilter(EditorFilter(params.editor)), prefixLength(params.editor.size() + 1) {}
+private:
 	void initialize() {}
+	const char * filter() { return editorFilter.c_str(); }
+	bool scalesSamples() { return false; }
 	void process(const Changeset & changeset)
 	{
-		if ( changeset.application == "Go Map!!" ) {
-			auto month = changeset.date.substr(0,7);
-			auto version = changeset.applicationRaw.substr(9);
-			if ( version.c_str()[0] == 'D' ) {
-				return;
-			}
-			auto it = months.find(month);
-			if ( it == months.end() ) {
-				it = months.insert(std::pair<std::string, CountForVersion>(month,CountForVersion())).first;
-			}
-			auto it2 = it->second.find(version);
-			if ( it2 == it->second.end() ) {
-				it2 = it->second.insert(std::pair<std::string,long>(version,0)).first;
-			}
-			it2->second += 1;
+		if ( changeset.applicationRaw.size() < prefixLength || changeset.applicationRaw[prefixLength] == 'D' ) {
+			return;
 		}
+		version.assign( changeset.applicationRaw, prefixLength, std::string::npos );
+		versions.add( versions.bucket( changeset.date ), versions.dimension( version ) );
 	}
 
 	void finalize()
 	{
-		// get all months as a vector
-		std::vector<std::pair<std::string, CountForVersion>> monthsVector(months.begin(), months.end());
-		// get all versions as a vector
-		std::set<std::string> versionSet;
-		for ( const auto & month: monthsVector ) {
-			for ( const auto & ver: month.second) {
-				versionSet.insert(ver.first);
-			}
-		}
-		std::vector<std::string> versionVec(versionSet.begin(), versionSet.end());
+		versions.printMatrix( out );
+	}
+};
 
-		// header with each version
-		for ( const auto &version: versionVec ) {
-			printf(",%s", version.c_str());
-		}
-		printf("\n");
 
-		// iterate over months
-		for ( const auto & month: monthsVector ) {
-			printf("%s", month.first.c_str());
-			for ( const auto &version: versionVec ) {
-				const auto iter = month.second.find(version);
-				long count = 0;
-				if ( iter != month.second.end() ) {
-					count = iter->second;
-				}
-				printf(",%ld", count);
-			}
-			printf("\n");
+// The comments StreetComplete writes, which the comment readers leave out. It's a stage
+// they depend on, so it's filled whichever of them are run, and before they finalize.
+class StreetCompleteComments: public ChangesetReader {
+	std::set<std::string>	comments;
+public:
+	// The readers created for a run share one
+	static std::shared_ptr<StreetCompleteComments> shared()
+	{
+		static std::weak_ptr<StreetCompleteComments> instance;
+		std::shared_ptr<StreetCompleteComments> stage = instance.lock();
+		if ( !stage ) {
+			stage = std::make_shared<StreetCompleteComments>();
+			instance = stage;
 		}
+		return stage;
 	}
-};
 
+	bool contains(const std::string & comment) const { return comments.find( comment ) != comments.end(); }
+
+	// an update is followed by the new version, so comments are never retracted
+	const char * filter() { return "application = \"StreetComplete\""; }
+	void initialize() {}
+	void process(const Changeset & changeset)
+	{
+		comments.insert( changeset.comment );
+	}
+	void finalize() {}
+};
 
-// Track the number of times each comment is used by StreetComplete users
-std::set<std::string>	g_StreetCompleteComments;
+// Track the number of times each StreetComplete quest is used
 class StreetCompleteReader: public ChangesetReader {
-	std::map<std::string,long>	quests;
+	ArenaMap<std::string,long>	quests = ArenaMap<std::string,long>( &arena );
 
 	void initialize() {}
 	void process(const Changeset & changeset)
 	{
-		if ( changeset.application == "StreetComplete" ) {
-			g_StreetCompleteComments.insert( changeset.comment );
-		}
 		if ( changeset.quest_type.size() > 0 ) {
 			auto it = quests.insert( std::pair<std::string,long>(changeset.quest_type, 0) ).first;
 			it->second++;
 		}
 	}
 
+	bool canRetract() { return true; }
+	void retract(const Changeset & changeset)
+	{
+		if ( changeset.quest_type.size() > 0 ) {
+			--quests[changeset.quest_type];
+		}
+	}
+
 	void finalize()
 	{
 		long total = 0;
 		std::vector<std::pair<long,std::string>> scQuests;
 		for (const auto & c: quests ) {
+			if ( c.second == 0 )
+				continue;
 			scQuests.push_back(std::pair<long,std::string>(c.second,c.first));
 			total += c.second;
 		}
-		std::sort( scQuests.begin(), scQuests.end() );
-		std::reverse( scQuests.begin(), scQuests.end() );
-		printf("\n");
-		printf("StreetComplete quests:\n");
+		ParallelSort( scQuests.begin(), scQuests.end(), std::greater<std::pair<long,std::string>>() );
+		fprintf(out, "\n");
+		fprintf(out, "StreetComplete quests:\n");
 		double acc = 0.0;
 		for ( const auto & c: scQuests ) {
 			acc += c.first;
-			printf("%9ld %.2f%% (%.2f%%) %s\n",
-				   c.first,
+			fprintf(out, "%9s %.2f%% (%.2f%%) %s\n",
+				   scaledCount( c.first ).c_str(),
 				   100.0*c.first/total,
 				   100.0*acc/total,
 				   c.second.c_str());
@@ -420,96 +631,130 @@ class StreetCompleteReader: public ChangesetReader {
 };
 
 
-// Track the most common changeset comments
+// Track the most common changeset comments. Most changesets repeat a recent comment, often an
+// empty one, which the counter's per-thread buffer sums without a table lookup.
 class ChangesetCommentReader: public ChangesetReader {
-	typedef std::map<std::string,long> ChangesetCommentMap;
-	ChangesetCommentMap comments;
+	ConcurrentCounter comments { &arena };
+	std::shared_ptr<StreetCompleteComments>	streetComplete = StreetCompleteComments::shared();
+
+	std::vector<ChangesetReader *> stages() { return std::vector<ChangesetReader *>( 1, streetComplete.get() ); }
+
+	// the counter's shards have arenas of their own
+	void addMemoryUsage( ArenaUsage & usage ) const
+	{
+		usage.add( arena );
+		comments.addMemoryUsage( usage );
+	}
 
 	void initialize() {}
 	void process(const Changeset & changeset)
 	{
-		auto it = comments.find(changeset.comment);
-		if ( it == comments.end() ) {
-			it = comments.insert( std::pair<std::string,long>(changeset.comment, 0) ).first;
-		}
-		it->second++;
+		comments.add(changeset.comment, CommentHash(changeset), 1);
+	}
+
+	bool canRetract() { return true; }
+	void retract(const Changeset & changeset)
+	{
+		comments.add(changeset.comment, CommentHash(changeset), -1);
 	}
 
 	void finalize()
 	{
 		// print changeset comments
 		typedef std::pair<long,std::string> Entry;
-		std::vector<Entry> list;
-		list.reserve( comments.size());
+		TopEntries<Entry> list(100);
 		long total = 0;
-		for ( const auto & c: comments ) {
-			if ( g_StreetCompleteComments.find( c.first ) != g_StreetCompleteComments.end() )
-				continue;	// exclude comments from StreetComplete
-			list.push_back(Entry(c.second,c.first));
-			total += c.second;
-		}
-		std::sort(list.begin(),list.end());
-		std::reverse(list.begin(),list.end());
-		printf("\n");
-		printf("Top 100 changeset comments:\n");
-		for ( int i = 0; i < 100; ++i ) {
-			const Entry & c = list[ i ];
+		comments.forEach( [&]( const std::string & comment, long count ) {
+			if ( count == 0 )
+				return;	// retracted
+			if ( streetComplete->contains( comment ) )
+				return;	// exclude comments from StreetComplete
+			list.add(Entry(count,comment));
+			total += count;
+		});
+		fprintf(out, "\n");
+		fprintf(out, "Top 100 changeset comments:\n");
+		for ( const auto & c: list.sorted() ) {
 			double percent = 100.0 * c.first / total;
-			printf("%9ld (%.6f%%) \"%s\"\n", c.first, percent, c.second.c_str());
+			fprintf(out, "%9s (%.6f%%) \"%s\"\n", scaledCount( c.first ).c_str(), percent, c.second.c_str());
 		}
 	}
 };
 
 // Track the most common changeset comments
 class ChangesetCommentPerEditorReader: public ChangesetReader {
-	typedef std::map<std::string,long> ChangesetCommentMap;
-	typedef std::map<std::string,ChangesetCommentMap> EditorMap;
-	EditorMap comments;
+	SpillingCounter comments = SpillingCounter( &arena );	// keyed by editor and comment, separated by a NUL
+	std::string		key;
+	std::shared_ptr<StreetCompleteComments>	streetComplete = StreetCompleteComments::shared();
+
+	std::vector<ChangesetReader *> stages() { return std::vector<ChangesetReader *>( 1, streetComplete.get() ); }
 
 	void initialize() {}
+
+	// The comment's hash is shared with the other comment readers, and mixed with the editor's id for the key
+	void add(const Changeset & changeset, long value)
+	{
+		key.assign(changeset.application);
+		key.push_back('\0');
+		key.append(changeset.comment);
+		size_t hash = CommentHash(changeset) ^ ((size_t)ApplicationId(changeset) * 0x9E3779B97F4A7C15ULL);
+		comments.add(key, hash, value);
+	}
+
 	void process(const Changeset & changeset)
 	{
-		auto app = comments.find(changeset.application);
-		if ( app == comments.end() ) {
-			app = comments.insert( std::pair<std::string,ChangesetCommentMap>(changeset.application,
-																			 ChangesetCommentMap()) ).first;
-		}
-		auto comment = app->second.find(changeset.comment);
-		if ( comment == app->second.end() ) {
-			comment = app->second.insert( std::pair<std::string,long>(changeset.comment, 0)).first;
+		add(changeset, 1);
+	}
+
+	bool canRetract() { return true; }
+	void retract(const Changeset & changeset)
+	{
+		add(changeset, -1);
+	}
+
+	void printEditor( const std::string & editor, TopEntries<std::pair<long,std::string>> & list, long total )
+	{
+		const auto & top = list.sorted();
+		if ( top.size() > 0 ) {
+			fprintf(out, "Top 10 changeset comments for %s:\n", editor.c_str());
+			for ( const auto & c: top ) {
+				double percent = 100.0 * c.first / total;
+				fprintf(out, "%9s (%.6f%%) \"%s\"\n", scaledCount( c.first ).c_str(), percent, c.second.c_str());
+			}
 		}
-		comment->second++;
 	}
 
 	void finalize()
 	{
-		printf("\n");
-		printf("Top 10 changeset comments per editor:\n");
-		for ( const auto & app: comments ) {
-			// print changeset comments
-			typedef std::pair<long,std::string> Entry;
-			std::vector<Entry> list;
-			list.reserve( app.second.size());
-			long total = 0;
-			for ( const auto & c: app.second ) {
-				if ( g_StreetCompleteComments.find( c.first ) != g_StreetCompleteComments.end() )
-					continue;	// exclude comments from StreetComplete
-				list.push_back(Entry(c.second,c.first));
-				total += c.second;
-			}
-			std::sort(list.begin(),list.end());
-			std::reverse(list.begin(),list.end());
-			long max = list.size();
-			if (max > 10) max = 10;
-			if ( max > 0 ) {
-				printf("Top 10 changeset comments for %s:\n", app.first.c_str());
-				for ( int i = 0; i < max; ++i ) {
-					const Entry & c = list[ i ];
-					double percent = 100.0 * c.first / total;
-					printf("%9ld (%.6f%%) \"%s\"\n", c.first, percent, c.second.c_str());
-				}
+		fprintf(out, "\n");
+		fprintf(out, "Top 10 changeset comments per editor:\n");
+
+		// keys arrive sorted, so all the comments for an editor are together
+		typedef std::pair<long,std::string> Entry;
+		TopEntries<Entry> list(10);
+		std::string editor;
+		long total = 0;
+		bool first = true;
+		comments.forEach( [&]( const std::string & key, long count ) {
+			if ( count == 0 )
+				return;	// retracted
+			size_t split = key.find('\0');
+			if ( first || key.compare(0, split, editor) != 0 || split != editor.size() ) {
+				if ( !first )
+					printEditor( editor, list, total );
+				editor.assign( key, 0, split );
+				list = TopEntries<Entry>(10);
+				total = 0;
+				first = false;
 			}
-		}
+			std::string comment = key.substr( split + 1 );
+			if ( streetComplete->contains( comment ) )
+				return;	// exclude comments from StreetComplete
+			list.add(Entry(count,comment));
+			total += count;
+		});
+		if ( !first )
+			printEditor( editor, list, total );
 	}
 };
 
@@ -521,7 +766,7 @@ class DatePrinterReader: public ChangesetReader {
 	void process(const Changeset & changeset)
 	{
 		if ( prev.length() == 0 || (prev[3] != changeset.date[3] && changeset.date >= "2010") ) {
-			printf("%s\n",changeset.date.c_str());
+			fprintf(out, "%s\n",changeset.date.c_str());
 		}
 		prev = changeset.date;
 	}
@@ -532,44 +777,39 @@ class DatePrinterReader: public ChangesetReader {
 
 //
 class RetentionReader: public ChangesetReader {
-	typedef std::map<std::string,long> EditorToCount;
-	typedef std::map<std::string,EditorToCount> YearToEditor;	// year, editor, count
-	YearToEditor	yearToEditor;		// year: editor: count
+	TimeGroupBy		editorsPerYear = TimeGroupBy( BUCKET_YEAR, AGGREGATE_SUM, &arena );
 
 	void initialize() {}
 	void process(const Changeset & changeset)
 	{
-		auto year = changeset.date.substr(0,4);
-		auto editorToCountDict = yearToEditor.find(year);
-		if ( editorToCountDict == yearToEditor.end() ) {
-			editorToCountDict = yearToEditor.insert(std::pair<std::string,EditorToCount>(year,EditorToCount())).first;
-		}
-		auto editorMap = &editorToCountDict->second;
-		auto editor = editorMap->find( changeset.application ) ;
-		if ( editor == editorMap->end() ) {
-			editor = editorMap->insert(std::pair<std::string,long>(changeset.application,0)).first;
-		}
-		++editor->second;
+		editorsPerYear.add( changeset.date, changeset.application );
+	}
+
+	bool usesRollup() { return true; }
+	void processRollup(const RollupCube & cube)
+	{
+		cube.forEachCell( [&]( const RollupCube::Cell & cell ) {
+			editorsPerYear.add( cube.string( cell.date ), cube.string( cell.editor ), cell.changesets );
+		});
 	}
 
 	void finalize()
 	{
-		printf("\n");
-		printf("Retention per editor\n");
-		for ( const auto &year: yearToEditor ) {
-			printf("year %s\n", year.first.c_str());
-			auto eds = year.second;
+		fprintf(out, "\n");
+		fprintf(out, "Retention per editor\n");
+		for ( int year = 0; year < editorsPerYear.bucketCount(); ++year ) {
+			if ( editorsPerYear.bucketEmpty( year ) )
+				continue;
+			fprintf(out, "year %s\n", editorsPerYear.bucketLabel( year ).c_str());
 			std::vector<std::pair<long, std::string>>	edVector;
-			for ( const auto &ed: eds ) {
-				edVector.push_back(std::pair<long,std::string>(ed.second,ed.first));
+			for ( int ed = 0; ed < editorsPerYear.dimensionCount(); ++ed ) {
+				if ( editorsPerYear.count( year, ed ) > 0 ) {
+					edVector.push_back(std::pair<long,std::string>(editorsPerYear.value( year, ed ),editorsPerYear.dimensionName( ed )));
+				}
 			}
-			std::sort(edVector.begin(), edVector.end());
-			std::reverse(edVector.begin(), edVector.end());
-			int count = 0;
+			ParallelTopN(edVector, 10, std::greater<std::pair<long,std::string>>());
 			for ( const auto &ed: edVector ) {
-				printf("    %10ld:  %s\n", ed.first, ed.second.c_str() );
-				if ( ++count == 10 )
-					break;
+				fprintf(out, "    %10s:  %s\n", scaledCount( ed.first ).c_str(), ed.second.c_str() );
 			}
 		}
 	}
@@ -582,8 +822,8 @@ class EditsPerChangesetReader: public ChangesetReader {
 		int changesets;
 		long lastChangeset;
 	};
-	typedef std::map<std::string,struct stats> Map;
-	Map ratio;
+	typedef ArenaMap<std::string,struct stats> Map;
+	Map ratio = Map( &arena );
 
 	void initialize() {}
 	void process(const Changeset & changeset)
@@ -595,8 +835,29 @@ class EditsPerChangesetReader: public ChangesetReader {
 		}
 		editor->second.changesets += 1;
 		editor->second.edits += changeset.editCount;
-		editor->second.lastChangeset = changeset.ident;
+		editor->second.lastChangeset = std::max( editor->second.lastChangeset, changeset.ident );
+
+	}
+
+	bool usesRollup() { return true; }
+	void processRollup(const RollupCube & cube)
+	{
+		cube.forEachCell( [&]( const RollupCube::Cell & cell ) {
+			struct stats & s = ratio[cube.string( cell.editor )];
+			s.changesets += cell.changesets;
+			s.edits += cell.edits;
+			s.lastChangeset = std::max( s.lastChangeset, cell.lastChangeset );
+		});
+	}
 
+	bool canRetract() { return true; }
+	void retract(const Changeset & changeset)
+	{
+		auto editor = ratio.find( changeset.application );
+		if ( editor != ratio.end() ) {
+			editor->second.changesets -= 1;
+			editor->second.edits -= changeset.editCount;
+		}
 	}
 
 	void finalize()
@@ -610,6 +871,8 @@ class EditsPerChangesetReader: public ChangesetReader {
 		};
 		std::vector<struct info>	vec;
 		for ( const auto &editor: ratio ) {
+			if ( editor.second.changesets == 0 )
+				continue;
 			struct info info = {
 				editor.first,
 				(double)editor.second.edits / editor.second.changesets,
@@ -618,14 +881,13 @@ class EditsPerChangesetReader: public ChangesetReader {
 			};
 			vec.push_back(info);
 		}
-		std::sort(vec.begin(), vec.end());
-		std::reverse(vec.begin(), vec.end() );
+		ParallelSort(vec.begin(), vec.end(), [](const struct info & a, const struct info & b) { return b < a; } );
 
-		printf("\n");
-		printf("Edits/changeset per application\n");
+		fprintf(out, "\n");
+		fprintf(out, "Edits/changeset per application\n");
 		for ( const auto &editor: vec ) {
 			if ( editor.changesets >= 100 ) {
-				printf("%11.6f:  %s [%ld]\n", editor.ratio, editor.editor.c_str(), editor.lastChangeset );
+				fprintf(out, "%11.6f:  %s [%ld]\n", editor.ratio, editor.editor.c_str(), editor.lastChangeset );
 			}
 		}
 	}
@@ -633,122 +895,410 @@ class EditsPerChangesetReader: public ChangesetReader {
 
 //
 class EditStreaksReader: public ChangesetReader {
-	typedef std::set<std::string>	SetOfUsers;
-	typedef std::map<std::string,SetOfUsers>	UsersForDate;
-	UsersForDate	usersForDate;
+	// A run of consecutive days, as DayNumbers, with end < 0 when there is none
+	struct run {
+		int start = 0;
+		int end = -1;
+		int days() const { return end - start + 1; }
+	};
+	// The run in progress, and the one before it, which is kept until another one starts
+	// so a late changeset can still fill the gap between them
+	struct editorStats {
+		run current;
+		run previous;
+	};
+	struct streakInfo {
+		int				uid;
+		std::string		startDate;
+		int				dayCount;
+		bool operator < (const struct streakInfo & other) const {
+			if ( dayCount != other.dayCount )
+				return dayCount < other.dayCount;
+			if ( startDate != other.startDate )
+				return startDate > other.startDate;
+			return uid > other.uid;
+		}
+	};
+	PerUser<struct editorStats>		editors = PerUser<struct editorStats>( &arena );
+	std::vector<struct streakInfo>	streakList;
+	std::string						prevDate = "";
+	int								day = 0;		// DayNumber of prevDate
+	int								lastDay = 0;	// the latest day seen
+
+	// Record a streak if it's long enough to care
+	void record( int uid, const run & r )
+	{
+		if ( r.end >= 0 && r.days() > 100 ) {
+			struct streakInfo s = { uid, DateString( r.start ), r.days() };
+			streakList.push_back( s );
+		}
+	}
 
+	// Changesets arrive roughly in date order, so streaks are tracked as we go rather than
+	// collecting the users for every date first. Streaks are keyed on calendar days, and a
+	// changeset that arrives after later days still joins the run it belongs to, as long as
+	// it is no older than the user's previous run.
 	void initialize() {}
+	bool scalesSamples() { return false; }		// a sample breaks streaks
 	void process(const Changeset & changeset)
 	{
-		usersForDate[changeset.date].insert(changeset.user);
+		if ( changeset.date != prevDate ) {
+			prevDate = changeset.date;
+			day = DayNumber( changeset.date );
+			if ( day > lastDay )
+				lastDay = day;
+		}
+		struct editorStats & editor = editors[changeset.uid];
+		run & current = editor.current;
+		run & previous = editor.previous;
+		if ( current.end < 0 ) {
+			// new editor
+			current.start = current.end = day;
+		} else if ( day >= current.start && day <= current.end ) {
+			// another edit on a day already counted
+		} else if ( day == current.end + 1 ) {
+			// they continued their streak
+			current.end = day;
+		} else if ( day > current.end ) {
+			// They missed a day, so the current streak is over and a new one starts
+			record( changeset.uid, previous );
+			previous = current;
+			current.start = current.end = day;
+		} else if ( day == current.start - 1 ) {
+			// a late changeset extends the streak backward, possibly joining the previous one
+			current.start = day;
+			if ( previous.end >= 0 && previous.end == day - 1 ) {
+				current.start = previous.start;
+				previous = run();
+			}
+		} else if ( previous.end >= 0 ) {
+			// a late changeset around the previous streak
+			if ( day == previous.end + 1 )
+				previous.end = day;
+			else if ( day == previous.start - 1 )
+				previous.start = day;
+		}
 	}
 
 	void finalize()
 	{
-		// convert the date map to a vector of dates and users
-		std::vector<std::pair<std::string,SetOfUsers>>	dateList;
-		for (const auto &it: usersForDate) {
-			dateList.push_back(std::pair<std::string,SetOfUsers>(it.first,it.second));
+		// Handle any streaks in progress
+		for ( size_t i = 0; i < editors.size(); ++i ) {
+			const struct editorStats & editor = editors.value(i);
+			record( editors.uid(i), editor.previous );
+			if ( editor.current.end >= lastDay-1 )
+				record( editors.uid(i), editor.current );
 		}
-		std::sort( dateList.begin(), dateList.end() );
 
-		struct editorStats {
-			int prevDay;
-			int dayCount;
-			std::string startDate;
-		};
-		typedef std::map<std::string,struct editorStats> Editors;
+		ParallelTopN(streakList, 1000, [](const struct streakInfo & a, const struct streakInfo & b) { return b < a; } );
+
+		fprintf(out, "\n");
+		fprintf(out, "Longest editing streaks:\n");
+		fprintf(out, "| Consecutive Days | First Day of Streak | User            |\n");
+		fprintf(out, "|------|------------|-----------------|\n");
+		for ( const auto &s: streakList ) {
+			const std::string & name = g_Users.name(s.uid);
+			std::string user = std::regex_replace(name, std::regex(" "), "%20");
+			fprintf(out, "|%11d| %s | [%s](https://www.openstreetmap.org/user/%s) |\n",
+				   s.dayCount, s.startDate.c_str(), name.c_str(), user.c_str() );
+		}
+	}
+};
 
-		struct streakInfo {
-			std::string		user;
-			std::string		startDate;
-			int				dayCount;
-			bool operator < (const struct streakInfo & other) const { return dayCount < other.dayCount; }
-		};
-		std::vector<struct streakInfo>	streakList;
 
-		std::string prevDay = "";
-		int dayCounter = 0;
-		Editors editors;
+// Rolling 28-day active users and the 7-day average of daily edits for each editor, with a
+// row for every day of the input
+class RollingActiveUsersReader: public ChangesetReader {
+	static const int USER_DAYS = 28;
+	static const int EDIT_DAYS = 7;
+	TimeGroupBy		activeUsers = TimeGroupBy( BUCKET_DAY, AGGREGATE_LAST, &arena );
+	TimeGroupBy		averageEdits = TimeGroupBy( BUCKET_DAY, AGGREGATE_LAST, &arena );
+	SlidingWindow	userWindow = SlidingWindow( USER_DAYS, [this]( int day ) {
+		int bucket = activeUsers.bucket( DateString( day ) );
+		for ( int editor = 0; editor < userWindow.dimensionCount(); ++editor ) {
+			if ( userWindow.activeUsers( editor ) > 0 )
+				activeUsers.add( bucket, activeUsers.dimension( ApplicationName( editor ) ), userWindow.activeUsers( editor ) );
+		}
+	}, &arena );
+	SlidingWindow	editWindow = SlidingWindow( EDIT_DAYS, [this]( int day ) {
+		int bucket = averageEdits.bucket( DateString( day ) );
+		for ( int editor = 0; editor < editWindow.dimensionCount(); ++editor ) {
+			if ( editWindow.total( editor ) > 0 )
+				averageEdits.add( bucket, averageEdits.dimension( ApplicationName( editor ) ),
+								 (editWindow.total( editor ) + EDIT_DAYS / 2) / EDIT_DAYS );
+		}
+	}, &arena );
+	std::string		prevDate;
+	int				dayNumber = 0;
+
+	void initialize() {}
+	bool scalesSamples() { return false; }
+	void process(const Changeset & changeset)
+	{
+		if ( changeset.date.size() < 10 )
+			return;
+		if ( changeset.date != prevDate ) {
+			prevDate = changeset.date;
+			dayNumber = DayNumber( changeset.date );
+		}
+		int editor = ApplicationId( changeset );
+		userWindow.addUser( dayNumber, editor, changeset.uid );
+		editWindow.addValue( dayNumber, editor, changeset.editCount );
+	}
 
-		for (const auto &date: dateList) {
-			if ( date.first != prevDay ) {
-				prevDay = date.first;
-				++dayCounter;
-			}
-			for (const auto &user: date.second) {
-				auto editor = editors.find( user );
-				if ( editor == editors.end() ) {
-					// new editor, so create a new entry for them
-					struct editorStats s = { dayCounter, 1, date.first };
-					editor = editors.insert(std::pair<std::string, struct editorStats>(user,s)).first;
-				}
-				if ( editor->second.prevDay == dayCounter ) {
-					// another edit on the same day
-				} else if ( editor->second.prevDay == dayCounter-1 ) {
-					// they continued their streak
-					editor->second.prevDay = dayCounter;
-					editor->second.dayCount += 1;
-				} else {
-					// Their missed a day. Record their current streak if it's long enough to care
-					if ( editor->second.dayCount > 100 ) {
-						struct streakInfo s = { editor->first, editor->second.startDate, editor->second.dayCount };
-						streakList.push_back( s );
-					}
-					// and start a new streak
-					editor->second.prevDay = dayCounter;
-					editor->second.dayCount = 1;
-					editor->second.startDate = date.first;
-				}
+	void finalize()
+	{
+		userWindow.finish();
+		editWindow.finish();
+
+		fprintf( out, "\n" );
+		fprintf( out, "Rolling %d-day active users per editor:\n", USER_DAYS );
+		activeUsers.printMatrix( out );
+		fprintf( out, "\n" );
+		fprintf( out, "Average daily edits over the last %d days per editor:\n", EDIT_DAYS );
+		averageEdits.printMatrix( out );
+	}
+};
+
+
+// Exact distinct users per day, per month and per editor, and how many people use
+// both of each pair of the most used editors
+class DistinctUsersReader: public ChangesetReader {
+	static const int OVERLAP_EDITORS = 10;
+	std::vector<UserSet>	editorUsers;			// every user of each editor, indexed by ApplicationId
+	std::vector<UserSet>	dayUsers, monthUsers;	// the users of each editor in the current day and month
+	UserSet					allDay = UserSet( &arena ), allMonth = UserSet( &arena ), allUsers = UserSet( &arena );
+	TimeGroupBy				daily = TimeGroupBy( BUCKET_DAY, AGGREGATE_LAST, &arena );
+	TimeGroupBy				monthly = TimeGroupBy( BUCKET_MONTH, AGGREGATE_LAST, &arena );
+	std::string				currentDay, currentMonth;
+
+	// Records the sizes of the sets for the period and empties them
+	static void flush( const std::string & date, std::vector<UserSet> & sets, UserSet & all, TimeGroupBy & table )
+	{
+		int bucket = table.bucket( date );
+		for ( size_t editor = 0; editor < sets.size(); ++editor ) {
+			if ( !sets[editor].empty() ) {
+				table.add( bucket, table.dimension( ApplicationName( (int)editor ) ), sets[editor].size() );
+				sets[editor].clear();
 			}
 		}
+		if ( !all.empty() ) {
+			table.add( bucket, table.dimension( "(all editors)" ), all.size() );
+			all.clear();
+		}
+	}
 
-		// Handle any streaks in progress
-		for ( const auto &editor: editors ) {
-			if ( editor.second.prevDay >= dayCounter-1 ) {
-				if ( editor.second.dayCount > 100 ) {
-					struct streakInfo s = { editor.first, editor.second.startDate, editor.second.dayCount };
-					streakList.push_back( s );
-				}
+	void initialize() {}
+	bool scalesSamples() { return false; }
+	void process(const Changeset & changeset)
+	{
+		if ( changeset.date.size() < 10 )
+			return;
+		// Changesets are in date order, give or take a few at the change of a day, which are
+		// counted in the day that is current
+		if ( changeset.date > currentDay ) {
+			if ( currentDay.size() > 0 )
+				flush( currentDay, dayUsers, allDay, daily );
+			currentDay = changeset.date;
+			if ( changeset.date.compare( 0, 7, currentMonth ) != 0 ) {
+				if ( currentMonth.size() > 0 )
+					flush( currentMonth + "-01", monthUsers, allMonth, monthly );
+				currentMonth = changeset.date.substr( 0, 7 );
 			}
 		}
+		int editor = ApplicationId( changeset );
+		if ( editor >= (int)editorUsers.size() ) {
+			editorUsers.resize( editor + 1, UserSet( &arena ) );
+			dayUsers.resize( editor + 1, UserSet( &arena ) );
+			monthUsers.resize( editor + 1, UserSet( &arena ) );
+		}
+		uint32_t uid = (uint32_t)changeset.uid;
+		if ( editorUsers[editor].add( uid ) )
+			allUsers.add( uid );
+		dayUsers[editor].add( uid );
+		monthUsers[editor].add( uid );
+		allDay.add( uid );
+		allMonth.add( uid );
+	}
+
+	void finalize()
+	{
+		if ( currentDay.size() > 0 ) {
+			flush( currentDay, dayUsers, allDay, daily );
+			flush( currentMonth + "-01", monthUsers, allMonth, monthly );
+		}
 
-		std::sort(streakList.begin(), streakList.end());
-		std::reverse(streakList.begin(), streakList.end() );
+		std::vector<std::pair<long,int>> editors;	// users and ApplicationId
+		size_t bytes = allUsers.bytes();
+		for ( size_t editor = 0; editor < editorUsers.size(); ++editor ) {
+			bytes += editorUsers[editor].bytes();
+			if ( !editorUsers[editor].empty() )
+				editors.push_back( std::make_pair( editorUsers[editor].size(), (int)editor ) );
+		}
+		std::sort( editors.begin(), editors.end(), []( const std::pair<long,int> & a, const std::pair<long,int> & b ) {
+			return a.first != b.first ? a.first > b.first : ApplicationName( a.second ) < ApplicationName( b.second );
+		});
+
+		fprintf( out, "\n" );
+		fprintf( out, "Distinct users per editor (%ld in all, in %.1f KB of bitmaps):\n", allUsers.size(), bytes / 1024.0 );
+		for ( const auto &editor: editors ) {
+			fprintf( out, "%9ld  %s\n", editor.first, ApplicationName( editor.second ).c_str() );
+		}
 
-		printf("\n");
-		printf("Longest editing streaks:\n");
-		printf("| Consecutive Days | First Day of Streak | User            |\n");
-		printf("|------|------------|-----------------|\n");
-		size_t count = streakList.size();
-		if ( count > 1000 )
-			count = 1000;
-		for ( int i = 0; i < count; ++i ) {
-			const auto s = streakList[i];
-			if ( s.dayCount == 0 )
-				break;
-			std::string user = std::regex_replace(s.user, std::regex(" "), "%20");
-			printf("|%11d| %s | [%s](https://www.openstreetmap.org/user/%s) |\n",
-				   s.dayCount, s.startDate.c_str(), s.user.c_str(), user.c_str() );
+		struct Overlap {
+			long	users;
+			int		a, b;
+		};
+		std::vector<Overlap> overlaps;
+		size_t top = std::min( editors.size(), (size_t)OVERLAP_EDITORS );
+		for ( size_t i = 0; i < top; ++i ) {
+			for ( size_t j = i + 1; j < top; ++j ) {
+				Overlap overlap = {
+					UserSet::intersectionCount( editorUsers[editors[i].second], editorUsers[editors[j].second] ),
+					editors[i].second, editors[j].second
+				};
+				overlaps.push_back( overlap );
+			}
 		}
+		std::stable_sort( overlaps.begin(), overlaps.end(), []( const Overlap & a, const Overlap & b ) {
+			return a.users > b.users;
+		});
+		fprintf( out, "\n" );
+		fprintf( out, "Users of both editors, for the %d editors with the most users:\n", (int)top );
+		for ( const auto &overlap: overlaps ) {
+			fprintf( out, "%9ld  %s and %s\n", overlap.users,
+					ApplicationName( overlap.a ).c_str(), ApplicationName( overlap.b ).c_str() );
+		}
+
+		fprintf( out, "\n" );
+		fprintf( out, "Distinct users per month:\n" );
+		monthly.printMatrix( out );
+		fprintf( out, "\n" );
+		fprintf( out, "Distinct users per day:\n" );
+		daily.printMatrix( out );
 	}
 };
 
 
-std::vector<ChangesetReader *> getReaders()
+struct ReaderInfo {
+	std::string			name;
+	ReaderFactory		create;
+};
+
+template <class T> static ChangesetReader * createReader( const ReaderParameters &, std::string & )
+{
+	return new T();
+}
+
+// for readers that take parameters
+template <class T> static ChangesetReader * createConfiguredReader( const ReaderParameters & params, std::string & )
+{
+	return new T( params );
+}
+
+// The built-in readers, followed by any that have been registered
+static std::vector<ReaderInfo> & Registry()
+{
+	static std::vector<ReaderInfo> registry = {
+		{ "DatePrinter",				createReader<DatePrinterReader> },
+		{ "EditorDailyUsers",			createReader<EditorDailyUsersReader> },
+		{ "LargeArea",					createReader<LargeAreaReader> },
+		{ "BiggestMappersByApp",		createReader<BiggestMappersByApp> },
+		{ "StreetComplete",				createReader<StreetCompleteReader> },
+		{ "ChangesetComment",			createReader<ChangesetCommentReader> },
+		{ "ChangesetCommentPerEditor",	createReader<ChangesetCommentPerEditorReader> },
+		{ "GoMapLocale",				createConfiguredReader<GoMapLocaleReader> },
+		{ "GoMapInCountry",				createConfiguredReader<GoMapInCountryReader> },
+		{ "GoMapVersions",				createConfiguredReader<GoMapVersionsReader> },
+		{ "Retention",					createReader<RetentionReader> },
+		{ "EditsPerChangeset",			createReader<EditsPerChangesetReader> },
+		{ "EditStreaks",				createReader<EditStreaksReader> },
+		{ "RollingActiveUsers",			createReader<RollingActiveUsersReader> },
+		{ "DistinctUsers",				createReader<DistinctUsersReader> },
+	};
+	return registry;
+}
+
+// The readers used when none are asked for, in the order their reports are printed
+static const char * defaultReaders[] = {
+	"EditorDailyUsers",
+	"BiggestMappersByApp",
+	"StreetComplete",
+	"ChangesetComment",
+	"ChangesetCommentPerEditor",
+	"GoMapLocale",
+	"GoMapInCountry",
+	"GoMapVersions",
+	"Retention",
+	"EditsPerChangeset",
+	"EditStreaks",
+};
+
+std::vector<ChangesetReader *> getReaders( const ReaderParameters & params )
 {
 	std::vector<ChangesetReader *>	readers;
-//	readers.push_back(new DatePrinterReader());
-	readers.push_back(new EditorDailyUsersReader());
-	readers.push_back(new BiggestMappersByApp());
-	readers.push_back(new StreetCompleteReader());
-	readers.push_back(new ChangesetCommentReader());
-	readers.push_back(new ChangesetCommentPerEditorReader());
-	readers.push_back(new GoMapLocaleReader());
-	readers.push_back(new GoMapInCountryReader());
-	readers.push_back(new GoMapVersionsReader());
-	readers.push_back(new RetentionReader());
-	readers.push_back(new EditsPerChangesetReader());
-	readers.push_back(new EditStreaksReader());
+	for ( const char * name: defaultReaders ) {
+		readers.push_back( newReader( name, params ) );
+	}
 	return readers;
 }
+
+std::vector<std::string> getReaderNames()
+{
+	std::vector<std::string> names;
+	for ( const auto &info: Registry() ) {
+		names.push_back( info.name );
+	}
+	return names;
+}
+
+static ChangesetReader * newReader( const std::string & name, const ReaderParameters & params, std::string & error )
+{
+	for ( const auto &info: Registry() ) {
+		if ( name == info.name ) {
+			ChangesetReader * reader = info.create( params, error );
+			if ( reader )
+				reader->name = name;
+			else if ( error.empty() )
+				error = "reader '" + name + "' couldn't be created";
+			return reader;
+		}
+	}
+	error = "unknown reader '" + name + "'";
+	return NULL;
+}
+
+ChangesetReader * newReader( const std::string & name, const ReaderParameters & params )
+{
+	std::string error;
+	return newReader( name, params, error );
+}
+
+bool newReaders( const std::string & names, const ReaderParameters & params,
+				std::vector<ChangesetReader *> & readers, std::string & error )
+{
+	size_t pos = 0;
+	while ( pos <= names.size() ) {
+		size_t comma = names.find( ',', pos );
+		if ( comma == std::string::npos )
+			comma = names.size();
+		std::string name = names.substr( pos, comma - pos );
+		pos = comma + 1;
+		ChangesetReader * reader = newReader( name, params, error );
+		if ( reader == NULL )
+			return false;
+		readers.push_back( reader );
+	}
+	return true;
+}
+
+bool registerReader( const std::string & name, const ReaderFactory & create )
+{
+	for ( const auto &info: Registry() ) {
+		if ( name == info.name )
+			return false;
+	}
+	ReaderInfo info = { name, create };
+	Registry().push_back( info );
+	return true;
+}
@@ -10,8 +10,37 @@
 #define Readers_hpp
 
 #include "ChangesetParser.hpp"
+#include <functional>
+#include <string>
 #include <vector>
 
-std::vector<ChangesetReader *> getReaders();
+// Settings for the readers, from the command line or a server query
+struct ReaderParameters {
+	std::string		startDate;
+	std::string		endDate;
+	std::string		country = "China";		// GoMapInCountry
+	std::string		editor = "Go Map!!";	// GoMapInCountry, GoMapLocale and GoMapVersions
+};
+
+// Creates a reader, or returns NULL with the reason in error
+typedef std::function<ChangesetReader *(const ReaderParameters & params, std::string & error)> ReaderFactory;
+
+// The readers used when none are asked for
+std::vector<ChangesetReader *> getReaders( const ReaderParameters & params = ReaderParameters() );
+
+// Readers can also be created by name, e.g. "Retention" for RetentionReader
+std::vector<std::string> getReaderNames();
+ChangesetReader * newReader( const std::string & name, const ReaderParameters & params = ReaderParameters() );
+
+// Creates the readers in a comma separated list of names. On failure error says which
+// reader couldn't be created and why.
+bool newReaders( const std::string & names, const ReaderParameters & params,
+				std::vector<ChangesetReader *> & readers, std::string & error );
+
+// Whether the changeset's bounding box is more than 1000 km corner to corner
+bool IsLargeArea( const Changeset & changeset );
+
+// Adds a reader that can be created by name. Returns false if the name is already taken.
+bool registerReader( const std::string & name, const ReaderFactory & create );
 
 #endif /* Readers_hpp */
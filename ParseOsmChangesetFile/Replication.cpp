@@ -0,0 +1,191 @@
+//
+//  Replication.cpp
+//  ParseOsmChangesetFile
+//
+//  Created by Bryce Cogswell on 10/18/26.
+//  Copyright © 2026 Bryce Cogswell. All rights reserved.
+//
+
+#include <algorithm>
+#include <dirent.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <zlib.h>
+
+#include "Replication.hpp"
+
+// Passes the changesets parsed from a replication file to the ingester
+class ReplicationReader: public ChangesetReader {
+	ReplicationIngester &	ingester;
+public:
+	ReplicationReader( ReplicationIngester & ingester ) : ingester(ingester) {}
+	void initialize() {}
+	void process( const Changeset & changeset )	{ ingester.apply( changeset ); }
+	void finalize() {}
+};
+
+struct ReplicationFile {
+	long			sequence;
+	std::string		path;
+};
+
+static bool IsDirectory( const std::string & path )
+{
+	struct stat info;
+	return stat( path.c_str(), &info ) == 0 && S_ISDIR( info.st_mode );
+}
+
+// Finds files named like 456.osm or 456.osm.gz in directories named like 005/123,
+// and combines the numbers in the path into a sequence number, 5123456.
+static bool FindReplicationFiles( const std::string & directory, long prefix, std::vector<ReplicationFile> & files )
+{
+	DIR * dir = opendir( directory.c_str() );
+	if ( dir == NULL ) {
+		perror( directory.c_str() );
+		return false;
+	}
+	bool ok = true;
+	while ( struct dirent * entry = readdir( dir ) ) {
+		const char * name = entry->d_name;
+		size_t digits = strspn( name, "0123456789" );
+		if ( digits == 0 )
+			continue;
+		long sequence = prefix;
+		for ( size_t i = 0; i < digits; ++i ) {
+			sequence = sequence * 10 + (name[i] - '0');
+		}
+		std::string path = directory + "/" + name;
+		const char * suffix = name + digits;
+		if ( *suffix == '\0' && IsDirectory( path ) ) {
+			if ( !FindReplicationFiles( path, sequence, files ) )
+				ok = false;
+		} else if ( strcmp( suffix, ".osm" ) == 0 || strcmp( suffix, ".osm.gz" ) == 0 ) {
+			ReplicationFile file = { sequence, path };
+			files.push_back( file );
+		}
+	}
+	closedir( dir );
+	return ok;
+}
+
+// Reads a file, decompressing it if it is gzipped
+static bool ReadFile( const std::string & path, std::vector<char> & contents )
+{
+	gzFile file = gzopen( path.c_str(), "rb" );
+	if ( file == NULL ) {
+		perror( path.c_str() );
+		return false;
+	}
+	contents.clear();
+	size_t length = 0;
+	for (;;) {
+		contents.resize( length + (1 << 20) );
+		int len = gzread( file, &contents[length], 1 << 20 );
+		if ( len < 0 ) {
+			int errnum;
+			fprintf( stderr, "%s: %s\n", path.c_str(), gzerror( file, &errnum ) );
+			gzclose( file );
+			return false;
+		}
+		if ( len == 0 )
+			break;
+		length += len;
+	}
+	gzclose( file );
+	contents.resize( length );
+	contents.push_back( '\0' );
+	return true;
+}
+
+ReplicationIngester::ReplicationIngester( ChangesetStore & store, const std::vector<ChangesetReader *> & readers,
+										 const std::string & startDate, const std::string & endDate,
+										 const ChangesetFilter & filter )
+	: store(store), startDate(startDate), endDate(endDate), valid(true), added(0), updated(0)
+{
+	live.setFilter( filter );
+	deferred.setFilter( filter );
+	for ( auto reader: readers ) {
+		if ( !all.add( reader ) ) {
+			valid = false;
+		} else if ( reader->canRetract() ) {
+			live.add( reader );
+		} else {
+			deferred.add( reader );
+		}
+	}
+}
+
+bool ReplicationIngester::inRange( const Changeset & changeset ) const
+{
+	return changeset.date >= startDate && (endDate.size() == 0 || changeset.date < endDate);
+}
+
+void ReplicationIngester::apply( const Changeset & changeset )
+{
+	if ( store.upsert( changeset, previous ) ) {
+		++updated;
+		if ( inRange( previous ) )
+			live.retract( previous );
+	} else {
+		++added;
+	}
+	if ( inRange( changeset ) && live.acceptsAttributes( changeset ) ) {
+		live.process( changeset );
+	}
+}
+
+bool ReplicationIngester::applyFile( const std::string & path, ChangesetParser & parser )
+{
+	std::vector<char> contents;
+	if ( !ReadFile( path, contents ) )
+		return false;
+	if ( !parser.parseXmlDocument( &contents[0], contents.size() - 1, "" ) ) {
+		fprintf( stderr, "%s: parse error\n", path.c_str() );
+		return false;
+	}
+	return true;
+}
+
+bool ReplicationIngester::run( const std::string & directory )
+{
+	if ( !valid )
+		return false;
+	std::vector<ReplicationFile> files;
+	if ( !FindReplicationFiles( directory, 0, files ) )
+		return false;
+	std::sort( files.begin(), files.end(), []( const ReplicationFile & a, const ReplicationFile & b ) {
+		return a.sequence < b.sequence;
+	});
+
+	all.initialize();
+
+	// the live readers start with what is already stored
+	store.replay( live, startDate, endDate );
+
+	// the files are parsed in full, so the store stays complete whatever else is sampled
+	ReplicationReader reader( *this );
+	ChangesetParser parser;
+	parser.setSampling( SampleSettings() );
+	parser.addReader( &reader );
+	parser.beginDocuments();
+	bool ok = true;
+	for ( const auto &file: files ) {
+		if ( !applyFile( file.path, parser ) ) {
+			ok = false;
+			break;
+		}
+	}
+	parser.endDocuments();
+	if ( !ok )
+		return false;
+
+	// the rest see the final version of everything
+	store.sortByDate();
+	store.replay( deferred, startDate, endDate );
+
+	printf( "Replication: %ld files, %ld new changesets, %ld updated\n", (long)files.size(), added, updated );
+	printf( "\n" );
+	all.finalize();
+	return true;
+}
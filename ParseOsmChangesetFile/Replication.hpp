@@ -0,0 +1,51 @@
+//
+//  Replication.hpp
+//  ParseOsmChangesetFile
+//
+//  Created by Bryce Cogswell on 10/18/26.
+//  Copyright © 2026 Bryce Cogswell. All rights reserved.
+//
+
+#ifndef Replication_hpp
+#define Replication_hpp
+
+#include <string>
+#include <vector>
+
+#include "ChangesetFilter.hpp"
+#include "ChangesetStore.hpp"
+
+// Brings a changeset store up to date with the minutely replication files, which are in the
+// same XML format as the full dump. Changesets that are still open when they are published
+// are published again as they change, so each one is upserted by id rather than appended.
+//
+// Readers that can retract a changeset see the stored changesets and then a delta for every
+// replicated one: the earlier version is retracted before the new one is processed. Readers
+// that can't retract see the final version of every changeset once all the files are applied.
+// Either way each changeset is counted once.
+class ReplicationIngester {
+	ChangesetStore &				store;
+	FilteredReaders					all;		// every reader, for initialize and finalize
+	FilteredReaders					live;		// readers that take deltas
+	FilteredReaders					deferred;	// readers that only see the final versions
+	std::string						startDate, endDate;
+	bool							valid;		// whether every reader's filter compiled
+	long							added, updated;
+	Changeset						previous;
+
+	bool inRange( const Changeset & changeset ) const;
+
+	bool applyFile( const std::string & path, ChangesetParser & parser );
+public:
+	ReplicationIngester( ChangesetStore & store, const std::vector<ChangesetReader *> & readers,
+						const std::string & startDate, const std::string & endDate, const ChangesetFilter & filter );
+
+	// Upserts a changeset into the store and passes the delta to the live readers
+	void apply( const Changeset & changeset );
+
+	// Applies every replication file in the directory in sequence order and runs the readers.
+	// Files are named by sequence number, e.g. 005/123/456.osm.gz, and may be gzipped or not.
+	bool run( const std::string & directory );
+};
+
+#endif /* Replication_hpp */
@@ -0,0 +1,284 @@
+//
+//  RollupCube.cpp
+//  ParseOsmChangesetFile
+//
+//  Created by Bryce Cogswell on 10/18/26.
+//  Copyright © 2026 Bryce Cogswell. All rights reserved.
+//
+
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+
+#include "Countries.h"
+#include "GroupBy.hpp"
+#include "Readers.hpp"
+#include "RollupCube.hpp"
+
+static const char	ROLLUP_MAGIC[8]		= { 'O','S','M','R','O','L','U','P' };
+static const uint32_t	ROLLUP_VERSION	= 1;
+
+// Stands in for a reader answered from the cube
+class RollupAnswerReader: public ChangesetReader {
+	const RollupCube &	cube;
+	ChangesetReader *	reader;
+public:
+	RollupAnswerReader( const RollupCube & cube, ChangesetReader * reader ) : cube(cube), reader(reader) {}
+
+	void initialize()
+	{
+		reader->initialize();
+		reader->processRollup( cube );
+	}
+	void process( const Changeset & ) {}
+	void finalize()
+	{
+		reader->out = out;
+		reader->finalize();
+		reader->out = stdout;
+	}
+};
+
+ChangesetReader * RollupCube::answer( ChangesetReader * reader ) const
+{
+	return new RollupAnswerReader( *this, reader );
+}
+
+// Changesets arrive mostly in date order, so the cells for a date are mostly together. Those
+// of recent dates are kept, so a changeset arriving after a later date's adds to its date's
+// cells and isn't counted as another user. A date older than that starts new cells, which
+// sum the same but count its users again.
+void RollupCube::beginDate( const std::string & date )
+{
+	if ( date < currentDate )
+		dateOrder = false;
+	currentDate = date;
+	auto it = recentDates.find( date );
+	if ( it == recentDates.end() ) {
+		it = recentDates.insert( std::make_pair( date, DateCells() ) ).first;
+		it->second.dateId = strings.intern( date );
+	}
+	current = &it->second;
+	if ( date > lastDate ) {
+		lastDate = date;
+		std::string oldest = DateString( DayNumber( date ) - RECENT_DAYS );
+		recentDates.erase( recentDates.begin(), recentDates.lower_bound( oldest ) );
+	}
+}
+
+void RollupCube::process( const Changeset & changeset )
+{
+	if ( changeset.date != currentDate )
+		beginDate( changeset.date );
+
+	const char * country = CountryForPoint( (changeset.min_lon + changeset.max_lon) / 2, (changeset.min_lat + changeset.max_lat) / 2 );
+	int editor = strings.intern( changeset.application );
+	int countryId = strings.intern( country ? country : "" );
+	int locale = strings.intern( changeset.locale );
+
+	int64_t key = ((int64_t)editor << 42) | ((int64_t)countryId << 21) | locale;
+	auto it = current->cells.find( key );
+	if ( it == current->cells.end() ) {
+		Cell cell = { current->dateId, editor, countryId, locale, 0, 0, 0, 0 };
+		it = current->cells.insert( std::pair<int64_t,size_t>( key, cells.size() ) ).first;
+		cells.push_back( cell );
+	}
+	Cell & cell = cells[it->second];
+	cell.changesets		+= 1;
+	cell.edits			+= changeset.editCount;
+	if ( IsLargeArea( changeset ) )
+		cell.largeAreas	+= 1;
+	cell.lastChangeset	= std::max( cell.lastChangeset, changeset.ident );
+
+	auto users = current->users.find( editor );
+	if ( users == current->users.end() ) {
+		DailyUsers entry = { current->dateId, editor, 0 };
+		users = current->users.insert( std::pair<int,size_t>( editor, dailyUsers.size() ) ).first;
+		dailyUsers.push_back( entry );
+	}
+	if ( current->seenUsers.insert( ((int64_t)editor << 32) | (uint32_t)changeset.uid ).second )
+		dailyUsers[users->second].users += 1;
+}
+
+void RollupCube::finalize()
+{
+	if ( !dateOrder ) {
+		std::stable_sort( cells.begin(), cells.end(), [this]( const Cell & a, const Cell & b ) {
+			return strings.string( a.date ) < strings.string( b.date );
+		});
+		std::stable_sort( dailyUsers.begin(), dailyUsers.end(), [this]( const DailyUsers & a, const DailyUsers & b ) {
+			return strings.string( a.date ) < strings.string( b.date );
+		});
+		dateOrder = true;
+	}
+	currentDate.clear();
+	lastDate.clear();
+	recentDates.clear();
+	current = NULL;
+}
+
+// The first entry with a date at or after the given one
+template <class T> static typename std::vector<T>::const_iterator FirstOnOrAfter( const std::vector<T> & list,
+																				 const StringTable & strings,
+																				 const std::string & date )
+{
+	return std::lower_bound( list.begin(), list.end(), date, [&strings]( const T & entry, const std::string & date ) {
+		return strings.string( entry.date ) < date;
+	});
+}
+
+std::string RollupCube::removeLastDate()
+{
+	if ( cells.size() == 0 )
+		return "";
+	std::string last = strings.string( cells.back().date );
+	cells.erase( FirstOnOrAfter( cells, strings, last ), cells.end() );
+	dailyUsers.erase( FirstOnOrAfter( dailyUsers, strings, last ), dailyUsers.end() );
+	return last;
+}
+
+void RollupCube::setDateRange( const std::string & startDate, const std::string & endDate )
+{
+	this->startDate = startDate;
+	this->endDate = endDate;
+}
+
+void RollupCube::forEachCell( const std::function<void(const Cell & cell)> & visit ) const
+{
+	auto end = endDate.size() > 0 ? FirstOnOrAfter( cells, strings, endDate ) : cells.end();
+	for ( auto cell = FirstOnOrAfter( cells, strings, startDate ); cell < end; ++cell ) {
+		visit( *cell );
+	}
+}
+
+void RollupCube::forEachDailyUsers( const std::function<void(const DailyUsers & users)> & visit ) const
+{
+	auto end = endDate.size() > 0 ? FirstOnOrAfter( dailyUsers, strings, endDate ) : dailyUsers.end();
+	for ( auto users = FirstOnOrAfter( dailyUsers, strings, startDate ); users < end; ++users ) {
+		visit( *users );
+	}
+}
+
+// Fields are written one at a time so the file doesn't depend on the struct layout,
+// in the byte order of the host, which is little-endian everywhere we run.
+template <class T> static void Put( FILE * file, T value )
+{
+	fwrite( &value, sizeof value, 1, file );
+}
+
+template <class T> static bool Get( FILE * file, T & value )
+{
+	return fread( &value, sizeof value, 1, file ) == 1;
+}
+
+bool RollupCube::save( const std::string & path ) const
+{
+	FILE * file = fopen( path.c_str(), "wb" );
+	if ( file == NULL ) {
+		perror( path.c_str() );
+		return false;
+	}
+	setvbuf( file, NULL, _IOFBF, 1 << 20 );
+	fwrite( ROLLUP_MAGIC, 1, sizeof ROLLUP_MAGIC, file );
+	Put<uint32_t>( file, ROLLUP_VERSION );
+	Put<uint32_t>( file, (uint32_t)strings.size() );
+	for ( size_t i = 0; i < strings.size(); ++i ) {
+		const std::string & text = strings.string( (int)i );
+		Put<uint32_t>( file, (uint32_t)text.size() );
+		fwrite( text.data(), 1, text.size(), file );
+	}
+	Put<uint64_t>( file, cells.size() );
+	for ( const auto &cell: cells ) {
+		Put<int32_t>( file, cell.date );
+		Put<int32_t>( file, cell.editor );
+		Put<int32_t>( file, cell.country );
+		Put<int32_t>( file, cell.locale );
+		Put<int64_t>( file, cell.changesets );
+		Put<int64_t>( file, cell.edits );
+		Put<int64_t>( file, cell.largeAreas );
+		Put<int64_t>( file, cell.lastChangeset );
+	}
+	Put<uint64_t>( file, dailyUsers.size() );
+	for ( const auto &users: dailyUsers ) {
+		Put<int32_t>( file, users.date );
+		Put<int32_t>( file, users.editor );
+		Put<int64_t>( file, users.users );
+	}
+	bool ok = !ferror( file );
+	if ( fclose( file ) != 0 )
+		ok = false;
+	if ( !ok )
+		perror( path.c_str() );
+	return ok;
+}
+
+bool RollupCube::load( const std::string & path )
+{
+	FILE * file = fopen( path.c_str(), "rb" );
+	if ( file == NULL ) {
+		perror( path.c_str() );
+		return false;
+	}
+	setvbuf( file, NULL, _IOFBF, 1 << 20 );
+
+	auto fail = [&]( const char * problem ) {
+		fprintf( stderr, "%s %s\n", path.c_str(), problem );
+		strings = StringTable();
+		cells.clear();
+		dailyUsers.clear();
+		fclose( file );
+		return false;
+	};
+
+	strings = StringTable();
+	cells.clear();
+	dailyUsers.clear();
+
+	char magic[sizeof ROLLUP_MAGIC];
+	uint32_t version, stringCount;
+	if ( fread( magic, 1, sizeof magic, file ) != sizeof magic || memcmp( magic, ROLLUP_MAGIC, sizeof magic ) != 0 ||
+		!Get( file, version ) || version != ROLLUP_VERSION || !Get( file, stringCount ) ) {
+		return fail( "is not a rollup cube" );
+	}
+	std::string text;
+	for ( uint32_t i = 0; i < stringCount; ++i ) {
+		uint32_t len;
+		if ( !Get( file, len ) )
+			return fail( "is truncated" );
+		text.resize( len );
+		if ( len > 0 && fread( &text[0], 1, len, file ) != len )
+			return fail( "is truncated" );
+		if ( strings.intern( text ) != (int)i )
+			return fail( "is corrupt" );
+	}
+	uint64_t cellCount;
+	if ( !Get( file, cellCount ) )
+		return fail( "is truncated" );
+	for ( uint64_t i = 0; i < cellCount; ++i ) {
+		int32_t ids[4];
+		int64_t totals[4];
+		if ( fread( ids, sizeof ids[0], 4, file ) != 4 || fread( totals, sizeof totals[0], 4, file ) != 4 )
+			return fail( "is truncated" );
+		for ( int32_t id: ids ) {
+			if ( id < 0 || id >= (int32_t)stringCount )
+				return fail( "is corrupt" );
+		}
+		Cell cell = { ids[0], ids[1], ids[2], ids[3], (long)totals[0], (long)totals[1], (long)totals[2], (long)totals[3] };
+		cells.push_back( cell );
+	}
+	uint64_t usersCount;
+	if ( !Get( file, usersCount ) )
+		return fail( "is truncated" );
+	for ( uint64_t i = 0; i < usersCount; ++i ) {
+		int32_t date, editor;
+		int64_t users;
+		if ( !Get( file, date ) || !Get( file, editor ) || !Get( file, users ) )
+			return fail( "is truncated" );
+		if ( date < 0 || date >= (int32_t)stringCount || editor < 0 || editor >= (int32_t)stringCount )
+			return fail( "is corrupt" );
+		DailyUsers entry = { date, editor, (long)users };
+		dailyUsers.push_back( entry );
+	}
+	fclose( file );
+	return true;
+}
@@ -0,0 +1,108 @@
+//
+//  RollupCube.hpp
+//  ParseOsmChangesetFile
+//
+//  Created by Bryce Cogswell on 10/18/26.
+//  Copyright © 2026 Bryce Cogswell. All rights reserved.
+//
+
+#ifndef RollupCube_hpp
+#define RollupCube_hpp
+
+#include <stdint.h>
+#include <functional>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "ChangesetParser.hpp"
+#include "StringTable.hpp"
+
+// A reader that sums changesets and edits by date, editor, country and locale. Many reports,
+// such as Retention and EditsPerChangeset, only need these totals, so once the cube is built
+// they can be answered from it in milliseconds rather than by scanning every changeset.
+// The country is the one containing the center of the changeset's bounding box.
+//
+// Distinct users can't be summed across countries, so they are kept per date and editor.
+//
+// The cube is saved to a file and brought up to date by parsing only the changesets from the
+// last date it has on, since that date may have been incomplete. The file is little-endian:
+//		char[8]		"OSMROLUP"
+//		uint32		version, currently 1
+//		uint32		number of strings, then for each:
+//			uint32		length
+//			char[]		bytes, not terminated
+//		uint64		number of cells, then for each:
+//			int32		date, editor, country, locale, each the index of a string above
+//			int64		changesets, edits, large areas, last changeset id
+//		uint64		number of daily user counts, then for each:
+//			int32		date, editor, each the index of a string above
+//			int64		users
+class RollupCube: public ChangesetReader {
+public:
+	struct Cell {
+		int		date, editor, country, locale;	// ids in strings
+		long	changesets;
+		long	edits;
+		long	largeAreas;		// changesets that cover a large area (see IsLargeArea)
+		long	lastChangeset;	// the highest id
+	};
+	struct DailyUsers {
+		int		date, editor;
+		long	users;
+	};
+private:
+	StringTable						strings;
+	std::vector<Cell>				cells;			// in date order
+	std::vector<DailyUsers>			dailyUsers;		// in date order
+	std::string						startDate, endDate;	// the range passed to readers answered from the cube
+
+	// The cells and users of a date still being added. Changesets are mostly in date order,
+	// but one can arrive after a later date's, so the last RECENT_DAYS dates are kept.
+	struct DateCells {
+		int									dateId;
+		std::unordered_map<int64_t,size_t>	cells;		// (editor, country, locale) to an index in cells
+		std::unordered_map<int,size_t>		users;		// editor to an index in dailyUsers
+		std::unordered_set<int64_t>			seenUsers;	// (editor, uid) pairs counted
+	};
+	static const int RECENT_DAYS = 32;
+	std::map<std::string,DateCells>	recentDates;
+	std::string						currentDate, lastDate;	// the date of the last changeset, and the latest date
+	DateCells					*	current = NULL;
+	bool							dateOrder = true;
+
+	void beginDate( const std::string & date );
+public:
+	void initialize() {}
+	void process( const Changeset & changeset );
+	void finalize();
+
+	size_t size() const		{ return cells.size(); }
+
+	// Writes the cube to a file in the format above
+	bool save( const std::string & path ) const;
+	// Replaces the contents of the cube with a file written by save()
+	bool load( const std::string & path );
+
+	// Removes everything from the last date on, which may be incomplete, and returns that date,
+	// or an empty string if the cube is empty. Parse the input from that date to bring the cube up to date.
+	std::string removeLastDate();
+
+	// Readers answered from the cube see only dates with startDate <= date < endDate.
+	// An empty date means no limit.
+	void setDateRange( const std::string & startDate, const std::string & endDate );
+
+	// Wraps a reader that returns true from usesRollup() in one that passes it the cube when it is
+	// initialized. It can be run along with readers that scan the input, and finalizes in its place among them.
+	ChangesetReader * answer( ChangesetReader * reader ) const;
+
+	// Calls visit for each cell or daily user count in the date range, in date order
+	void forEachCell( const std::function<void(const Cell & cell)> & visit ) const;
+	void forEachDailyUsers( const std::function<void(const DailyUsers & users)> & visit ) const;
+
+	const std::string & string( int id ) const	{ return strings.string( id ); }
+};
+
+#endif /* RollupCube_hpp */
@@ -0,0 +1,114 @@
+//
+//  Sampling.cpp
+//  ParseOsmChangesetFile
+//
+//  Created by Bryce Cogswell on 10/18/26.
+//  Copyright © 2026 Bryce Cogswell. All rights reserved.
+//
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Sampling.hpp"
+
+// The normal quantile of a two-sided 95% interval
+static const double Z95 = 1.96;
+
+static bool ParseRate( const char * text, char ** end, double & rate )
+{
+	rate = strtod( text, end );
+	if ( *end == text )
+		return false;
+	if ( **end == '%' ) {
+		rate /= 100;
+		++*end;
+	}
+	return rate > 0 && rate <= 1;
+}
+
+bool ParseSampleSettings( const char * text, SampleSettings & settings )
+{
+	char * end;
+	if ( strncmp( text, "ids:", 4 ) == 0 ) {
+		settings.scheme = SAMPLE_IDS;
+		return ParseRate( text + 4, &end, settings.rate ) && *end == '\0';
+	}
+	if ( strncmp( text, "bytes:", 6 ) == 0 ) {
+		settings.scheme = SAMPLE_BYTES;
+		if ( !ParseRate( text + 6, &end, settings.rate ) )
+			return false;
+		if ( *end == ':' ) {
+			settings.runBytes = strtol( end + 1, &end, 10 ) * 1024;
+			if ( settings.runBytes <= 0 )
+				return false;
+		}
+		return *end == '\0';
+	}
+	return false;
+}
+
+// The splitmix64 finalizer, which spreads consecutive ids evenly
+double SampleHash( long value )
+{
+	uint64_t x = (uint64_t)value;
+	x ^= x >> 30;
+	x *= 0xbf58476d1ce4e5b9ULL;
+	x ^= x >> 27;
+	x *= 0x94d049bb133111ebULL;
+	x ^= x >> 31;
+	return (x >> 11) * (1.0 / (1ULL << 53));
+}
+
+std::string SampleEstimate::format() const
+{
+	char text[64];
+	snprintf( text, sizeof text, "%.0f ±%.0f", estimate, margin );
+	return text;
+}
+
+SampleEstimate ScaleCount( double count, double rate )
+{
+	SampleEstimate result;
+	result.estimate = count / rate;
+	if ( count > 0 ) {
+		// the count is binomial, so its variance is count * (1 - rate)
+		result.margin = Z95 * sqrt( count * (1 - rate) ) / rate;
+	} else {
+		// nothing was seen: the rule of three
+		result.margin = 3 / rate;
+	}
+	return result;
+}
+
+void StratifiedTotal::add( double count, double fraction )
+{
+	expanded.push_back( count / fraction );
+	read += fraction;
+	total += 1;
+}
+
+SampleEstimate StratifiedTotal::estimate() const
+{
+	double sum = 0.0;
+	for ( double value: expanded ) {
+		sum += value;
+	}
+	double f = fraction();
+	if ( expanded.size() < 2 )
+		return ScaleCount( sum * f, f );
+
+	// the successive difference estimator: for independent strata each squared
+	// difference averages twice the variance of a stratum
+	double squares = 0.0;
+	for ( size_t i = 1; i < expanded.size(); ++i ) {
+		double d = expanded[i] - expanded[i-1];
+		squares += d * d;
+	}
+	double m = (double)expanded.size();
+	double variance = (1 - f) * m / (2 * (m - 1)) * squares;
+	SampleEstimate result = { sum, Z95 * sqrt( variance ) };
+	return result;
+}
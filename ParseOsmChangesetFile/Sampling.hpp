@@ -0,0 +1,64 @@
+//
+//  Sampling.hpp
+//  ParseOsmChangesetFile
+//
+//  Created by Bryce Cogswell on 10/18/26.
+//  Copyright © 2026 Bryce Cogswell. All rights reserved.
+//
+
+#ifndef Sampling_hpp
+#define Sampling_hpp
+
+#include <string>
+#include <vector>
+
+// Approximate analyses that parse only a sample of the changesets. Both schemes choose the
+// same sample on every run, so a prototype reader gives repeatable answers.
+enum SampleScheme {
+	SAMPLE_NONE,
+	SAMPLE_IDS,		// a changeset is in the sample if a hash of its id is below the rate
+	SAMPLE_BYTES,	// the input is divided into equal strata, and one run of records is read from each
+};
+
+struct SampleSettings {
+	SampleScheme	scheme = SAMPLE_NONE;
+	double			rate = 1.0;				// the fraction of changesets, or of bytes, to parse
+	long			runBytes = 256*1024;	// SAMPLE_BYTES: the most to read of each stratum
+};
+
+// Parses "ids:<rate>" or "bytes:<rate>[:<run KB>]", where the rate is a fraction or a percentage like "1%"
+bool ParseSampleSettings( const char * text, SampleSettings & settings );
+
+// A hash of the value, uniformly distributed in [0,1)
+double SampleHash( long value );
+
+// Whether the changeset with the id is in a sample at the rate. A sample at a lower
+// rate is a subset of one at a higher rate.
+inline bool IdInSample( long ident, double rate )	{ return SampleHash( ident ) < rate; }
+
+// An estimate of a total from a sample, with a 95% confidence interval of estimate ± margin
+struct SampleEstimate {
+	double	estimate;
+	double	margin;
+	std::string format() const;		// "1234 ±56"
+};
+
+// Scales a count from a sample in which each changeset was chosen independently with the
+// probability rate. Readers use it for their counts, with their sampleRate. For a byte-range
+// sample the changesets in a run aren't independent, so the interval is somewhat too narrow.
+SampleEstimate ScaleCount( double count, double rate );
+
+// Estimates a total from one run in each stratum. Each stratum's count is divided by the fraction
+// of it that was read. With a single run per stratum there is no variance within a stratum to
+// measure, so the variance is estimated from the differences between neighboring strata.
+class StratifiedTotal {
+	std::vector<double>	expanded;	// each stratum's count divided by its fraction
+	double				read = 0, total = 0;
+public:
+	void add( double count, double fraction );
+	size_t size() const		{ return expanded.size(); }
+	double fraction() const	{ return total > 0 ? read / total : 1.0; }
+	SampleEstimate estimate() const;
+};
+
+#endif /* Sampling_hpp */
@@ -0,0 +1,232 @@
+//
+//  Server.cpp
+//  ParseOsmChangesetFile
+//
+//  Created by Bryce Cogswell on 10/18/26.
+//  Copyright © 2026 Bryce Cogswell. All rights reserved.
+//
+
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "Readers.hpp"
+#include "Server.hpp"
+
+static bool MakeAddress( const std::string & socketPath, struct sockaddr_un & addr )
+{
+	memset( &addr, 0, sizeof addr );
+	addr.sun_family = AF_UNIX;
+	if ( socketPath.size() >= sizeof addr.sun_path ) {
+		fprintf( stderr, "Socket path is too long: %s\n", socketPath.c_str() );
+		return false;
+	}
+	strcpy( addr.sun_path, socketPath.c_str() );
+	return true;
+}
+
+// Reads lines until a blank line or the client stops sending
+static std::vector<std::string> ReadRequest( int fd )
+{
+	std::string text;
+	char buffer[4096];
+	while ( text.find( "\n\n" ) == std::string::npos && text != "\n" && text.size() < 65536 ) {
+		ssize_t n = read( fd, buffer, sizeof buffer );
+		if ( n < 0 && errno == EINTR )
+			continue;
+		if ( n <= 0 )
+			break;
+		text.append( buffer, n );
+	}
+
+	std::vector<std::string> lines;
+	size_t pos = 0;
+	while ( pos < text.size() ) {
+		size_t eol = text.find( '\n', pos );
+		if ( eol == std::string::npos )
+			eol = text.size();
+		std::string line = text.substr( pos, eol - pos );
+		pos = eol + 1;
+		if ( line.size() > 0 && line.back() == '\r' )
+			line.pop_back();
+		if ( line.size() == 0 )
+			break;
+		lines.push_back( line );
+	}
+	return lines;
+}
+
+// Runs in a forked child, so readers can't disturb the server's copy of the data
+void AnalysisServer::handle( int client )
+{
+	std::vector<std::string> request = ReadRequest( client );
+
+	// reader output goes straight to the client
+	fflush( stdout );
+	dup2( client, STDOUT_FILENO );
+
+	answer( request );
+
+	// the child leaves with _exit(), which doesn't flush stdio, and errors are a response too
+	fflush( stdout );
+}
+
+void AnalysisServer::answer( const std::vector<std::string> & request )
+{
+	std::string readerNames;
+	ReaderParameters params;
+	ChangesetFilter filter;
+	for ( const auto &line: request ) {
+		size_t eq = line.find( '=' );
+		std::string key = line.substr( 0, eq );
+		std::string value = eq == std::string::npos ? "" : line.substr( eq + 1 );
+		if ( key == "readers" ) {
+			readerNames = value;
+		} else if ( key == "start" ) {
+			params.startDate = value;
+		} else if ( key == "end" ) {
+			params.endDate = value;
+		} else if ( key == "editor" ) {
+			params.editor = value;
+		} else if ( key == "country" ) {
+			params.country = value;
+		} else if ( key == "filter" ) {
+			std::string error;
+			if ( !filter.compile( value, error ) ) {
+				printf( "error: %s\n", error.c_str() );
+				return;
+			}
+			if ( filter.usesTags() ) {
+				printf( "error: the server doesn't keep the tags for tag:<key> or hashtags, so give that filter to --filter when starting it\n" );
+				return;
+			}
+		} else {
+			printf( "error: unknown query key '%s'\n", key.c_str() );
+			return;
+		}
+	}
+
+	// the store only has the dates the server loaded
+	if ( params.startDate.size() == 0 ) {
+		params.startDate = startDate;
+	} else if ( params.startDate < startDate ) {
+		printf( "error: start=%s is before the loaded changesets, which start at %s\n", params.startDate.c_str(), startDate.c_str() );
+		return;
+	}
+	if ( params.endDate.size() == 0 ) {
+		params.endDate = endDate;
+	} else if ( endDate.size() > 0 && params.endDate > endDate ) {
+		printf( "error: end=%s is after the loaded changesets, which end before %s\n", params.endDate.c_str(), endDate.c_str() );
+		return;
+	}
+
+	std::vector<ChangesetReader *> readers;
+	if ( readerNames.size() == 0 ) {
+		readers = getReaders( params );
+	} else {
+		std::string error;
+		if ( !newReaders( readerNames, params, readers, error ) ) {
+			printf( "error: %s\n", error.c_str() );
+			return;
+		}
+	}
+
+	store.replay( readers, params.startDate, params.endDate, filter );
+}
+
+bool AnalysisServer::run( const std::string & socketPath )
+{
+	struct sockaddr_un addr;
+	if ( !MakeAddress( socketPath, addr ) )
+		return false;
+
+	int listener = socket( AF_UNIX, SOCK_STREAM, 0 );
+	if ( listener < 0 ) {
+		perror( "socket" );
+		return false;
+	}
+	unlink( socketPath.c_str() );
+	if ( bind( listener, (struct sockaddr *)&addr, sizeof addr ) < 0 || listen( listener, 16 ) < 0 ) {
+		perror( socketPath.c_str() );
+		close( listener );
+		return false;
+	}
+
+	// children are reaped automatically, and a client hanging up shouldn't kill anyone
+	signal( SIGCHLD, SIG_IGN );
+	signal( SIGPIPE, SIG_IGN );
+
+	printf( "Serving %ld changesets on %s\n", (long)store.size(), socketPath.c_str() );
+	fflush( stdout );
+
+	for (;;) {
+		int client = accept( listener, NULL, NULL );
+		if ( client < 0 ) {
+			if ( errno == EINTR )
+				continue;
+			perror( "accept" );
+			break;
+		}
+		// Each query runs in its own process: it shares the loaded data copy-on-write,
+		// several queries can run at once, and reader state never leaks between them.
+		pid_t pid = fork();
+		if ( pid == 0 ) {
+			close( listener );
+			handle( client );
+			close( client );
+			_exit( 0 );
+		}
+		if ( pid < 0 ) {
+			perror( "fork" );
+		}
+		close( client );
+	}
+	close( listener );
+	return true;
+}
+
+bool SendQuery( const std::string & socketPath, const std::vector<std::string> & lines )
+{
+	struct sockaddr_un addr;
+	if ( !MakeAddress( socketPath, addr ) )
+		return false;
+
+	int fd = socket( AF_UNIX, SOCK_STREAM, 0 );
+	if ( fd < 0 ) {
+		perror( "socket" );
+		return false;
+	}
+	if ( connect( fd, (struct sockaddr *)&addr, sizeof addr ) < 0 ) {
+		perror( socketPath.c_str() );
+		close( fd );
+		return false;
+	}
+
+	std::string request;
+	for ( const auto &line: lines ) {
+		request += line + "\n";
+	}
+	request += "\n";
+	if ( write( fd, request.data(), request.size() ) != (ssize_t)request.size() ) {
+		perror( "write" );
+		close( fd );
+		return false;
+	}
+	shutdown( fd, SHUT_WR );
+
+	char buffer[65536];
+	for (;;) {
+		ssize_t n = read( fd, buffer, sizeof buffer );
+		if ( n < 0 && errno == EINTR )
+			continue;
+		if ( n <= 0 )
+			break;
+		fwrite( buffer, 1, n, stdout );
+	}
+	close( fd );
+	return true;
+}
@@ -0,0 +1,46 @@
+//
+//  Server.hpp
+//  ParseOsmChangesetFile
+//
+//  Created by Bryce Cogswell on 10/18/26.
+//  Copyright © 2026 Bryce Cogswell. All rights reserved.
+//
+
+#ifndef Server_hpp
+#define Server_hpp
+
+#include <string>
+#include <vector>
+
+#include "ChangesetStore.hpp"
+
+// Keeps parsed changesets in memory and answers queries over a Unix domain socket.
+//
+// A query is a list of key=value lines ending with a blank line:
+//		readers=Retention,EditStreaks	(default is the usual set of readers)
+//		start=2021-01-01				(optional)
+//		end=2022-01-01					(optional, exclusive)
+//		editor=Go Map!!					(optional, for the GoMap readers, as --editor)
+//		country=China					(optional, for GoMapInCountry)
+//		filter=uid = 1234 or changes > 100	(optional, see ChangesetFilter)
+// The response is the output of each reader's finalize. A query whose dates reach outside
+// the dates that were loaded gets an error rather than a partial answer; without start= or
+// end= it covers everything that was loaded.
+class AnalysisServer {
+	const ChangesetStore &	store;
+	std::string				startDate, endDate;	// the dates loaded into the store, empty if unbounded
+
+	void handle( int client );
+	void answer( const std::vector<std::string> & request );
+public:
+	AnalysisServer( const ChangesetStore & store, const std::string & startDate = "", const std::string & endDate = "" )
+		: store(store), startDate(startDate), endDate(endDate) {}
+
+	// Accepts connections until the process is killed. Returns false if the socket can't be created.
+	bool run( const std::string & socketPath );
+};
+
+// Sends a query to a running server and copies the response to stdout
+bool SendQuery( const std::string & socketPath, const std::vector<std::string> & lines );
+
+#endif /* Server_hpp */
@@ -0,0 +1,66 @@
+//
+//  ShardManifest.cpp
+//  ParseOsmChangesetFile
+//
+//  Created by Bryce Cogswell on 10/18/26.
+//  Copyright © 2026 Bryce Cogswell. All rights reserved.
+//
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sstream>
+
+#include "ShardManifest.hpp"
+
+// Makes a path in the manifest relative to the manifest's directory
+static std::string ResolvePath( const std::string & manifest, const std::string & path )
+{
+	if ( path.size() == 0 || path[0] == '/' )
+		return path;
+	size_t slash = manifest.rfind( '/' );
+	if ( slash == std::string::npos )
+		return path;
+	return manifest.substr( 0, slash + 1 ) + path;
+}
+
+bool ReadShardManifest( const std::string & path, std::vector<Shard> & shards, std::string & error )
+{
+	FILE * file = fopen( path.c_str(), "r" );
+	if ( file == NULL ) {
+		error = path + ": " + strerror( errno );
+		return false;
+	}
+	char buffer[4096];
+	int lineNumber = 0;
+	while ( fgets( buffer, sizeof buffer, file ) ) {
+		++lineNumber;
+		std::istringstream line( buffer );
+		std::string partial, input, begin, end, extra;
+		line >> partial >> input >> begin >> end >> extra;
+		if ( partial.size() == 0 || partial[0] == '#' )
+			continue;
+		Shard shard;
+		shard.partial = ResolvePath( path, partial );
+		shard.input = ResolvePath( path, input );
+		char * stop1 = NULL, * stop2 = NULL;
+		if ( begin.size() > 0 ) {
+			shard.begin = strtol( begin.c_str(), &stop1, 10 );
+			shard.end = strtol( end.c_str(), &stop2, 10 );
+		}
+		if ( input.size() == 0 || (begin.size() > 0 && (*stop1 || end.size() == 0 || *stop2)) || extra.size() > 0 ||
+			shard.begin < 0 || (shard.end >= 0 && shard.end < shard.begin) ) {
+			error = path + ":" + std::to_string( lineNumber ) + ": expected <partial> <input> [<begin> <end>]";
+			fclose( file );
+			return false;
+		}
+		shards.push_back( shard );
+	}
+	fclose( file );
+	if ( shards.size() == 0 ) {
+		error = path + ": no shards";
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,39 @@
+//
+//  ShardManifest.hpp
+//  ParseOsmChangesetFile
+//
+//  Created by Bryce Cogswell on 10/18/26.
+//  Copyright © 2026 Bryce Cogswell. All rights reserved.
+//
+
+#ifndef ShardManifest_hpp
+#define ShardManifest_hpp
+
+#include <string>
+#include <vector>
+
+// One piece of a sharded run: the input it reads and the partial state it writes
+struct Shard {
+	std::string		input;
+	long			begin	= 0;	// changesets starting in [begin,end) of the input
+	long			end		= -1;	// -1 for the end of the file
+	std::string		partial;		// where the worker saves its changesets (see ChangesetStore::save)
+};
+
+// A sharded run splits the analysis between worker processes, which can be on other
+// hosts that share a filesystem. Each worker parses one shard and saves what it parsed,
+// then a reduce step loads the partial states one at a time, in order, and runs the readers
+// over each, so it holds only one shard's changesets in memory at once.
+//
+// The manifest is a text file with one shard per line:
+//		<partial> <input> [<begin> <end>]
+// where begin and end are byte offsets. A changeset belongs to the range it starts in,
+// so ranges can be cut anywhere. Relative paths are relative to the manifest, and blank
+// lines and lines starting with # are ignored. List shards in date order, e.g.:
+//		# 2022 in two halves, then the replication files since
+//		part0.store  changesets-2022.osm  0           31000000000
+//		part1.store  changesets-2022.osm  31000000000 -1
+//		part2.store  changesets-2023.osm
+bool ReadShardManifest( const std::string & path, std::vector<Shard> & shards, std::string & error );
+
+#endif /* ShardManifest_hpp */
@@ -0,0 +1,89 @@
+//
+//  SlidingWindow.cpp
+//  ParseOsmChangesetFile
+//
+//  Created by Bryce Cogswell on 10/18/26.
+//  Copyright © 2026 Bryce Cogswell. All rights reserved.
+//
+
+#include <stdint.h>
+
+#include "SlidingWindow.hpp"
+
+SlidingWindow::SlidingWindow( int width, const DayCallback & emit, Arena * arena )
+	: width(width), currentDay(0),
+	  lastSeen( 0, std::hash<long>(), std::equal_to<long>(), ArenaAllocator<std::pair<const long,int>>( arena ) ),
+	  emit(emit), arena(arena)
+{
+}
+
+SlidingWindow::Dimension & SlidingWindow::dimension( int index )
+{
+	while ( index >= (int)dimensions.size() ) {
+		dimensions.push_back( Dimension( arena ) );
+		dimensions.back().panes.resize( width, 0 );
+		dimensions.back().users.resize( width, 0 );
+	}
+	return dimensions[index];
+}
+
+// Moves the end of the window forward to day, emitting each day it passes
+void SlidingWindow::advance( int day )
+{
+	if ( !started ) {
+		started = true;
+		currentDay = day;
+		return;
+	}
+	while ( currentDay < day ) {
+		emit( currentDay );
+		++currentDay;
+		// the pane of the day that just left the window becomes the new day's
+		int p = pane( currentDay );
+		for ( auto &dim: dimensions ) {
+			dim.total -= dim.panes[p];
+			dim.panes[p] = 0;
+			dim.userTotal -= dim.users[p];
+			dim.users[p] = 0;
+		}
+	}
+}
+
+void SlidingWindow::addValue( int day, int index, long value )
+{
+	advance( day );
+	if ( !inWindow( day ) )
+		return;
+	Dimension & dim = dimension( index );
+	dim.panes[pane( day )] += value;
+	dim.total += value;
+}
+
+void SlidingWindow::addUser( int day, int index, long uid )
+{
+	advance( day );
+	Dimension & dim = dimension( index );
+	long key = ((long)index << 32) | (uint32_t)uid;
+	auto it = lastSeen.insert( std::pair<long,int>( key, day ) );
+	if ( !it.second ) {
+		int & last = it.first->second;
+		if ( last >= day )
+			return;
+		// the user moves from the pane of the day they were last seen
+		if ( inWindow( last ) ) {
+			dim.users[pane( last )] -= 1;
+			dim.userTotal -= 1;
+		}
+		last = day;
+	}
+	if ( inWindow( day ) ) {
+		dim.users[pane( day )] += 1;
+		dim.userTotal += 1;
+	}
+}
+
+void SlidingWindow::finish()
+{
+	if ( started )
+		emit( currentDay );
+}
@@ -0,0 +1,75 @@
+//
+//  SlidingWindow.hpp
+//  ParseOsmChangesetFile
+//
+//  Created by Bryce Cogswell on 10/18/26.
+//  Copyright © 2026 Bryce Cogswell. All rights reserved.
+//
+
+#ifndef SlidingWindow_hpp
+#define SlidingWindow_hpp
+
+#include <functional>
+#include <vector>
+
+#include "Arena.hpp"
+
+// Rolling aggregates over the last width days for each of a set of dimensions, such as
+// 28-day active users per editor or the 7-day total of edits, kept up to date as changesets
+// arrive in date order so a single pass yields a point for every day.
+//
+// Each dimension keeps a ring of width panes, one per day, and the total of the panes in the
+// window. When the window moves forward a day the pane that leaves it is subtracted from the
+// total and reused, so adding a value costs O(1) and each day costs O(dimensions).
+//
+// Distinct users are counted exactly by remembering the last day each (dimension, user) was
+// seen, and keeping in each pane the number of users last seen on that day. When a user
+// returns they move from their old pane to the new one, and the users in the window are the
+// total of the panes. This is the same last-day map EditorDailyUsersReader uses.
+//
+// Changesets are in id order, which can put a date slightly before the previous one. A value
+// for an earlier day still in the window is added to its pane and to the totals, but points
+// already emitted for the days since then don't include it.
+class SlidingWindow {
+public:
+	// Called when a day is complete, for each day from the first to the last, with or without values.
+	// The totals of the window ending on that day are then available from the methods below.
+	typedef std::function<void(int day)> DayCallback;
+private:
+	struct Dimension {
+		ArenaVector<long>	panes;		// the values added on each day in the window, by day % width
+		ArenaVector<long>	users;		// the users last seen on each day in the window
+		long				total = 0;
+		long				userTotal = 0;
+		Dimension( Arena * arena ) : panes(arena), users(arena) {}
+	};
+	int						width;
+	int						currentDay;		// the last day of the window
+	bool					started = false;
+	std::vector<Dimension>	dimensions;
+	ArenaUnorderedMap<long,int>	lastSeen;		// (dimension, user) to the last day they were seen
+	DayCallback				emit;
+	Arena				*	arena;
+
+	Dimension & dimension( int index );
+	void advance( int day );
+	bool inWindow( int day ) const	{ return day > currentDay - width && day <= currentDay; }
+	int pane( int day ) const		{ return day % width; }
+public:
+	// Maps are allocated from the arena if one is given
+	SlidingWindow( int width, const DayCallback & emit, Arena * arena = NULL );
+
+	// day is a DayNumber(), and dimensions are small integers such as ApplicationId
+	void addValue( int day, int dimension, long value );
+	void addUser( int day, int dimension, long uid );
+
+	// Emits the last day. Call once after the last value.
+	void finish();
+
+	int dimensionCount() const					{ return (int)dimensions.size(); }
+	long total( int dimension ) const			{ return dimensions[dimension].total; }
+	long activeUsers( int dimension ) const		{ return dimensions[dimension].userTotal; }
+	int windowWidth() const						{ return width; }
+};
+
+#endif /* SlidingWindow_hpp */
@@ -0,0 +1,293 @@
+//
+//  SpatialIndex.cpp
+//  ParseOsmChangesetFile
+//
+//  Created by Bryce Cogswell on 10/18/26.
+//  Copyright © 2026 Bryce Cogswell. All rights reserved.
+//
+
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "Parallel.hpp"
+#include "SpatialIndex.hpp"
+
+static const char		INDEX_MAGIC[8]	= { 'O','S','M','S','P','I','D','X' };
+static const uint32_t	INDEX_VERSION	= 3;
+static const long		HEADER_SIZE		= 48;
+
+bool ParseGeoBox( const char * text, GeoBox & box )
+{
+	char extra;
+	int n = sscanf( text, "%lf,%lf,%lf,%lf%c", &box.minLon, &box.minLat, &box.maxLon, &box.maxLat, &extra );
+	if ( n == 2 ) {
+		box.maxLon = box.minLon;
+		box.maxLat = box.minLat;
+	} else if ( n != 4 ) {
+		return false;
+	}
+	return box.minLon <= box.maxLon && box.minLat <= box.maxLat;
+}
+
+// Floats that are certain to lie outside the double, so the box can only grow
+static float RoundDown( double value )
+{
+	float f = (float)value;
+	return f > value ? nextafterf( f, -INFINITY ) : f;
+}
+
+static float RoundUp( double value )
+{
+	float f = (float)value;
+	return f < value ? nextafterf( f, INFINITY ) : f;
+}
+
+// The distance along a Hilbert curve filling a 65536 x 65536 grid
+static uint32_t HilbertIndex( uint32_t x, uint32_t y )
+{
+	const uint32_t n = 1 << 16;
+	uint32_t d = 0;
+	for ( uint32_t s = n / 2; s > 0; s /= 2 ) {
+		uint32_t rx = (x & s) != 0;
+		uint32_t ry = (y & s) != 0;
+		d += s * s * ((3 * rx) ^ ry);
+		// rotate the quadrant so the curve inside it has the standard orientation
+		if ( ry == 0 ) {
+			if ( rx == 1 ) {
+				x = n - 1 - x;
+				y = n - 1 - y;
+			}
+			std::swap( x, y );
+		}
+	}
+	return d;
+}
+
+static uint32_t GridCoordinate( double value, double min, double max )
+{
+	double t = (value - min) / (max - min);
+	t = std::min( std::max( t, 0.0 ), 1.0 );
+	return (uint32_t)(t * 65535);
+}
+
+static bool Intersects( const SpatialIndex::Box & box, const GeoBox & region )
+{
+	return box.maxLon >= region.minLon && box.minLon <= region.maxLon &&
+		box.maxLat >= region.minLat && box.minLat <= region.maxLat;
+}
+
+void SpatialIndexBuilder::process( const Changeset & changeset )
+{
+	if ( changeset.offset < 0 )
+		return;		// not from a file, so there's nothing to point to
+	if ( !changeset.hasBox )
+		return;		// no edits, so it isn't anywhere and no region includes it
+	Entry entry;
+	entry.box.minLon = RoundDown( changeset.min_lon );
+	entry.box.minLat = RoundDown( changeset.min_lat );
+	entry.box.maxLon = RoundUp( changeset.max_lon );
+	entry.box.maxLat = RoundUp( changeset.max_lat );
+	entry.hilbert = HilbertIndex( GridCoordinate( (changeset.min_lon + changeset.max_lon) / 2, -180, 180 ),
+								  GridCoordinate( (changeset.min_lat + changeset.max_lat) / 2, -90, 90 ) );
+	entry.record.ident	= changeset.ident;
+	entry.record.offset	= changeset.offset;
+	entry.record.length	= changeset.length;
+	entries.push_back( entry );
+}
+
+template <class T> static void Put( FILE * file, T value )
+{
+	fwrite( &value, sizeof value, 1, file );
+}
+
+bool SpatialIndexBuilder::save( const std::string & path, long inputSize, int64_t inputTime )
+{
+	ParallelSort( entries.begin(), entries.end(), []( const Entry & a, const Entry & b ) {
+		return a.hilbert != b.hilbert ? a.hilbert < b.hilbert : a.record.offset < b.record.offset;
+	});
+
+	// the leaves, then each level of nodes above them
+	std::vector<SpatialIndex::Box> boxes;
+	boxes.reserve( entries.size() + entries.size() / (SpatialIndex::NODE_SIZE - 1) + 1 );
+	for ( const auto &entry: entries ) {
+		boxes.push_back( entry.box );
+	}
+	std::vector<uint64_t> levelEnds( 1, boxes.size() );
+	size_t levelStart = 0;
+	while ( boxes.size() - levelStart > 1 ) {
+		size_t levelEnd = boxes.size();
+		for ( size_t first = levelStart; first < levelEnd; first += SpatialIndex::NODE_SIZE ) {
+			size_t last = std::min( first + SpatialIndex::NODE_SIZE, levelEnd );
+			SpatialIndex::Box node = boxes[first];
+			for ( size_t i = first + 1; i < last; ++i ) {
+				node.minLon = std::min( node.minLon, boxes[i].minLon );
+				node.minLat = std::min( node.minLat, boxes[i].minLat );
+				node.maxLon = std::max( node.maxLon, boxes[i].maxLon );
+				node.maxLat = std::max( node.maxLat, boxes[i].maxLat );
+			}
+			boxes.push_back( node );
+		}
+		levelStart = levelEnd;
+		levelEnds.push_back( boxes.size() );
+	}
+
+	FILE * file = fopen( path.c_str(), "wb" );
+	if ( file == NULL ) {
+		perror( path.c_str() );
+		return false;
+	}
+	setvbuf( file, NULL, _IOFBF, 1 << 20 );
+	fwrite( INDEX_MAGIC, 1, sizeof INDEX_MAGIC, file );
+	Put<uint32_t>( file, INDEX_VERSION );
+	Put<uint32_t>( file, SpatialIndex::NODE_SIZE );
+	Put<uint64_t>( file, inputSize );
+	Put<int64_t>( file, inputTime );
+	Put<uint64_t>( file, entries.size() );
+	Put<uint64_t>( file, levelEnds.size() );
+	for ( auto end: levelEnds ) {
+		Put<uint64_t>( file, end );
+	}
+	for ( const auto &box: boxes ) {
+		Put<float>( file, box.minLon );
+		Put<float>( file, box.minLat );
+		Put<float>( file, box.maxLon );
+		Put<float>( file, box.maxLat );
+	}
+	for ( const auto &entry: entries ) {
+		Put<int64_t>( file, entry.record.ident );
+		Put<int64_t>( file, entry.record.offset );
+		Put<int64_t>( file, entry.record.length );
+	}
+	bool ok = !ferror( file );
+	if ( fclose( file ) != 0 )
+		ok = false;
+	if ( !ok )
+		perror( path.c_str() );
+	return ok;
+}
+
+bool SpatialIndex::open( const std::string & path )
+{
+	close();
+	int fd = ::open( path.c_str(), O_RDONLY );
+	if ( fd < 0 ) {
+		perror( path.c_str() );
+		return false;
+	}
+	struct stat statbuf;
+	if ( fstat( fd, &statbuf ) != 0 ) {
+		perror( path.c_str() );
+		::close( fd );
+		return false;
+	}
+	mapSize = statbuf.st_size;
+	if ( mapSize >= HEADER_SIZE ) {
+		void * mem = mmap( NULL, mapSize, PROT_READ, MAP_SHARED, fd, 0 );
+		if ( mem == MAP_FAILED ) {
+			perror( path.c_str() );
+			::close( fd );
+			mapSize = 0;
+			return false;
+		}
+		map = (const char *)mem;
+	}
+	::close( fd );
+
+	auto fail = [&]( const char * problem ) {
+		fprintf( stderr, "%s %s\n", path.c_str(), problem );
+		close();
+		return false;
+	};
+	if ( map == NULL || memcmp( map, INDEX_MAGIC, sizeof INDEX_MAGIC ) != 0 )
+		return fail( "is not a spatial index" );
+	uint32_t version, nodeSize;
+	uint64_t fileSize, levelCount;
+	memcpy( &version, map + 8, 4 );
+	memcpy( &nodeSize, map + 12, 4 );
+	memcpy( &fileSize, map + 16, 8 );
+	memcpy( &inputTime, map + 24, 8 );
+	memcpy( &count, map + 32, 8 );
+	memcpy( &levelCount, map + 40, 8 );
+	if ( version != INDEX_VERSION || nodeSize != NODE_SIZE || levelCount == 0 || levelCount > 64 ||
+		count > (uint64_t)mapSize )
+		return fail( "is not a spatial index" );
+	inputSize = (long)fileSize;
+
+	// every level must be the size the one below it implies, ending in a single root
+	levelEnds.resize( levelCount );
+	memcpy( &levelEnds[0], map + HEADER_SIZE, levelCount * sizeof levelEnds[0] );
+	uint64_t levelStart = 0, levelSize = count;
+	for ( uint64_t i = 0; i < levelCount; ++i ) {
+		if ( levelEnds[i] != levelStart + levelSize )
+			return fail( "is corrupt" );
+		levelStart = levelEnds[i];
+		levelSize = (levelSize + NODE_SIZE - 1) / NODE_SIZE;
+	}
+	if ( count > 1 && levelEnds.back() - (levelCount > 1 ? levelEnds[levelCount-2] : 0) != 1 )
+		return fail( "is corrupt" );
+	uint64_t boxesOffset = HEADER_SIZE + levelCount * sizeof(uint64_t);
+	uint64_t recordsOffset = boxesOffset + levelEnds.back() * sizeof(Box);
+	if ( recordsOffset + count * sizeof(Record) != (uint64_t)mapSize )
+		return fail( "is truncated" );
+	boxes = (const Box *)(map + boxesOffset);
+	records = (const Record *)(map + recordsOffset);
+	return true;
+}
+
+void SpatialIndex::close()
+{
+	if ( map ) {
+		munmap( (void *)map, mapSize );
+		map = NULL;
+	}
+	mapSize = 0;
+	count = 0;
+	levelEnds.clear();
+	boxes = NULL;
+	records = NULL;
+}
+
+void SpatialIndex::search( const GeoBox & region, std::vector<Record> & results ) const
+{
+	if ( count == 0 )
+		return;
+	// nodes still to visit, with their levels
+	std::vector<std::pair<uint64_t,size_t>> stack;
+	size_t root = levelEnds.size() - 1;
+	if ( Intersects( boxes[levelEnds[root] - 1], region ) )
+		stack.push_back( std::make_pair( levelEnds[root] - 1, root ) );
+	while ( !stack.empty() ) {
+		uint64_t node = stack.back().first;
+		size_t level = stack.back().second;
+		stack.pop_back();
+		if ( level == 0 ) {
+			results.push_back( records[node] );
+			continue;
+		}
+		uint64_t levelStart = level >= 2 ? levelEnds[level - 2] : 0;
+		uint64_t first = levelStart + (node - levelEnds[level - 1]) * NODE_SIZE;
+		uint64_t last = std::min( first + NODE_SIZE, levelEnds[level - 1] );
+		for ( uint64_t child = first; child < last; ++child ) {
+			if ( Intersects( boxes[child], region ) )
+				stack.push_back( std::make_pair( child, level - 1 ) );
+		}
+	}
+}
+
+std::vector<std::pair<long,long>> RecordLocations( const std::vector<SpatialIndex::Record> & records )
+{
+	std::vector<std::pair<long,long>> locations;
+	locations.reserve( records.size() );
+	for ( const auto &record: records ) {
+		locations.push_back( std::make_pair( (long)record.offset, (long)record.length ) );
+	}
+	std::sort( locations.begin(), locations.end() );
+	locations.erase( std::unique( locations.begin(), locations.end() ), locations.end() );
+	return locations;
+}
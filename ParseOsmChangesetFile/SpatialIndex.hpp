@@ -0,0 +1,116 @@
+//
+//  SpatialIndex.hpp
+//  ParseOsmChangesetFile
+//
+//  Created by Bryce Cogswell on 10/18/26.
+//  Copyright © 2026 Bryce Cogswell. All rights reserved.
+//
+
+#ifndef SpatialIndex_hpp
+#define SpatialIndex_hpp
+
+#include <stdint.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "ChangesetParser.hpp"
+
+// A region in degrees. Changesets match it if their bounding box intersects it, so a
+// point is a region with min equal to max.
+struct GeoBox {
+	double	minLon, minLat, maxLon, maxLat;
+
+	bool intersects( const Changeset & changeset ) const
+	{
+		return changeset.max_lon >= minLon && changeset.min_lon <= maxLon &&
+			changeset.max_lat >= minLat && changeset.min_lat <= maxLat;
+	}
+};
+
+// Parses "minlon,minlat,maxlon,maxlat" or "lon,lat"
+bool ParseGeoBox( const char * text, GeoBox & box );
+
+// A packed R-tree over the bounding boxes of the changesets in a file, which says which
+// changesets touch a region and where their records are, so readers that only care about
+// that region can read just those records instead of the whole file.
+//
+// Changesets without a bounding box aren't anywhere on the map, so they aren't indexed.
+// Changesets are sorted by the Hilbert curve position of their centers, so neighbors on
+// the map are neighbors in the tree, and grouped NODE_SIZE at a time. Each level above
+// holds the bounding boxes of the groups below it, up to a single root. Boxes are
+// floats rounded outward, so a search can return changesets that only come within
+// a float's precision of the region, and callers test the exact box before using them.
+//
+// The file is little-endian and mapped into memory rather than read:
+//		char[8]		"OSMSPIDX"
+//		uint32		version, currently 3
+//		uint32		node size
+//		uint64		size of the changeset file it indexes, to notice when that changes
+//		int64		modification time of the changeset file in nanoseconds, likewise
+//		uint64		number of changesets
+//		uint64		number of levels, then for each level, leaves first:
+//			uint64		index of the end of the level in the boxes
+//		float32[4]	min lon, min lat, max lon, max lat of each box, leaves first
+//		int64[3]	id, offset and length of each changeset's record, in leaf order
+class SpatialIndex {
+public:
+	static const uint32_t NODE_SIZE = 16;
+
+	struct Record {
+		int64_t	ident;
+		int64_t	offset;
+		int64_t	length;
+	};
+	struct Box {
+		float	minLon, minLat, maxLon, maxLat;
+	};
+private:
+	const char		*	map = NULL;
+	long				mapSize = 0;
+	long				inputSize = 0;
+	int64_t				inputTime = 0;
+	uint64_t			count = 0;
+	std::vector<uint64_t>	levelEnds;
+	const Box		*	boxes = NULL;
+	const Record	*	records = NULL;
+public:
+	SpatialIndex() {}
+	~SpatialIndex()		{ close(); }
+
+	// Maps a file written by SpatialIndexBuilder
+	bool open( const std::string & path );
+	void close();
+
+	size_t size() const				{ return count; }
+	long indexedFileSize() const	{ return inputSize; }
+	int64_t indexedFileTime() const	{ return inputTime; }
+
+	// Appends the records of the changesets whose boxes may intersect the region, in tree order
+	void search( const GeoBox & region, std::vector<Record> & results ) const;
+};
+
+// A reader that collects the bounding box and record location of every changeset and writes them as a SpatialIndex
+class SpatialIndexBuilder: public ChangesetReader {
+	struct Entry {
+		uint32_t				hilbert;
+		SpatialIndex::Box		box;
+		SpatialIndex::Record	record;
+	};
+	ArenaVector<Entry>	entries = ArenaVector<Entry>( &arena );
+public:
+	void initialize() {}
+	void process( const Changeset & changeset );
+	void finalize() {}
+
+	size_t size() const		{ return entries.size(); }
+
+	// Builds the tree and writes it. inputSize and inputTime are the size and modification
+	// time of the changeset file.
+	bool save( const std::string & path, long inputSize, int64_t inputTime );
+};
+
+// Offsets and lengths of the records, in file order and without duplicates, for ChangesetParser::parseRecordsAt()
+std::vector<std::pair<long,long>> RecordLocations( const std::vector<SpatialIndex::Record> & records );
+
+#endif /* SpatialIndex_hpp */
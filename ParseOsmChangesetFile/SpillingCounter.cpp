@@ -0,0 +1,251 @@
+//
+//  SpillingCounter.cpp
+//  ParseOsmChangesetFile
+//
+//  Created by Bryce Cogswell on 10/18/26.
+//  Copyright © 2026 Bryce Cogswell. All rights reserved.
+//
+
+#include <algorithm>
+#include <queue>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "SpillingCounter.hpp"
+
+size_t SpillingCounter::defaultBudget = 1024L << 20;
+
+// Runs are merged together when there are this many
+static const size_t MAX_RUNS = 64;
+
+// Creates an anonymous temporary file for a run
+static FILE * CreateRunFile()
+{
+	const char * dir = getenv( "TMPDIR" );
+	std::string path = std::string( dir && *dir ? dir : "/tmp" ) + "/ParseOsmChangesetFile.XXXXXX";
+	int fd = mkstemp( &path[0] );
+	if ( fd < 0 ) {
+		perror( path.c_str() );
+		return NULL;
+	}
+	unlink( path.c_str() );
+	FILE * file = fdopen( fd, "w+b" );
+	if ( file == NULL ) {
+		perror( path.c_str() );
+		close( fd );
+	}
+	return file;
+}
+
+template <class String> static void WriteEntry( FILE * file, const String & key, long value )
+{
+	uint32_t len = (uint32_t)key.size();
+	fwrite( &len, sizeof len, 1, file );
+	fwrite( key.data(), 1, len, file );
+	fwrite( &value, sizeof value, 1, file );
+}
+
+// Flushes a run and rewinds it so it can be read back
+static bool FinishRun( FILE * file )
+{
+	if ( fflush( file ) != 0 || ferror( file ) ) {
+		perror( "spill" );
+		fclose( file );
+		return false;
+	}
+	rewind( file );
+	return true;
+}
+
+// Reads the entries of a run back in order
+struct RunReader {
+	FILE *			file;
+	const std::vector<std::pair<std::string,long>> * memory;	// used instead of file if not NULL
+	size_t			position;
+	std::string		key;
+	long			value;
+
+	bool next()
+	{
+		if ( memory ) {
+			if ( position == memory->size() )
+				return false;
+			key = (*memory)[position].first;
+			value = (*memory)[position].second;
+			++position;
+			return true;
+		}
+		uint32_t len;
+		if ( fread( &len, sizeof len, 1, file ) != 1 )
+			return false;
+		key.resize( len );
+		if ( len > 0 && fread( &key[0], 1, len, file ) != len )
+			return false;
+		return fread( &value, sizeof value, 1, file ) == 1;
+	}
+};
+
+SpillingCounter::SpillingCounter( Arena * arena, size_t budget )
+	: counts(0, KeyHash(), std::equal_to<Key>(), arena), probe(arena), budget(budget), memoryUsed(0)
+{
+}
+
+SpillingCounter::~SpillingCounter()
+{
+	for ( FILE * run: runs ) {
+		fclose( run );
+	}
+}
+
+void SpillingCounter::spill()
+{
+	FILE * file = CreateRunFile();
+	if ( file == NULL ) {
+		// keep going in memory rather than lose anything
+		budget = (size_t)-1;
+		return;
+	}
+	setvbuf( file, NULL, _IOFBF, 1 << 20 );
+
+	std::vector<const CountMap::value_type *> entries;
+	entries.reserve( counts.size() );
+	for ( const auto &entry: counts ) {
+		entries.push_back( &entry );
+	}
+	std::sort( entries.begin(), entries.end(), []( const CountMap::value_type * a, const CountMap::value_type * b ) {
+		return a->first.text < b->first.text;
+	});
+	for ( const auto entry: entries ) {
+		WriteEntry( file, entry->first.text, entry->second );
+	}
+	if ( !FinishRun( file ) ) {
+		budget = (size_t)-1;
+		return;
+	}
+	runs.push_back( file );
+
+	counts.clear();
+	memoryUsed = 0;
+
+	// merge the runs into one, so we don't run out of file descriptors
+	if ( runs.size() >= MAX_RUNS )
+		compact();
+}
+
+// Merges the runs and anything in memory into a single run
+void SpillingCounter::compact()
+{
+	FILE * merged = CreateRunFile();
+	if ( merged == NULL )
+		return;
+	setvbuf( merged, NULL, _IOFBF, 1 << 20 );
+	merge( [merged]( const std::string & key, long total ) {
+		WriteEntry( merged, key, total );
+	});
+	if ( FinishRun( merged ) ) {
+		runs.push_back( merged );
+	} else {
+		// the data is gone, so there is no way to give an exact answer
+		fprintf( stderr, "Unable to merge temporary files\n" );
+		exit( 1 );
+	}
+}
+
+// Moves the entries in memory to a sorted list, and empties the table
+void SpillingCounter::takeSorted( std::vector<std::pair<std::string,long>> & entries )
+{
+	entries.reserve( counts.size() );
+	for ( const auto &entry: counts ) {
+		entries.push_back( std::pair<std::string,long>( std::string( entry.first.text.data(), entry.first.text.size() ), entry.second ) );
+	}
+	counts.clear();
+	memoryUsed = 0;
+	std::sort( entries.begin(), entries.end() );
+}
+
+void SpillingCounter::forEach( const std::function<void(const std::string & key, long total)> & visit )
+{
+	if ( runs.size() == 0 ) {
+		// everything fit in memory
+		std::vector<std::pair<std::string,long>> entries;
+		takeSorted( entries );
+		for ( const auto &entry: entries ) {
+			visit( entry.first, entry.second );
+		}
+		return;
+	}
+
+	if ( counts.size() > 0 )
+		spill();
+	merge( visit );
+}
+
+// Merges sorted runs in files and in memory, adding together the partial sums for each key.
+// Closes the files.
+static void MergeSorted( const std::vector<FILE *> & files, const std::vector<std::vector<std::pair<std::string,long>>> & memory,
+						const std::function<void(const std::string & key, long total)> & visit )
+{
+	std::vector<RunReader> readers( files.size() + memory.size() );
+	auto greater = [&readers]( int a, int b ) { return readers[a].key > readers[b].key; };
+	std::priority_queue<int, std::vector<int>, decltype(greater)> queue( greater );
+	for ( size_t i = 0; i < readers.size(); ++i ) {
+		readers[i].file = i < files.size() ? files[i] : NULL;
+		readers[i].memory = i < files.size() ? NULL : &memory[i - files.size()];
+		readers[i].position = 0;
+		if ( readers[i].next() )
+			queue.push( (int)i );
+	}
+	std::string key;
+	long total = 0;
+	bool haveKey = false;
+	while ( !queue.empty() ) {
+		int i = queue.top();
+		queue.pop();
+		if ( haveKey && readers[i].key != key ) {
+			visit( key, total );
+			haveKey = false;
+		}
+		if ( !haveKey ) {
+			key = readers[i].key;
+			total = 0;
+			haveKey = true;
+		}
+		total += readers[i].value;
+		if ( readers[i].next() )
+			queue.push( i );
+	}
+	if ( haveKey )
+		visit( key, total );
+
+	for ( FILE * file: files ) {
+		fclose( file );
+	}
+}
+
+// Merges the runs, along with anything left in memory if the last spill failed. Closes the runs.
+void SpillingCounter::merge( const std::function<void(const std::string & key, long total)> & visit )
+{
+	std::vector<std::vector<std::pair<std::string,long>>> remaining( 1 );
+	takeSorted( remaining[0] );
+	MergeSorted( runs, remaining, visit );
+	runs.clear();
+}
+
+// Each counter's runs are first merged into one, so there is a file per counter rather than
+// up to MAX_RUNS, and counters that stayed within their budget are merged from memory.
+void SpillingCounter::forEach( const std::vector<SpillingCounter *> & counters,
+							  const std::function<void(const std::string & key, long total)> & visit )
+{
+	std::vector<FILE *> files;
+	std::vector<std::vector<std::pair<std::string,long>>> memory( counters.size() );
+	for ( size_t i = 0; i < counters.size(); ++i ) {
+		SpillingCounter * counter = counters[i];
+		if ( counter->runs.size() > 0 )
+			counter->compact();
+		files.insert( files.end(), counter->runs.begin(), counter->runs.end() );
+		counter->runs.clear();
+		counter->takeSorted( memory[i] );
+	}
+	MergeSorted( files, memory, visit );
+}
@@ -0,0 +1,103 @@
+//
+//  SpillingCounter.hpp
+//  ParseOsmChangesetFile
+//
+//  Created by Bryce Cogswell on 10/18/26.
+//  Copyright © 2026 Bryce Cogswell. All rights reserved.
+//
+
+#ifndef SpillingCounter_hpp
+#define SpillingCounter_hpp
+
+#include <stdint.h>
+#include <stdio.h>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Arena.hpp"
+
+// Sums a value for each key, like a std::map<std::string,long>, but within a memory budget.
+//
+// When the table grows past the budget its entries are sorted and written to a temporary
+// file as a run of (key, partial sum) pairs, and the table starts again empty. At the end
+// the runs are merged, so the totals are exact no matter how many distinct keys there are.
+// If too many runs accumulate they are merged into one.
+// Temporary files go in $TMPDIR, or /tmp, and are deleted as soon as they are created.
+// The table and its keys are allocated from the arena if one is given.
+class SpillingCounter {
+private:
+	// keys carry their hash, so callers can pass one that was already computed
+	struct Key {
+		ArenaString		text;
+		size_t			hash;
+		Key( Arena * arena ) : text(arena), hash(0) {}
+		bool operator == ( const Key & other ) const	{ return hash == other.hash && text == other.text; }
+	};
+	struct KeyHash {
+		size_t operator()( const Key & key ) const		{ return key.hash; }
+	};
+	typedef std::unordered_map<Key, long, KeyHash, std::equal_to<Key>, ArenaAllocator<std::pair<const Key,long>>> CountMap;
+	CountMap								counts;
+	Key										probe;		// the key being looked up, reused to avoid allocating
+	size_t									budget;
+	size_t									memoryUsed;
+	std::vector<FILE *>						runs;
+
+	void takeSorted( std::vector<std::pair<std::string,long>> & entries );
+	void spill();
+	void compact();
+	void merge( const std::function<void(const std::string & key, long total)> & visit );
+public:
+	// The budget used by counters that don't specify one. Set from the command line.
+	static size_t defaultBudget;
+
+	SpillingCounter( Arena * arena = NULL, size_t budget = defaultBudget );
+	~SpillingCounter();
+
+	// FNV-1a, which is what add() uses unless it is given a hash
+	static size_t hash( const std::string & key )
+	{
+		uint64_t hash = 14695981039346656037ULL;
+		for ( unsigned char c: key ) {
+			hash = (hash ^ c) * 1099511628211ULL;
+		}
+		return (size_t)hash;
+	}
+
+	void add( const std::string & key, long value = 1 )
+	{
+		add( key, hash( key ), value );
+	}
+
+	// The same, with a hash of the key computed by the caller, such as a derived value (see
+	// DerivedValues.hpp). It needn't be the result of hash(), but must be the same for equal keys.
+	void add( const std::string & key, size_t keyHash, long value )
+	{
+		probe.text.assign( key.data(), key.size() );
+		probe.hash = keyHash;
+		auto it = counts.find( probe );
+		if ( it != counts.end() ) {
+			it->second += value;
+			return;
+		}
+		counts.insert( CountMap::value_type( probe, value ) );
+		// an estimate of the key, the node and its share of the bucket array
+		memoryUsed += key.capacity() + 64;
+		if ( memoryUsed > budget )
+			spill();
+	}
+
+	// Calls visit for each key, in sorted order, with its total. Empties the counter.
+	void forEach( const std::function<void(const std::string & key, long total)> & visit );
+
+	// The same for the keys of several counters together, adding the totals of keys
+	// that are in more than one. Empties the counters.
+	static void forEach( const std::vector<SpillingCounter *> & counters,
+						const std::function<void(const std::string & key, long total)> & visit );
+
+	size_t runCount() const		{ return runs.size(); }
+};
+
+#endif /* SpillingCounter_hpp */
@@ -0,0 +1,26 @@
+//
+//  StringTable.cpp
+//  ParseOsmChangesetFile
+//
+//  Created by Bryce Cogswell on 10/18/26.
+//  Copyright © 2026 Bryce Cogswell. All rights reserved.
+//
+
+#include "StringTable.hpp"
+
+int StringTable::intern( const std::string & s )
+{
+	auto it = ids.find( s );
+	if ( it != ids.end() )
+		return it->second;
+	int id = (int)strings.size();
+	strings.push_back( s );
+	ids.insert( std::pair<std::string,int>( s, id ) );
+	return id;
+}
+
+int StringTable::find( const std::string & s ) const
+{
+	auto it = ids.find( s );
+	return it != ids.end() ? it->second : -1;
+}
@@ -0,0 +1,27 @@
+//
+//  StringTable.hpp
+//  ParseOsmChangesetFile
+//
+//  Created by Bryce Cogswell on 10/18/26.
+//  Copyright © 2026 Bryce Cogswell. All rights reserved.
+//
+
+#ifndef StringTable_hpp
+#define StringTable_hpp
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Assigns a small integer to each distinct string
+class StringTable {
+	std::unordered_map<std::string,int>	ids;
+	std::vector<std::string>			strings;
+public:
+	int intern( const std::string & s );
+	int find( const std::string & s ) const;		// -1 if not present
+	const std::string & string( int id ) const	{ return strings[id]; }
+	size_t size() const							{ return strings.size(); }
+};
+
+#endif /* StringTable_hpp */
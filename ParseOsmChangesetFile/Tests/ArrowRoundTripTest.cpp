@@ -0,0 +1,423 @@
+//
+//  ArrowRoundTripTest.cpp
+//  ParseOsmChangesetFile
+//
+//  Created by Bryce Cogswell on 10/18/26.
+//  Copyright © 2026 Bryce Cogswell. All rights reserved.
+//
+//  Exports changesets with ArrowExporter and reads the file back the way an Arrow reader
+//  would: the magic, the footer and its schema, and each dictionary and record batch
+//  message in the stream, then checks the rows and dictionary values against the input.
+//  With pyarrow installed, pass a path to keep the file so it can be checked there too:
+//    python3 -c "import pyarrow.feather as f; print(f.read_table('<path>'))"
+//
+//  Build from the ParseOsmChangesetFile directory with all the sources except main.cpp:
+//    c++ -std=gnu++17 -I. Tests/ArrowRoundTripTest.cpp $(ls *.cpp | grep -v main.cpp) -lz -lpthread -o ArrowRoundTripTest
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "ArrowExport.hpp"
+#include "GroupBy.hpp"
+
+static int s_Failures = 0;
+
+static void Check( bool ok, const char * what )
+{
+	if ( !ok ) {
+		fprintf( stderr, "FAILED: %s\n", what );
+		++s_Failures;
+	}
+}
+
+// The columns ArrowExporter writes, in order
+static const char * s_ColumnNames[] = {
+	"id", "created_at", "uid", "user", "application", "locale", "comment",
+	"num_changes", "min_lat", "max_lat", "min_lon", "max_lon"
+};
+static const int COLUMN_COUNT = sizeof s_ColumnNames / sizeof s_ColumnNames[0];
+static const int STRING_COLUMNS[] = { 3, 4, 5, 6 };
+static const uint8_t TYPE_UTF8 = 5;
+static const uint8_t HEADER_SCHEMA = 1, HEADER_DICTIONARY_BATCH = 2, HEADER_RECORD_BATCH = 3;
+
+// Just enough of a flatbuffer reader for the Arrow metadata. Positions are offsets in the
+// file, and anything outside it fails the test rather than reading past the end.
+class FlatReader {
+	const std::string &	data;
+public:
+	bool	bad = false;
+
+	FlatReader( const std::string & data ) : data(data) {}
+
+	size_t size() const		{ return data.size(); }
+
+	template <class T> T read( size_t pos )
+	{
+		T value = T();
+		if ( pos + sizeof value > data.size() ) {
+			bad = true;
+			return value;
+		}
+		memcpy( &value, &data[pos], sizeof value );
+		return value;
+	}
+
+	// The position of the table a flatbuffer starting at pos has as its root
+	size_t root( size_t pos )		{ return pos + read<uint32_t>( pos ); }
+
+	// The position of a field in a table, or 0 if it isn't present
+	size_t field( size_t table, int id )
+	{
+		size_t vtable = table - read<int32_t>( table );
+		uint16_t vtableSize = read<uint16_t>( vtable );
+		if ( 4 + 2 * id >= vtableSize )
+			return 0;
+		uint16_t offset = read<uint16_t>( vtable + 4 + 2 * id );
+		return offset ? table + offset : 0;
+	}
+
+	template <class T> T scalar( size_t table, int id, T defaultValue = T() )
+	{
+		size_t pos = field( table, id );
+		return pos ? read<T>( pos ) : defaultValue;
+	}
+
+	// The table, vector or string a field refers to, or 0
+	size_t offset( size_t table, int id )
+	{
+		size_t pos = field( table, id );
+		return pos ? pos + read<uint32_t>( pos ) : 0;
+	}
+
+	uint32_t length( size_t vector )	{ return vector ? read<uint32_t>( vector ) : 0; }
+
+	std::string string( size_t table, int id )
+	{
+		size_t s = offset( table, id );
+		uint32_t len = length( s );
+		if ( s == 0 || s + 4 + len > data.size() ) {
+			bad = true;
+			return std::string();
+		}
+		return data.substr( s + 4, len );
+	}
+
+	// The i'th table in a vector of tables
+	size_t table( size_t vector, uint32_t i )
+	{
+		size_t pos = vector + 4 + 4 * i;
+		return pos + read<uint32_t>( pos );
+	}
+};
+
+// A RecordBatch table and the body it describes
+struct Batch {
+	long							length;
+	std::vector<long>				nodeLengths;
+	std::vector<std::pair<long,long>>	buffers;	// offset in the file and length
+};
+
+static Batch ReadRecordBatch( FlatReader & fb, size_t table, size_t body, long bodyLength )
+{
+	Batch batch;
+	batch.length = fb.scalar<int64_t>( table, 0 );
+	size_t nodes = fb.offset( table, 1 );
+	for ( uint32_t i = 0; i < fb.length( nodes ); ++i ) {
+		batch.nodeLengths.push_back( fb.read<int64_t>( nodes + 4 + 16 * i ) );	// structs follow the length, aligned to 8
+	}
+	size_t buffers = fb.offset( table, 2 );
+	for ( uint32_t i = 0; i < fb.length( buffers ); ++i ) {
+		long offset = fb.read<int64_t>( buffers + 4 + 16 * i );
+		long length = fb.read<int64_t>( buffers + 12 + 16 * i );
+		if ( offset < 0 || length < 0 || offset % 8 != 0 || offset + length > bodyLength || body + bodyLength > fb.size() )
+			fb.bad = true;
+		batch.buffers.push_back( std::pair<long,long>( body + offset, length ) );
+	}
+	return batch;
+}
+
+// What was read back from a file
+struct Contents {
+	std::vector<std::string>				columnNames;
+	std::map<long,std::vector<std::string>>	dictionaries;	// by id
+	std::vector<Changeset>					rows;
+	int										recordBatches = 0;
+	int										dictionaryBatches = 0;
+	bool									ok = false;
+};
+
+static Contents ReadArrowFile( const std::string & path )
+{
+	Contents contents;
+	std::string data;
+	FILE * file = fopen( path.c_str(), "rb" );
+	if ( file == NULL ) {
+		perror( path.c_str() );
+		return contents;
+	}
+	char buffer[65536];
+	size_t len;
+	while ( (len = fread( buffer, 1, sizeof buffer, file )) > 0 ) {
+		data.append( buffer, len );
+	}
+	fclose( file );
+
+	FlatReader fb( data );
+	if ( data.size() < 18 || memcmp( &data[0], "ARROW1\0\0", 8 ) != 0 || data.compare( data.size() - 6, 6, "ARROW1" ) != 0 ) {
+		fprintf( stderr, "%s: missing the Arrow magic\n", path.c_str() );
+		return contents;
+	}
+
+	// the footer: its schema, and the location of each message
+	int32_t footerLength = fb.read<int32_t>( data.size() - 10 );
+	size_t footer = fb.root( data.size() - 10 - footerLength );
+	Check( fb.scalar<int16_t>( footer, 0 ) == 4, "the footer is metadata version 5" );
+	size_t schema = fb.offset( footer, 1 );
+	size_t fields = fb.offset( schema, 1 );
+	for ( uint32_t i = 0; i < fb.length( fields ); ++i ) {
+		size_t field = fb.table( fields, i );
+		contents.columnNames.push_back( fb.string( field, 0 ) );
+		size_t dictionary = fb.offset( field, 4 );
+		if ( fb.scalar<uint8_t>( field, 2 ) == TYPE_UTF8 ) {
+			Check( dictionary != 0 && fb.scalar<int64_t>( dictionary, 0 ) == i, "strings are dictionary encoded by column number" );
+		}
+	}
+	std::vector<std::pair<long,long>> footerBlocks;	// offset and body length
+	for ( int list = 2; list <= 3; ++list ) {
+		size_t blocks = fb.offset( footer, list );
+		for ( uint32_t i = 0; i < fb.length( blocks ); ++i ) {
+			size_t block = blocks + 4 + 24 * i;
+			footerBlocks.push_back( std::pair<long,long>( fb.read<int64_t>( block ), fb.read<int64_t>( block + 16 ) ) );
+		}
+	}
+	std::sort( footerBlocks.begin(), footerBlocks.end() );
+
+	// the stream of messages, read in order as a streaming reader would
+	std::vector<std::pair<long,long>> streamBlocks;
+	size_t pos = 8;
+	for (;;) {
+		if ( fb.read<int32_t>( pos ) != -1 ) {
+			fprintf( stderr, "%s: no continuation marker at %ld\n", path.c_str(), (long)pos );
+			return contents;
+		}
+		int32_t metadataLength = fb.read<int32_t>( pos + 4 );
+		if ( metadataLength == 0 || fb.bad )
+			break;	// end of stream
+		size_t message = fb.root( pos + 8 );
+		uint8_t headerType = fb.scalar<uint8_t>( message, 1 );
+		size_t header = fb.offset( message, 2 );
+		long bodyLength = fb.scalar<int64_t>( message, 3 );
+		size_t body = pos + 8 + metadataLength;
+		Check( metadataLength % 8 == 0 && body % 8 == 0, "message bodies are aligned to 8 bytes" );
+
+		if ( headerType == HEADER_SCHEMA ) {
+			Check( pos == 8, "the schema is the first message" );
+		} else if ( headerType == HEADER_DICTIONARY_BATCH ) {
+			++contents.dictionaryBatches;
+			streamBlocks.push_back( std::pair<long,long>( pos, bodyLength ) );
+			long id = fb.scalar<int64_t>( header, 0 );
+			bool isDelta = fb.scalar<uint8_t>( header, 2 );
+			std::vector<std::string> & values = contents.dictionaries[id];
+			Check( isDelta == (values.size() > 0), "only the first batch of a dictionary isn't a delta" );
+			Batch batch = ReadRecordBatch( fb, fb.offset( header, 1 ), body, bodyLength );
+			if ( batch.buffers.size() != 3 ) {
+				fprintf( stderr, "%s: dictionary batch with %ld buffers\n", path.c_str(), (long)batch.buffers.size() );
+				return contents;
+			}
+			for ( long i = 0; i < batch.length; ++i ) {
+				int32_t start = fb.read<int32_t>( batch.buffers[1].first + 4 * i );
+				int32_t end = fb.read<int32_t>( batch.buffers[1].first + 4 * i + 4 );
+				if ( fb.bad || start < 0 || start > end || end > batch.buffers[2].second ) {
+					fb.bad = true;
+					break;
+				}
+				values.push_back( data.substr( batch.buffers[2].first + start, end - start ) );
+			}
+		} else if ( headerType == HEADER_RECORD_BATCH ) {
+			++contents.recordBatches;
+			streamBlocks.push_back( std::pair<long,long>( pos, bodyLength ) );
+			Batch batch = ReadRecordBatch( fb, header, body, bodyLength );
+			if ( batch.nodeLengths.size() != (size_t)COLUMN_COUNT || batch.buffers.size() != 2 * COLUMN_COUNT ) {
+				fprintf( stderr, "%s: record batch with %ld columns\n", path.c_str(), (long)batch.nodeLengths.size() );
+				return contents;
+			}
+			for ( long n: batch.nodeLengths ) {
+				Check( n == batch.length, "every column has a value for every row" );
+			}
+			// the values of column c are in buffer 2c+1, after its validity buffer
+			auto value = [&]( int column, size_t width, long row ) { return batch.buffers[2 * column + 1].first + width * row; };
+			auto string = [&]( int column, long row ) {
+				int32_t index = fb.read<int32_t>( value( column, 4, row ) );
+				const std::vector<std::string> & values = contents.dictionaries[column];
+				if ( index < 0 || index >= (int32_t)values.size() ) {
+					fb.bad = true;
+					return std::string();
+				}
+				return values[index];
+			};
+			for ( long row = 0; row < batch.length; ++row ) {
+				Changeset changeset;
+				changeset.ident = fb.read<int64_t>( value( 0, 8, row ) );
+				changeset.date = DateString( fb.read<int32_t>( value( 1, 4, row ) ) );
+				changeset.uid = fb.read<int32_t>( value( 2, 4, row ) );
+				changeset.user = string( 3, row );
+				changeset.application = string( 4, row );
+				changeset.locale = string( 5, row );
+				changeset.comment = string( 6, row );
+				changeset.editCount = fb.read<int32_t>( value( 7, 4, row ) );
+				changeset.min_lat = fb.read<double>( value( 8, 8, row ) );
+				changeset.max_lat = fb.read<double>( value( 9, 8, row ) );
+				changeset.min_lon = fb.read<double>( value( 10, 8, row ) );
+				changeset.max_lon = fb.read<double>( value( 11, 8, row ) );
+				contents.rows.push_back( changeset );
+			}
+		} else {
+			fprintf( stderr, "%s: unexpected message type %d\n", path.c_str(), headerType );
+			return contents;
+		}
+		pos = body + bodyLength;
+	}
+	Check( pos + 8 == data.size() - 10 - footerLength, "the footer follows the end of the stream" );
+	Check( streamBlocks == footerBlocks, "the footer indexes every batch in the stream" );
+
+	if ( fb.bad ) {
+		fprintf( stderr, "%s: a value is outside the file\n", path.c_str() );
+		return contents;
+	}
+	contents.ok = true;
+	return contents;
+}
+
+static Changeset MakeChangeset( long ident, const char * date, int uid, const char * user, const char * editor,
+							   const char * locale, const char * comment, int edits )
+{
+	Changeset changeset;
+	changeset.ident = ident;
+	changeset.date = date;
+	changeset.uid = uid;
+	changeset.user = user;
+	changeset.application = changeset.applicationRaw = editor;
+	changeset.locale = locale;
+	changeset.comment = comment;
+	changeset.editCount = edits;
+	changeset.min_lat = 47.5 + ident * 0.001;
+	changeset.max_lat = changeset.min_lat + 0.01;
+	changeset.min_lon = -122.4 - ident * 0.001;
+	changeset.max_lon = changeset.min_lon + 0.02;
+	return changeset;
+}
+
+// Exports the changesets in batches of batchSize rows and reads them back
+static Contents RoundTrip( const std::string & path, const std::vector<Changeset> & changesets, long batchSize )
+{
+	char * report = NULL;
+	size_t size = 0;
+	ArrowExporter exporter( path, batchSize );
+	exporter.out = open_memstream( &report, &size );
+	exporter.initialize();
+	for ( const auto &changeset: changesets ) {
+		exporter.process( changeset );
+	}
+	exporter.finalize();
+	fclose( exporter.out );
+	Check( !exporter.failed(), "the export succeeds" );
+	Check( exporter.rowCount() == (long)changesets.size(), "the exporter counts every row" );
+	std::string expected = "Exported " + std::to_string( changesets.size() ) + " changesets";
+	Check( report != NULL && strstr( report, expected.c_str() ) != NULL, "the exporter reports the rows written" );
+	free( report );
+	return ReadArrowFile( path );
+}
+
+static bool SameRow( const Changeset & a, const Changeset & b )
+{
+	return a.ident == b.ident && a.date == b.date && a.uid == b.uid && a.user == b.user
+		&& a.application == b.application && a.locale == b.locale && a.comment == b.comment
+		&& a.editCount == b.editCount && a.min_lat == b.min_lat && a.max_lat == b.max_lat
+		&& a.min_lon == b.min_lon && a.max_lon == b.max_lon;
+}
+
+int main( int argc, const char * argv[] )
+{
+	// the file is kept if a path is given, and otherwise removed at the end
+	char temporary[] = "/tmp/ArrowRoundTripTest-XXXXXX";
+	std::string path;
+	if ( argc > 1 ) {
+		path = argv[1];
+	} else {
+		int fd = mkstemp( temporary );
+		if ( fd < 0 ) {
+			perror( temporary );
+			return 1;
+		}
+		close( fd );
+		path = temporary;
+	}
+
+	// strings repeat within and across batches, and new ones arrive in every batch
+	std::vector<Changeset> changesets = {
+		MakeChangeset( 101, "2024-01-01", 1, "alice", "JOSM", "en", "#missingmaps buildings", 12 ),
+		MakeChangeset( 102, "2024-01-01", 2, "bob", "iD", "de", "", 3 ),
+		MakeChangeset( 103, "2024-01-02", 1, "alice", "JOSM", "en", "roads", 40 ),
+		MakeChangeset( 104, "2024-01-02", 3, "carol", "Go Map!!", "", "Café hinzugefügt", 1 ),
+		MakeChangeset( 105, "2024-01-03", 2, "bob", "iD", "de", "", 7 ),
+		MakeChangeset( 106, "2024-01-03", 4, "dmitri", "StreetComplete", "ru", "Добавить адрес", 2 ),
+		MakeChangeset( 107, "2024-01-04", 1, "alice", "Vespucci", "en", "roads", 9 ),
+		MakeChangeset( 108, "2024-02-29", 5, "emi", "iD", "ja", "建物を追加", 5 ),
+		MakeChangeset( 109, "2024-03-01", 3, "carol", "Go Map!!", "", "#missingmaps buildings", 0 ),
+		MakeChangeset( 110, "2024-03-01", 6, "", "", "", "", 1 ),
+	};
+
+	// batches of 4 rows: three record batches, each after new dictionary values
+	Contents contents = RoundTrip( path, changesets, 4 );
+	Check( contents.ok, "the file can be read back" );
+	Check( contents.columnNames == std::vector<std::string>( s_ColumnNames, s_ColumnNames + COLUMN_COUNT ), "the schema has every column" );
+	Check( contents.recordBatches == 3, "the rows are written in batches of the given size" );
+	Check( contents.rows.size() == changesets.size(), "the file has every row" );
+	bool same = contents.rows.size() == changesets.size();
+	for ( size_t i = 0; same && i < changesets.size(); ++i ) {
+		same = SameRow( contents.rows[i], changesets[i] );
+	}
+	Check( same, "the rows read back are the rows exported" );
+
+	// each distinct string is in its dictionary exactly once, in the order it was first seen
+	for ( int column: STRING_COLUMNS ) {
+		std::vector<std::string> expected;
+		for ( const auto &changeset: changesets ) {
+			const std::string & s = column == 3 ? changeset.user : column == 4 ? changeset.application
+								: column == 5 ? changeset.locale : changeset.comment;
+			if ( std::find( expected.begin(), expected.end(), s ) == expected.end() )
+				expected.push_back( s );
+		}
+		std::string what = std::string( "the " ) + s_ColumnNames[column] + " dictionary has each value once";
+		Check( contents.dictionaries[column] == expected, what.c_str() );
+	}
+	Check( contents.dictionaries.size() == sizeof STRING_COLUMNS / sizeof STRING_COLUMNS[0], "only string columns have dictionaries" );
+
+	// a batch that holds every row, so each dictionary is written once
+	contents = RoundTrip( path, changesets, 1000 );
+	Check( contents.ok && contents.recordBatches == 1 && contents.dictionaryBatches == 4, "one batch with one dictionary batch per string column" );
+	Check( contents.rows.size() == changesets.size() && SameRow( contents.rows.back(), changesets.back() ), "one batch has every row" );
+
+	// no rows at all is still a valid file with a schema
+	contents = RoundTrip( path, std::vector<Changeset>(), 4 );
+	Check( contents.ok && contents.columnNames.size() == (size_t)COLUMN_COUNT && contents.rows.size() == 0 && contents.recordBatches == 0,
+		  "an empty export has a schema and no batches" );
+
+	if ( argc > 1 ) {
+		// leave a file with every row to check with other readers
+		RoundTrip( path, changesets, 4 );
+	} else {
+		unlink( path.c_str() );
+	}
+
+	if ( s_Failures == 0 )
+		printf( "all passed\n" );
+	return s_Failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,150 @@
+//
+//  ConcurrentCounterTest.cpp
+//  ParseOsmChangesetFile
+//
+//  Created by Bryce Cogswell on 10/18/26.
+//  Copyright © 2026 Bryce Cogswell. All rights reserved.
+//
+//  Adds to ConcurrentCounters from several threads and checks the totals against a
+//  std::map, with budgets small enough that the shards spill, and with threads that
+//  outlive the counters they added to.
+//
+//  Build from the ParseOsmChangesetFile directory:
+//    c++ -std=gnu++17 -I. Tests/ConcurrentCounterTest.cpp ConcurrentCounter.cpp SpillingCounter.cpp Arena.cpp -lpthread -o ConcurrentCounterTest
+//
+
+#include <stdio.h>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ConcurrentCounter.hpp"
+
+static const int THREAD_COUNT = 8;
+static int s_Failures = 0;
+
+// Each thread adds its own list of keys, mostly spread over many keys but with a few hot
+// ones, and with some negative values the way retracted changesets are
+struct Work {
+	std::vector<std::vector<std::string>>	keys;
+	std::map<std::string,long>				expected;
+
+	Work( int seed, int perThread, int keyRange ) : keys( THREAD_COUNT )
+	{
+		for ( int t = 0; t < THREAD_COUNT; ++t ) {
+			std::mt19937 random( seed * 100 + t );
+			for ( int i = 0; i < perThread; ++i ) {
+				int k = random() % 4 == 0 ? random() % 5 : random() % keyRange;
+				keys[t].push_back( "comment " + std::to_string( k ) );
+				expected[keys[t].back()] += Value( i );
+			}
+		}
+	}
+	static long Value( int i )		{ return i % 3 ? 1 : -1; }
+
+	void add( ConcurrentCounter & counter, int t ) const
+	{
+		int i = 0;
+		for ( const auto &key: keys[t] ) {
+			counter.add( key, Value( i++ ) );
+		}
+	}
+
+	void check( ConcurrentCounter & counter, const char * what ) const
+	{
+		long count = 0, wrong = 0;
+		std::string prev;
+		counter.forEach( [&]( const std::string & key, long total ) {
+			if ( count > 0 && key <= prev )
+				++wrong;
+			prev = key;
+			++count;
+			auto it = expected.find( key );
+			if ( it == expected.end() || it->second != total )
+				++wrong;
+		});
+		if ( count != (long)expected.size() || wrong > 0 ) {
+			fprintf( stderr, "FAILED: %s: %ld keys of %ld, %ld wrong\n", what, count, (long)expected.size(), wrong );
+			++s_Failures;
+		}
+	}
+};
+
+// Threads that each add once to a counter and then exit
+static void AddFromNewThreads( const Work & work, ConcurrentCounter & counter )
+{
+	std::vector<std::thread> threads;
+	for ( int t = 0; t < THREAD_COUNT; ++t ) {
+		threads.push_back( std::thread( [&, t]{ work.add( counter, t ); } ) );
+	}
+	for ( auto &thread: threads ) {
+		thread.join();
+	}
+}
+
+int main()
+{
+	Work work( 1, 200000, 100000 );
+	{
+		ConcurrentCounter counter;
+		AddFromNewThreads( work, counter );
+		work.check( counter, "in memory" );
+	}
+	{
+		// 32 KB per shard, so each spills several times
+		Arena arena;
+		ConcurrentCounter counter( &arena, 2 << 20 );
+		AddFromNewThreads( work, counter );
+		work.check( counter, "spilling" );
+	}
+
+	// The same threads add to a counter, wait while it is destroyed and another created,
+	// and add to that one, so any buffer left behind for the first counter would show up.
+	Work second( 2, 50000, 20000 );
+	ConcurrentCounter * counter = new ConcurrentCounter();
+	std::mutex mutex;
+	std::condition_variable cond;
+	int phase = 0, done = 0;
+	std::vector<std::thread> threads;
+	for ( int t = 0; t < THREAD_COUNT; ++t ) {
+		threads.push_back( std::thread( [&, t]{
+			for ( int round = 0; round < 2; ++round ) {
+				{
+					std::unique_lock<std::mutex> lock( mutex );
+					cond.wait( lock, [&]{ return phase > round; } );
+				}
+				second.add( *counter, t );
+				{
+					std::unique_lock<std::mutex> lock( mutex );
+					++done;
+				}
+				cond.notify_all();
+			}
+		}));
+	}
+	for ( int round = 0; round < 2; ++round ) {
+		{
+			std::unique_lock<std::mutex> lock( mutex );
+			phase = round + 1;
+		}
+		cond.notify_all();
+		{
+			std::unique_lock<std::mutex> lock( mutex );
+			cond.wait( lock, [&]{ return done == THREAD_COUNT * (round + 1); } );
+		}
+		second.check( *counter, round == 0 ? "first counter" : "replacement counter" );
+		delete counter;
+		counter = round == 0 ? new ConcurrentCounter() : NULL;
+	}
+	for ( auto &thread: threads ) {
+		thread.join();
+	}
+
+	if ( s_Failures == 0 )
+		printf( "all passed\n" );
+	return s_Failures == 0 ? 0 : 1;
+}
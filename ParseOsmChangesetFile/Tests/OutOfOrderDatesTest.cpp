@@ -0,0 +1,146 @@
+//
+//  OutOfOrderDatesTest.cpp
+//  ParseOsmChangesetFile
+//
+//  Created by Bryce Cogswell on 10/18/26.
+//  Copyright © 2026 Bryce Cogswell. All rights reserved.
+//
+//  Changesets are mostly in date order, but not always. Checks that readers which track
+//  users from day to day report the same thing when some changesets arrive late.
+//
+//  Build from the ParseOsmChangesetFile directory with all the sources except main.cpp:
+//    c++ -std=gnu++17 -I. Tests/OutOfOrderDatesTest.cpp $(ls *.cpp | grep -v main.cpp) -lz -lpthread -o OutOfOrderDatesTest
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "ChangesetParser.hpp"
+#include "GroupBy.hpp"
+#include "Readers.hpp"
+#include "UserTable.hpp"
+
+static unsigned long s_Generation = 1UL << 40;	// past anything the parser would use
+static int s_Failures = 0;
+
+static Changeset MakeChangeset( int day, int uid, const char * user, const char * editor )
+{
+	Changeset changeset;
+	changeset.date = DateString( day );
+	changeset.user = user;
+	changeset.uid = uid;
+	changeset.application = changeset.applicationRaw = editor;
+	changeset.ident = 0;
+	changeset.editCount = 1;
+	changeset.min_lat = changeset.max_lat = changeset.min_lon = changeset.max_lon = 0.0;
+	return changeset;
+}
+
+// Passes the changesets to a new reader and returns its report
+static std::string Report( const char * readerName, const std::vector<Changeset> & changesets )
+{
+	ChangesetReader * reader = newReader( readerName );
+	if ( reader == NULL ) {
+		fprintf( stderr, "no reader named %s\n", readerName );
+		exit( 1 );
+	}
+	char * buffer = NULL;
+	size_t size = 0;
+	reader->out = open_memstream( &buffer, &size );
+	reader->initialize();
+	for ( const auto &changeset: changesets ) {
+		g_Users.update( changeset.uid, changeset.user );
+		changeset.generation = ++s_Generation;
+		reader->process( changeset );
+	}
+	reader->finalize();
+	fclose( reader->out );
+	std::string report( buffer, size );
+	free( buffer );
+	delete reader;
+	return report;
+}
+
+static void Check( bool ok, const char * what )
+{
+	if ( !ok ) {
+		fprintf( stderr, "FAILED: %s\n", what );
+		++s_Failures;
+	}
+}
+
+// alice edits every day for 150 days and bob every other day, with both editors
+static std::vector<Changeset> InOrder( int firstDay )
+{
+	std::vector<Changeset> list;
+	for ( int day = firstDay; day < firstDay + 150; ++day ) {
+		list.push_back( MakeChangeset( day, 1, "alice", "iD" ) );
+		if ( (day - firstDay) % 2 == 0 )
+			list.push_back( MakeChangeset( day, 2, "bob", "JOSM" ) );
+		list.push_back( MakeChangeset( day, 1, "alice", "JOSM" ) );
+	}
+	return list;
+}
+
+// Moves every changeset alice made on the day to after the changesets of a later day
+static void MakeLate( std::vector<Changeset> & list, int day, int laterDay )
+{
+	std::vector<Changeset> late;
+	auto keep = std::remove_if( list.begin(), list.end(), [&]( const Changeset & c ) {
+		if ( c.uid != 1 || c.date != DateString( day ) )
+			return false;
+		late.push_back( c );
+		return true;
+	});
+	list.erase( keep, list.end() );
+	auto pos = std::find_if( list.begin(), list.end(), [&]( const Changeset & c ) { return c.date > DateString( laterDay ); } );
+	list.insert( pos, late.begin(), late.end() );
+}
+
+// The same changesets, with some arriving a few days late
+static std::vector<Changeset> Shuffled( int firstDay )
+{
+	std::vector<Changeset> list = InOrder( firstDay );
+	for ( size_t i = 10; i + 9 < list.size(); i += 37 ) {
+		Changeset late = list[i];
+		list.erase( list.begin() + i );
+		list.insert( list.begin() + i + 9, late );
+	}
+	MakeLate( list, firstDay + 40, firstDay + 43 );
+	// and changesets without edits on days that were already counted, after a later day
+	for ( int day = firstDay + 130; day < firstDay + 149; ++day ) {
+		list.push_back( MakeChangeset( day + 1, 1, "alice", "JOSM" ) );
+		list.push_back( MakeChangeset( day, 1, "alice", "JOSM" ) );
+		list.end()[-1].editCount = list.end()[-2].editCount = 0;
+	}
+	return list;
+}
+
+int main()
+{
+	int firstDay = DayNumber( "2024-01-01" );
+
+	std::string streaks = Report( "EditStreaks", InOrder( firstDay ) );
+	Check( streaks.find( "|        150| 2024-01-01 | [alice]" ) != std::string::npos, "EditStreaks finds the streak" );
+	Check( Report( "EditStreaks", Shuffled( firstDay ) ) == streaks, "EditStreaks with late changesets" );
+
+	// a missing day splits the streak into two that are too short to report,
+	// until it arrives after the days that follow it
+	std::vector<Changeset> gap = InOrder( firstDay );
+	MakeLate( gap, firstDay + 75, firstDay + 149 );
+	std::vector<Changeset> split( gap.begin(), gap.end() - 2 );
+	Check( Report( "EditStreaks", split ).find( "[alice]" ) == std::string::npos, "EditStreaks breaks the streak on a missing day" );
+	Check( Report( "EditStreaks", gap ) == streaks, "EditStreaks joins streaks when the missing day arrives late" );
+
+	// alice every day and bob every other day use JOSM, with an edit each
+	std::string daily = Report( "EditorDailyUsers", InOrder( firstDay ) );
+	Check( daily.find( "   1.5          1.0  JOSM" ) != std::string::npos, "EditorDailyUsers counts the users" );
+	Check( Report( "EditorDailyUsers", Shuffled( firstDay ) ).find( "   1.5          1.0  JOSM" ) != std::string::npos, "EditorDailyUsers with late changesets" );
+
+	if ( s_Failures == 0 )
+		printf( "all passed\n" );
+	return s_Failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,273 @@
+//
+//  UserSet.cpp
+//  ParseOsmChangesetFile
+//
+//  Created by Bryce Cogswell on 10/18/26.
+//  Copyright © 2026 Bryce Cogswell. All rights reserved.
+//
+
+#include <algorithm>
+#include <iterator>
+
+#include "UserSet.hpp"
+
+static inline uint32_t PopCount( uint64_t word )
+{
+	return (uint32_t)__builtin_popcountll( word );
+}
+
+bool UserSet::Container::contains( uint16_t low ) const
+{
+	if ( isBitmap() )
+		return (bitmap[low >> 6] >> (low & 63)) & 1;
+	return std::binary_search( array.begin(), array.end(), low );
+}
+
+void UserSet::Container::toBitmap()
+{
+	bitmap.assign( BITMAP_WORDS, 0 );
+	for ( uint16_t low: array ) {
+		bitmap[low >> 6] |= 1ULL << (low & 63);
+	}
+	array.clear();
+	array.shrink_to_fit();
+}
+
+void UserSet::Container::toArray()
+{
+	array.clear();
+	array.reserve( count );
+	for ( uint32_t w = 0; w < BITMAP_WORDS; ++w ) {
+		for ( uint64_t word = bitmap[w]; word != 0; word &= word - 1 ) {
+			array.push_back( (uint16_t)(w * 64 + __builtin_ctzll( word )) );
+		}
+	}
+	bitmap.clear();
+	bitmap.shrink_to_fit();
+}
+
+UserSet::Container * UserSet::find( uint16_t key )
+{
+	auto it = std::lower_bound( containers.begin(), containers.end(), key,
+							   []( const Container & c, uint16_t key ) { return c.key < key; } );
+	return it != containers.end() && it->key == key ? &*it : NULL;
+}
+
+const UserSet::Container * UserSet::find( uint16_t key ) const
+{
+	return const_cast<UserSet *>( this )->find( key );
+}
+
+bool UserSet::add( uint32_t uid )
+{
+	uint16_t key = uid >> 16, low = uid & 0xFFFF;
+	auto it = std::lower_bound( containers.begin(), containers.end(), key,
+							   []( const Container & c, uint16_t key ) { return c.key < key; } );
+	if ( it == containers.end() || it->key != key )
+		it = containers.insert( it, Container( key, arena ) );
+	Container & c = *it;
+	if ( c.isBitmap() ) {
+		uint64_t & word = c.bitmap[low >> 6];
+		uint64_t bit = 1ULL << (low & 63);
+		if ( word & bit )
+			return false;
+		word |= bit;
+	} else {
+		auto pos = std::lower_bound( c.array.begin(), c.array.end(), low );
+		if ( pos != c.array.end() && *pos == low )
+			return false;
+		c.array.insert( pos, low );
+		if ( c.array.size() > ARRAY_LIMIT )
+			c.toBitmap();
+	}
+	++c.count;
+	++total;
+	return true;
+}
+
+bool UserSet::contains( uint32_t uid ) const
+{
+	const Container * c = find( uid >> 16 );
+	return c != NULL && c->contains( uid & 0xFFFF );
+}
+
+long UserSet::intersectionCount( const Container & a, const Container & b )
+{
+	long count = 0;
+	if ( a.isBitmap() && b.isBitmap() ) {
+		for ( uint32_t w = 0; w < BITMAP_WORDS; ++w ) {
+			count += PopCount( a.bitmap[w] & b.bitmap[w] );
+		}
+	} else if ( a.isBitmap() || b.isBitmap() ) {
+		const Container & array = a.isBitmap() ? b : a;
+		const Container & bitmap = a.isBitmap() ? a : b;
+		for ( uint16_t low: array.array ) {
+			count += (bitmap.bitmap[low >> 6] >> (low & 63)) & 1;
+		}
+	} else {
+		// without branches, since which list advances is unpredictable
+		const uint16_t * i = a.array.data(), * iEnd = i + a.array.size();
+		const uint16_t * j = b.array.data(), * jEnd = j + b.array.size();
+		while ( i != iEnd && j != jEnd ) {
+			uint16_t x = *i, y = *j;
+			count += x == y;
+			i += x <= y;
+			j += y <= x;
+		}
+	}
+	return count;
+}
+
+void UserSet::unionWith( Container & a, const Container & b )
+{
+	if ( !a.isBitmap() && !b.isBitmap() && a.count + b.count <= ARRAY_LIMIT ) {
+		ArenaVector<uint16_t> merged( a.array.get_allocator() );
+		merged.reserve( a.count + b.count );
+		std::set_union( a.array.begin(), a.array.end(), b.array.begin(), b.array.end(), std::back_inserter( merged ) );
+		a.array.swap( merged );
+		a.count = (uint32_t)a.array.size();
+		return;
+	}
+	if ( !a.isBitmap() )
+		a.toBitmap();
+	if ( b.isBitmap() ) {
+		for ( uint32_t w = 0; w < BITMAP_WORDS; ++w ) {
+			a.bitmap[w] |= b.bitmap[w];
+		}
+	} else {
+		for ( uint16_t low: b.array ) {
+			a.bitmap[low >> 6] |= 1ULL << (low & 63);
+		}
+	}
+	uint32_t count = 0;
+	for ( uint32_t w = 0; w < BITMAP_WORDS; ++w ) {
+		count += PopCount( a.bitmap[w] );
+	}
+	a.count = count;
+	if ( a.count <= ARRAY_LIMIT )
+		a.toArray();
+}
+
+void UserSet::intersectWith( Container & a, const Container & b )
+{
+	if ( a.isBitmap() && b.isBitmap() ) {
+		uint32_t count = 0;
+		for ( uint32_t w = 0; w < BITMAP_WORDS; ++w ) {
+			a.bitmap[w] &= b.bitmap[w];
+			count += PopCount( a.bitmap[w] );
+		}
+		a.count = count;
+		if ( a.count <= ARRAY_LIMIT )
+			a.toArray();
+		return;
+	}
+	if ( a.isBitmap() ) {
+		// the result is no larger than b's array
+		ArenaVector<uint16_t> kept( a.array.get_allocator() );
+		for ( uint16_t low: b.array ) {
+			if ( (a.bitmap[low >> 6] >> (low & 63)) & 1 )
+				kept.push_back( low );
+		}
+		a.bitmap.clear();
+		a.bitmap.shrink_to_fit();
+		a.array.swap( kept );
+	} else {
+		auto out = std::remove_if( a.array.begin(), a.array.end(), [&]( uint16_t low ) { return !b.contains( low ); } );
+		a.array.erase( out, a.array.end() );
+	}
+	a.count = (uint32_t)a.array.size();
+}
+
+UserSet & UserSet::operator |= ( const UserSet & other )
+{
+	// merge the sorted lists of containers
+	ArenaVector<Container> merged( containers.get_allocator() );
+	merged.reserve( containers.size() + other.containers.size() );
+	auto i = containers.begin();
+	auto j = other.containers.begin();
+	while ( i != containers.end() || j != other.containers.end() ) {
+		if ( j == other.containers.end() || (i != containers.end() && i->key < j->key) ) {
+			merged.push_back( std::move( *i++ ) );
+		} else if ( i == containers.end() || j->key < i->key ) {
+			Container copy( j->key, arena );
+			copy.count = j->count;
+			copy.array.assign( j->array.begin(), j->array.end() );
+			copy.bitmap.assign( j->bitmap.begin(), j->bitmap.end() );
+			merged.push_back( std::move( copy ) );
+			++j;
+		} else {
+			unionWith( *i, *j );
+			merged.push_back( std::move( *i++ ) );
+			++j;
+		}
+	}
+	containers.swap( merged );
+	total = 0;
+	for ( const auto &c: containers ) {
+		total += c.count;
+	}
+	return *this;
+}
+
+UserSet & UserSet::operator &= ( const UserSet & other )
+{
+	ArenaVector<Container> kept( containers.get_allocator() );
+	for ( auto &c: containers ) {
+		const Container * match = other.find( c.key );
+		if ( match == NULL )
+			continue;
+		intersectWith( c, *match );
+		if ( c.count > 0 )
+			kept.push_back( std::move( c ) );
+	}
+	containers.swap( kept );
+	total = 0;
+	for ( const auto &c: containers ) {
+		total += c.count;
+	}
+	return *this;
+}
+
+long UserSet::intersectionCount( const UserSet & a, const UserSet & b )
+{
+	long count = 0;
+	auto i = a.containers.begin();
+	auto j = b.containers.begin();
+	while ( i != a.containers.end() && j != b.containers.end() ) {
+		if ( i->key < j->key ) {
+			++i;
+		} else if ( j->key < i->key ) {
+			++j;
+		} else {
+			count += intersectionCount( *i++, *j++ );
+		}
+	}
+	return count;
+}
+
+void UserSet::forEach( const std::function<void(uint32_t uid)> & fn ) const
+{
+	for ( const auto &c: containers ) {
+		uint32_t high = (uint32_t)c.key << 16;
+		if ( c.isBitmap() ) {
+			for ( uint32_t w = 0; w < BITMAP_WORDS; ++w ) {
+				for ( uint64_t word = c.bitmap[w]; word != 0; word &= word - 1 ) {
+					fn( high | (w * 64 + __builtin_ctzll( word )) );
+				}
+			}
+		} else {
+			for ( uint16_t low: c.array ) {
+				fn( high | low );
+			}
+		}
+	}
+}
+
+size_t UserSet::bytes() const
+{
+	size_t bytes = containers.capacity() * sizeof(Container);
+	for ( const auto &c: containers ) {
+		bytes += c.array.capacity() * sizeof(uint16_t) + c.bitmap.capacity() * sizeof(uint64_t);
+	}
+	return bytes;
+}
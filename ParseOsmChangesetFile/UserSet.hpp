@@ -0,0 +1,80 @@
+//
+//  UserSet.hpp
+//  ParseOsmChangesetFile
+//
+//  Created by Bryce Cogswell on 10/18/26.
+//  Copyright © 2026 Bryce Cogswell. All rights reserved.
+//
+
+#ifndef UserSet_hpp
+#define UserSet_hpp
+
+#include <stddef.h>
+#include <stdint.h>
+#include <functional>
+
+#include "Arena.hpp"
+
+// A set of uids stored as a compressed (roaring) bitmap, for exact distinct user counts
+// that cost a few bytes per user rather than a set node and a string.
+//
+// Uids are split by their high 16 bits into containers, kept sorted by those bits. A
+// container holds the low 16 bits either as a sorted array, while it has at most
+// ARRAY_LIMIT members, or as a bitmap of 65536 bits once it has more. Either way a
+// container never uses more than 8 KB, and at most 2 bytes per member.
+//
+// Union and intersection work a container at a time, with word-wide operations and
+// popcounts on bitmaps, so sets of a few thousand users combine in microseconds.
+// Sets are ordinary values that can be copied and stored in the readers' maps, and
+// allocate from the arena if one is given.
+class UserSet {
+public:
+	static const uint32_t ARRAY_LIMIT = 4096;		// where a bitmap becomes smaller than an array
+	static const uint32_t BITMAP_WORDS = 65536 / 64;
+private:
+	struct Container {
+		uint16_t				key;		// the high 16 bits of the uids
+		uint32_t				count;
+		ArenaVector<uint16_t>	array;		// the sorted low bits, while count <= ARRAY_LIMIT
+		ArenaVector<uint64_t>	bitmap;		// BITMAP_WORDS words once larger, else empty
+
+		Container( uint16_t key, Arena * arena ) : key(key), count(0), array(arena), bitmap(arena) {}
+		bool isBitmap() const	{ return !bitmap.empty(); }
+		bool contains( uint16_t low ) const;
+		void toBitmap();
+		void toArray();
+	};
+	ArenaVector<Container>	containers;
+	long					total = 0;
+	Arena				*	arena;
+
+	Container * find( uint16_t key );
+	const Container * find( uint16_t key ) const;
+	static long intersectionCount( const Container & a, const Container & b );
+	static void unionWith( Container & a, const Container & b );
+	static void intersectWith( Container & a, const Container & b );
+public:
+	UserSet( Arena * arena = NULL ) : containers(arena), arena(arena) {}
+
+	// Returns true if the uid wasn't already in the set
+	bool add( uint32_t uid );
+	bool contains( uint32_t uid ) const;
+	void clear()				{ containers.clear(); total = 0; }
+
+	long size() const			{ return total; }
+	bool empty() const			{ return total == 0; }
+
+	UserSet & operator |= ( const UserSet & other );
+	UserSet & operator &= ( const UserSet & other );
+
+	// The size of the intersection, without building it
+	static long intersectionCount( const UserSet & a, const UserSet & b );
+
+	// Calls the function with each uid in increasing order
+	void forEach( const std::function<void(uint32_t uid)> & fn ) const;
+
+	// The memory used by the members, not counting the object itself
+	size_t bytes() const;
+};
+
+#endif /* UserSet_hpp */
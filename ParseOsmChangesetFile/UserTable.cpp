@@ -0,0 +1,19 @@
+//
+//  UserTable.cpp
+//  ParseOsmChangesetFile
+//
+//  Created by Bryce Cogswell on 10/18/26.
+//  Copyright © 2026 Bryce Cogswell. All rights reserved.
+//
+
+#include "UserTable.hpp"
+
+UserTable g_Users;
+
+const std::string & UserTable::name( int uid ) const
+{
+	static const std::string unknown;
+	if ( uid < 0 || uid >= (int)nameIds.size() || nameIds[uid] < 0 )
+		return unknown;
+	return names.string( nameIds[uid] );
+}
@@ -0,0 +1,93 @@
+//
+//  UserTable.hpp
+//  ParseOsmChangesetFile
+//
+//  Created by Bryce Cogswell on 10/18/26.
+//  Copyright © 2026 Bryce Cogswell. All rights reserved.
+//
+
+#ifndef UserTable_hpp
+#define UserTable_hpp
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "Arena.hpp"
+#include "StringTable.hpp"
+
+// The display name of every user, indexed directly by uid. User ids are dense
+// integers, so this is a flat array rather than a hash table. Users can rename
+// themselves, and the most recent name seen is the one that is kept.
+class UserTable {
+	std::vector<int32_t>	nameIds;	// indexed by uid, -1 if not seen
+	StringTable				names;
+	long					renames;
+public:
+	UserTable() : renames(0) {}
+
+	void update( int uid, const std::string & name )
+	{
+		if ( uid < 0 )
+			return;
+		if ( uid >= (int)nameIds.size() )
+			nameIds.resize( uid + 1, -1 );
+		int32_t & id = nameIds[uid];
+		// the common case is the same name as last time, which is just a string compare
+		if ( id >= 0 && names.string( id ) == name )
+			return;
+		if ( id >= 0 )
+			++renames;
+		id = names.intern( name );
+	}
+
+	// The latest name for the user, or an empty string if they haven't been seen
+	const std::string & name( int uid ) const;
+
+	long renameCount() const	{ return renames; }
+};
+
+// Updated with every changeset before it is passed to the readers,
+// so readers can key their state by uid and look up names at the end.
+extern UserTable g_Users;
+
+// Per-user state for a reader, addressed by uid in constant time.
+// The uid index is a flat array and the values are stored densely in the order
+// users are first seen, so sparse readers don't pay for a value per uid.
+// The arrays are allocated from the arena if one is given.
+template <class T> class PerUser {
+	ArenaVector<int32_t>	index;		// indexed by uid, -1 if not present
+	ArenaVector<int>		uids;
+	ArenaVector<T>			values;
+public:
+	PerUser( Arena * arena = NULL ) : index(arena), uids(arena), values(arena) {}
+
+	T & operator[]( int uid )
+	{
+		if ( uid >= (int)index.size() )
+			index.resize( uid + 1, -1 );
+		int32_t & i = index[uid];
+		if ( i < 0 ) {
+			i = (int32_t)values.size();
+			values.push_back( T() );
+			uids.push_back( uid );
+		}
+		return values[i];
+	}
+
+	// Returns NULL if the user has no entry
+	const T * find( int uid ) const
+	{
+		if ( uid < 0 || uid >= (int)index.size() || index[uid] < 0 )
+			return NULL;
+		return &values[index[uid]];
+	}
+
+	// Entries in the order they were created
+	size_t size() const						{ return values.size(); }
+	int uid( size_t i ) const				{ return uids[i]; }
+	const T & value( size_t i ) const		{ return values[i]; }
+	T & value( size_t i )					{ return values[i]; }
+};
+
+#endif /* UserTable_hpp */
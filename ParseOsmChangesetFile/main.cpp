@@ -7,12 +7,30 @@
 //
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <string>
+#include <vector>
 #include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
 #include <sys/time.h>
+#include <sys/wait.h>
 
+#include "ArrowExport.hpp"
 #include "ChangesetParser.hpp"
+#include "CommentIndex.hpp"
+#include "ChangesetStore.hpp"
+#include "InputSource.hpp"
+#include "PluginReader.hpp"
 #include "Readers.hpp"
+#include "Replication.hpp"
+#include "RollupCube.hpp"
+#include "Parallel.hpp"
+#include "Server.hpp"
+#include "SpatialIndex.hpp"
+#include "ShardManifest.hpp"
+#include "SpillingCounter.hpp"
 
 
 double timestamp()
@@ -22,31 +40,704 @@ double timestamp()
 	return time.tv_sec + time.tv_usec * 1e-6;
 }
 
-bool parseFile( const char * path, const char * startDate )
+static void printThroughput( const InputSource & source, double seconds )
 {
-	printf("Start date = %s\n",startDate);
+	double mb = source.totalBytesRead() / (1024.0 * 1024.0);
+	printf( "input %s: %.1f MB in %.2f sec = %.1f MB/sec\n", source.name(), mb, seconds, mb / seconds );
+}
+
+// Reports the memory each reader allocated from its arenas
+static void printMemoryUsage( const std::vector<ChangesetReader *> & readers )
+{
+	for ( const auto reader: readers ) {
+		ArenaUsage usage;
+		reader->addMemoryUsage( usage );
+		if ( usage.allocations == 0 )
+			continue;
+		printf( "memory %s: peak %.1f MB, %.1f MB at end, %.1f MB reserved, %ld allocations\n",
+			   reader->name.c_str(),
+			   usage.peak / (1024.0 * 1024.0),
+			   usage.current / (1024.0 * 1024.0),
+			   usage.reserved / (1024.0 * 1024.0),
+			   usage.allocations );
+	}
+}
+
+// Deleting the readers frees their arenas
+static void deleteReaders( const std::vector<ChangesetReader *> & readers )
+{
+	for ( auto reader: readers ) {
+		delete reader;
+	}
+}
+
+static void printDateRange( const ReaderParameters & params )
+{
+	printf("Start date = %s\n",params.startDate.c_str());
+	if ( params.endDate.size() > 0 )
+		printf("End date = %s\n",params.endDate.c_str());
 	printf("\n");
+}
+
+// Runs the readers over the input. Only runs whose results are printed and then thrown away
+// sample; anything that is saved and used again, like a cube or an index, reads everything.
+bool parseFile( const char * path, const ReaderParameters & params, const InputOptions & options,
+			   const ChangesetFilter & filter, const std::vector<ChangesetReader *> & readers,
+			   const SampleSettings & sampling, long rangeBegin = 0, long rangeEnd = -1 )
+{
+	printDateRange( params );
+
+	InputSource * source = NewInputSource( options );
+	if ( source == NULL ) {
+		fprintf( stderr, "Input backend '%s' is not available\n", options.backend.c_str() );
+		return false;
+	}
+	if ( !source->open( path ) ) {
+		delete source;
+		return false;
+	}
 
 	ChangesetParser * parser = new ChangesetParser();
-	auto readers = getReaders();
+	parser->setFilter( filter );
+	parser->setEndDate( params.endDate );
+	parser->setByteRange( rangeBegin, rangeEnd );
+	parser->setSampling( sampling );
 	for ( auto &reader: readers ) {
-		parser->addReader(reader);
+		if ( !parser->addReader(reader) ) {
+			delete source;
+			return false;
+		}
 	}
-	return parser->parseXmlFile( path, startDate );
+	double time = timestamp();
+	bool ok = parser->parseInput( *source, params.startDate );
+	time = timestamp() - time;
+	printThroughput( *source, time );
+	if ( parser->errorCount() > 0 )
+		printf( "parse errors: %s\n", parser->errorSummary().c_str() );
+	if ( parser->stoppedByErrors() )
+		printf( "parsing stopped at a malformed changeset, so the reports above are partial (see --max-errors)\n" );
+	if ( ok && parser->isSampling() )
+		printf( "sample: %s\n", parser->sampleSummary().c_str() );
+	delete source;
+	return ok;
 }
 
-int main(int argc, const char * argv[])
+// Loads the changesets into memory once and then answers queries about them. Queries can
+// only ask about the dates that were loaded, so the whole file is loaded unless --start or
+// --end narrow it.
+bool serveFile( const char * path, const ReaderParameters & params, const InputOptions & options,
+			   const ChangesetFilter & filter, const char * socketPath )
+{
+	ChangesetStore * store = new ChangesetStore();
+	std::vector<ChangesetReader *> readers;
+	readers.push_back( store );
+	if ( !parseFile( path, params, options, filter, readers, SampleSettings() ) )
+		return false;
+	AnalysisServer server( *store, params.startDate, params.endDate );
+	return server.run( socketPath );
+}
+
+// Parses one shard of a sharded run and saves the changesets as its partial state
+bool mapShard( const Shard & shard, const ReaderParameters & params, const InputOptions & options,
+			  const ChangesetFilter & filter )
+{
+	ChangesetStore store;
+	std::vector<ChangesetReader *> readers( 1, &store );
+	if ( !parseFile( shard.input.c_str(), params, options, filter, readers, SampleSettings(), shard.begin, shard.end ) )
+		return false;
+	// write to a temporary name so a failed worker never leaves a partial that looks complete
+	std::string temp = shard.partial + ".tmp";
+	if ( !store.save( temp ) )
+		return false;
+	if ( rename( temp.c_str(), shard.partial.c_str() ) != 0 ) {
+		perror( shard.partial.c_str() );
+		return false;
+	}
+	printf( "%s: %ld changesets\n", shard.partial.c_str(), (long)store.size() );
+	return true;
+}
+
+// Runs the readers over the partial states of a sharded run in manifest order. Only one
+// shard is in memory at a time, so the reduce needs as much memory as the largest shard
+// plus what the readers keep, rather than the whole input.
+bool reduceShards( const std::vector<Shard> & shards, const ReaderParameters & params,
+				  const ChangesetFilter & filter, const std::vector<ChangesetReader *> & readers )
 {
-	const char * path;
-	if ( argc == 2 ) {
-		path = argv[1];
+	printDateRange( params );
+	FilteredReaders filtered;
+	filtered.setFilter( filter );
+	for ( auto reader: readers ) {
+		filtered.add( reader );
+	}
+	filtered.initialize();
+	for ( const auto &shard: shards ) {
+		ChangesetStore store;
+		if ( !store.load( shard.partial ) )
+			return false;
+		store.replay( filtered, params.startDate, params.endDate );
+	}
+	filtered.finalize();
+	return true;
+}
+
+// Runs the shards in local worker processes, as many at once as there are cores, and then reduces them
+bool mapReduceShards( const std::vector<Shard> & shards, const ReaderParameters & params, const InputOptions & options,
+					 const ChangesetFilter & filter, const std::vector<ChangesetReader *> & readers )
+{
+	bool ok = true;
+	size_t next = 0, running = 0;
+	fflush( stdout );
+	while ( next < shards.size() || running > 0 ) {
+		if ( next < shards.size() && running < g_WorkerCount ) {
+			pid_t pid = fork();
+			if ( pid == 0 ) {
+				// keep the workers' progress out of the report
+				dup2( STDERR_FILENO, STDOUT_FILENO );
+				bool mapped = mapShard( shards[next], params, options, filter );
+				fflush( stdout );
+				_exit( mapped ? 0 : 1 );
+			}
+			if ( pid < 0 ) {
+				perror( "fork" );
+				ok = false;
+				next = shards.size();
+				continue;
+			}
+			++next;
+			++running;
+		} else {
+			int status;
+			if ( wait( &status ) < 0 ) {
+				perror( "wait" );
+				return false;
+			}
+			--running;
+			if ( !WIFEXITED( status ) || WEXITSTATUS( status ) != 0 )
+				ok = false;
+		}
+	}
+	if ( !ok ) {
+		fprintf( stderr, "A shard failed\n" );
+		return false;
+	}
+	return reduceShards( shards, params, filter, readers );
+}
+
+// Loads the stored changesets, or parses them from the input, brings them up to date
+// with the replication files and runs the readers. Optionally saves the updated store.
+bool ingestReplication( const char * path, const char * directory, const char * loadPath, const char * savePath,
+					   const ReaderParameters & params, const InputOptions & options,
+					   const ChangesetFilter & filter, const std::vector<ChangesetReader *> & readers )
+{
+	ChangesetStore * store = new ChangesetStore();
+	if ( loadPath ) {
+		if ( !store->load( loadPath ) )
+			return false;
+		printDateRange( params );
 	} else {
-		path = "/tmp/cs.osm";
+		std::vector<ChangesetReader *> storeReaders( 1, store );
+		if ( !parseFile( path, params, options, filter, storeReaders, SampleSettings() ) )
+			return false;
+	}
+	ReplicationIngester ingester( *store, readers, params.startDate, params.endDate, filter );
+	if ( !ingester.run( directory ) )
+		return false;
+	if ( savePath && !store->save( savePath ) )
+		return false;
+	delete store;
+	return true;
+}
+
+// Brings the rollup cube in the file up to date with the input, creating it if necessary, and
+// answers the readers that only need its totals from it. The input is scanned for the rest.
+bool answerFromRollup( const char * path, const char * rollupPath, const ReaderParameters & params,
+					  const InputOptions & options, const ChangesetFilter & filter,
+					  const std::vector<ChangesetReader *> & readers )
+{
+	RollupCube cube;
+	ReaderParameters update;
+	if ( access( rollupPath, F_OK ) == 0 ) {
+		if ( !cube.load( rollupPath ) )
+			return false;
+		update.startDate = cube.removeLastDate();
+	}
+	std::vector<ChangesetReader *> cubeReaders( 1, &cube );
+	if ( !parseFile( path, update, options, ChangesetFilter(), cubeReaders, SampleSettings() ) || !cube.save( rollupPath ) )
+		return false;
+
+	// the cube can't apply filters, so filtered readers need a scan
+	cube.setDateRange( params.startDate, params.endDate );
+	std::vector<ChangesetReader *> answered;
+	std::vector<ChangesetReader *> all;
+	bool scan = false;
+	for ( auto reader: readers ) {
+		if ( reader->usesRollup() && reader->filter() == NULL && filter.empty() ) {
+			answered.push_back( cube.answer( reader ) );
+			all.push_back( answered.back() );
+		} else {
+			all.push_back( reader );
+			scan = true;
+		}
+	}
+	printf( "Rollup: %ld cells, %ld of %ld readers answered from the cube\n",
+		   (long)cube.size(), (long)answered.size(), (long)readers.size() );
+	bool ok = true;
+	if ( scan ) {
+		ok = parseFile( path, params, options, filter, all, SampleSettings() );
+	} else {
+		printDateRange( params );
+		FilteredReaders filtered;
+		for ( auto reader: all ) {
+			filtered.add( reader );
+		}
+		filtered.initialize();
+		filtered.finalize();
+	}
+	deleteReaders( answered );
+	return ok;
+}
+
+// The modification time of a file in nanoseconds
+static int64_t ModificationTime( const struct stat & statbuf )
+{
+#if defined(__APPLE__)
+	return (int64_t)statbuf.st_mtimespec.tv_sec * 1000000000 + statbuf.st_mtimespec.tv_nsec;
+#else
+	return (int64_t)statbuf.st_mtim.tv_sec * 1000000000 + statbuf.st_mtim.tv_nsec;
+#endif
+}
+
+// Opens the index in the file, building it first with its builder reader if it doesn't exist or the input has changed since.
+// A file rewritten in place with the same size still has a new modification time.
+template <class Index, class Builder>
+static bool openIndex( Index & index, const char * path, const char * indexPath, const InputOptions & options )
+{
+	struct stat input;
+	if ( stat( path, &input ) != 0 ) {
+		perror( path );
+		return false;
+	}
+	if ( access( indexPath, F_OK ) == 0 && index.open( indexPath ) &&
+		index.indexedFileSize() == (long)input.st_size && index.indexedFileTime() == ModificationTime( input ) )
+		return true;
+	index.close();
+
+	Builder * builder = new Builder();
+	std::vector<ChangesetReader *> builders( 1, builder );
+	bool ok = parseFile( path, ReaderParameters(), options, ChangesetFilter(), builders, SampleSettings() ) &&
+			  builder->save( indexPath, input.st_size, ModificationTime( input ) );
+	delete builder;
+	return ok && index.open( indexPath );
+}
+
+// Runs the readers over only the records at the given offsets and lengths in the input
+static bool parseRecordsAt( const char * path, const std::vector<std::pair<long,long>> & records,
+						   const ReaderParameters & params, const InputOptions & options,
+						   const ChangesetFilter & filter, const std::vector<ChangesetReader *> & readers )
+{
+	printDateRange( params );
+
+	InputSource * source = NewInputSource( options );
+	if ( source == NULL ) {
+		fprintf( stderr, "Input backend '%s' is not available\n", options.backend.c_str() );
+		return false;
+	}
+	if ( !source->open( path ) ) {
+		delete source;
+		return false;
+	}
+	ChangesetParser * parser = new ChangesetParser();
+	parser->setFilter( filter );
+	parser->setEndDate( params.endDate );
+	for ( auto &reader: readers ) {
+		if ( !parser->addReader(reader) ) {
+			delete source;
+			return false;
+		}
 	}
-	const char * startDate = "2024-03-03";
 	double time = timestamp();
-	parseFile( path, startDate );
+	bool ok = parser->parseRecordsAt( *source, records, params.startDate );
 	time = timestamp() - time;
-	printf( "total time = %f\n", time);
-	return 0;
+	printf( "records: %ld in %.2f sec\n", (long)records.size(), time );
+	if ( parser->errorCount() > 0 )
+		printf( "parse errors: %s\n", parser->errorSummary().c_str() );
+	if ( parser->stoppedByErrors() )
+		printf( "parsing stopped at a malformed changeset, so the reports above are partial (see --max-errors)\n" );
+	if ( ok && parser->isSampling() )
+		printf( "sample: %s\n", parser->sampleSummary().c_str() );
+	delete source;
+	return ok;
+}
+
+// Runs the readers over only the changesets that intersect a region, reading just their records.
+// The region is the one given, or else the union of the regions of the readers, and if
+// some reader doesn't have one the whole input is scanned.
+bool answerFromSpatialIndex( const char * path, const char * indexPath, const GeoBox * region,
+							const ReaderParameters & params, const InputOptions & options,
+							const ChangesetFilter & filter, const std::vector<ChangesetReader *> & readers )
+{
+	SpatialIndex index;
+	if ( !openIndex<SpatialIndex,SpatialIndexBuilder>( index, path, indexPath, options ) )
+		return false;
+
+	std::vector<GeoBox> regions;
+	ChangesetFilter regionFilter = filter;
+	if ( region ) {
+		// the index is only as precise as a float, so test the exact boxes too
+		char expression[256];
+		snprintf( expression, sizeof expression, "max_lon >= %.17g and min_lon <= %.17g and max_lat >= %.17g and min_lat <= %.17g",
+				 region->minLon, region->maxLon, region->minLat, region->maxLat );
+		std::string error;
+		if ( !regionFilter.compile( filter.empty() ? expression : "(" + filter.text() + ") and " + expression, error ) ) {
+			fprintf( stderr, "Bad region: %s\n", error.c_str() );
+			return false;
+		}
+		regions.push_back( *region );
+	} else {
+		for ( auto reader: readers ) {
+			GeoBox box;
+			if ( !reader->region( box ) ) {
+				printf( "Spatial index: %s has no region, so the input is scanned\n", reader->name.c_str() );
+				return parseFile( path, params, options, filter, readers, SampleSettings() );
+			}
+			regions.push_back( box );
+		}
+	}
+
+	std::vector<SpatialIndex::Record> matches;
+	for ( const auto &box: regions ) {
+		index.search( box, matches );
+	}
+	std::vector<std::pair<long,long>> records = RecordLocations( matches );
+	printf( "Spatial index: %ld of %ld changesets in the region\n", (long)records.size(), (long)index.size() );
+	return parseRecordsAt( path, records, params, options, regionFilter, readers );
+}
+
+// Runs the readers over only the changesets whose comments or hashtags match the query
+bool answerFromCommentIndex( const char * path, const char * indexPath, const char * query,
+							const ReaderParameters & params, const InputOptions & options,
+							const ChangesetFilter & filter, const std::vector<ChangesetReader *> & readers )
+{
+	CommentIndex index;
+	if ( !openIndex<CommentIndex,CommentIndexBuilder>( index, path, indexPath, options ) )
+		return false;
+
+	double time = timestamp();
+	std::vector<long> idents;
+	std::string error;
+	if ( !index.search( query, idents, error ) ) {
+		fprintf( stderr, "Bad query: %s\n", error.c_str() );
+		return false;
+	}
+	std::vector<std::pair<long,long>> records = index.recordLocations( idents );
+	time = timestamp() - time;
+	printf( "Comment index: %ld changesets match, found in %.3f sec\n", (long)records.size(), time );
+	return parseRecordsAt( path, records, params, options, filter, readers );
+}
+
+// Reads the entire file with each backend, without parsing, to compare their raw throughput
+void benchmarkInput( const char * path, InputOptions options )
+{
+	for ( const auto &backend: InputSourceBackends() ) {
+		options.backend = backend;
+		InputSource * source = NewInputSource( options );
+		if ( !source->open( path ) ) {
+			delete source;
+			continue;
+		}
+		double time = timestamp();
+		const char * start, * end;
+		volatile long checksum = 0;
+		while ( source->nextWindow( start, end ) ) {
+			// touch every page
+			for ( const char * p = start; p < end; p += 4096 ) {
+				checksum += *p;
+			}
+		}
+		time = timestamp() - time;
+		printThroughput( *source, time );
+		delete source;
+	}
+}
+
+static void usage()
+{
+	fprintf( stderr, "usage: ParseOsmChangesetFile [options] [changesets.osm | -]\n" );
+	fprintf( stderr, "  -                            read from stdin, e.g. lbzip2 -dc changesets.osm.bz2 | ParseOsmChangesetFile -\n" );
+	fprintf( stderr, "  --input=<mmap|pread|uring|stream>  how to read the file (default mmap)\n" );
+	fprintf( stderr, "  --block-size=<MB>            size of each read (default 16, or 1 for stream)\n" );
+	fprintf( stderr, "  --queue-depth=<N>            uring: reads in flight, stream: buffers in the ring (default 4)\n" );
+	fprintf( stderr, "  --readahead=<MB>             mmap: prefetch window ahead of the parser\n" );
+	fprintf( stderr, "  --populate                   mmap: fault in the whole file up front\n" );
+	fprintf( stderr, "  --hugepages                  mmap: request transparent huge pages\n" );
+	fprintf( stderr, "  --keep-cache                 don't drop data from the page cache after reading it\n" );
+	fprintf( stderr, "  --readers=<name,...>         run only these readers, in this order (default is the usual set)\n" );
+	fprintf( stderr, "  --list-readers               print the names of the available readers and exit\n" );
+	fprintf( stderr, "  --plugin=<library>           load additional readers from a shared library (see ReaderPlugin.h)\n" );
+	fprintf( stderr, "  --start=<date>               analyze changesets created on or after the date (default 2024-03-03,\n" );
+	fprintf( stderr, "                               or the whole file for --serve)\n" );
+	fprintf( stderr, "  --end=<date>                 stop at changesets created on or after the date\n" );
+	fprintf( stderr, "  --country=<name>             the country for GoMapInCountry (default China)\n" );
+	fprintf( stderr, "  --editor=<name>              the editor for the GoMap readers (default Go Map!!)\n" );
+	fprintf( stderr, "  --editor-rules=<file>        how created_by values are turned into editor names, instead of the\n" );
+	fprintf( stderr, "                               built-in rules (see EditorNames.cpp for the format)\n" );
+	fprintf( stderr, "  --filter=<expression>        only analyze matching changesets, e.g. --filter='uid = 1234 or changes > 100'\n" );
+	fprintf( stderr, "  --sample=ids:<rate>          only analyze the changesets whose hashed id falls in a sample, e.g. ids:1%%\n" );
+	fprintf( stderr, "  --sample=bytes:<rate>[:<KB>]  only read runs of records (default 256 KB) spread evenly through the input\n" );
+	fprintf( stderr, "                               (neither works with the options that save or serve what they parse)\n" );
+	fprintf( stderr, "  --max-errors=<N>             skip up to N malformed changesets, resuming at the next one (default 0)\n" );
+	fprintf( stderr, "  --memory-budget=<MB>         memory for each large aggregation before it spills to temporary files (default 1024)\n" );
+	fprintf( stderr, "  --export=<file.arrow>        write the changesets to an Arrow IPC file instead of analyzing them\n" );
+	fprintf( stderr, "  --map=<manifest> --shard=<N>  parse shard N of a sharded run and save its partial state (see ShardManifest.hpp)\n" );
+	fprintf( stderr, "  --reduce=<manifest>          run the readers over the partial states of every shard, one at a time,\n" );
+	fprintf( stderr, "                               so it needs memory for the largest shard and the readers' results\n" );
+	fprintf( stderr, "  --map-reduce=<manifest>      run every shard in a local worker process, then reduce\n" );
+	fprintf( stderr, "  --replication=<dir>          apply the replication files in the directory, replacing updated changesets\n" );
+	fprintf( stderr, "  --load-store=<file>          with --replication: start from a saved store rather than parsing the input\n" );
+	fprintf( stderr, "  --save-store=<file>          with --replication: save the updated store for next time\n" );
+	fprintf( stderr, "  --rollup=<file>              update the rollup cube in the file and answer the readers that can use it from it\n" );
+	fprintf( stderr, "  --spatial-index=<file>       build an index of changeset bounding boxes if needed, and read only the changesets\n" );
+	fprintf( stderr, "                               in the region of --bbox or --point, or of the readers (GoMapInCountry)\n" );
+	fprintf( stderr, "  --bbox=<minlon,minlat,maxlon,maxlat>  with --spatial-index: only changesets intersecting the box\n" );
+	fprintf( stderr, "  --point=<lon,lat>            with --spatial-index: only changesets containing the point\n" );
+	fprintf( stderr, "  --comment-index=<file>       build an index of comment words and hashtags if needed, and read only the\n" );
+	fprintf( stderr, "                               changesets matching --comment-query\n" );
+	fprintf( stderr, "  --comment-query=<query>      with --comment-index: terms combined with and, or and parentheses, e.g. '#missingmaps and building'\n" );
+	fprintf( stderr, "  --input-benchmark            report the read throughput of each backend and exit\n" );
+	fprintf( stderr, "  --serve=<socket>             load the file once and answer queries on a Unix domain socket\n" );
+	fprintf( stderr, "  --query=<socket> key=value.. send a query to a server, e.g. readers=Retention start=2023-01-01\n" );
+}
+
+int main(int argc, const char * argv[])
+{
+	const char * path = "/tmp/cs.osm";
+	InputOptions options;
+	bool benchmark = false;
+	bool blockSizeSet = false;
+	const char * serveSocket = NULL;
+	const char * exportPath = NULL;
+	ChangesetFilter filter;
+	ReaderParameters params;
+	params.startDate = "2024-03-03";
+	SampleSettings sampling;
+	bool startSet = false;
+	const char * readerNames = NULL;
+	bool listReaders = false;
+	const char * mapManifest = NULL;
+	const char * reduceManifest = NULL;
+	int shardIndex = -1;
+	const char * replicationDir = NULL;
+	const char * loadStore = NULL;
+	const char * saveStore = NULL;
+	const char * rollupPath = NULL;
+	const char * spatialIndexPath = NULL;
+	const char * commentIndexPath = NULL;
+	const char * commentQuery = NULL;
+	GeoBox region;
+	bool regionSet = false;
+	for ( int i = 1; i < argc; ++i ) {
+		const char * arg = argv[i];
+		if ( strncmp( arg, "--query=", 8 ) == 0 ) {
+			// the remaining arguments are the lines of the query
+			std::vector<std::string> lines( argv + i + 1, argv + argc );
+			return SendQuery( arg + 8, lines ) ? 0 : 1;
+		} else if ( strncmp( arg, "--serve=", 8 ) == 0 ) {
+			serveSocket = arg + 8;
+		} else if ( strncmp( arg, "--input=", 8 ) == 0 ) {
+			options.backend = arg + 8;
+		} else if ( strncmp( arg, "--block-size=", 13 ) == 0 ) {
+			options.blockSize = atol( arg + 13 ) << 20;
+			blockSizeSet = true;
+		} else if ( strncmp( arg, "--queue-depth=", 14 ) == 0 ) {
+			options.queueDepth = atoi( arg + 14 );
+		} else if ( strncmp( arg, "--readahead=", 12 ) == 0 ) {
+			options.readAhead = atol( arg + 12 ) << 20;
+		} else if ( strcmp( arg, "--populate" ) == 0 ) {
+			options.populate = true;
+		} else if ( strcmp( arg, "--hugepages" ) == 0 ) {
+			options.hugePages = true;
+		} else if ( strcmp( arg, "--keep-cache" ) == 0 ) {
+			options.dropBehind = false;
+		} else if ( strncmp( arg, "--readers=", 10 ) == 0 ) {
+			readerNames = arg + 10;
+		} else if ( strcmp( arg, "--list-readers" ) == 0 ) {
+			listReaders = true;
+		} else if ( strncmp( arg, "--plugin=", 9 ) == 0 ) {
+			std::string error;
+			if ( !LoadReaderPlugin( arg + 9, error ) ) {
+				fprintf( stderr, "Unable to load plugin: %s\n", error.c_str() );
+				return 1;
+			}
+		} else if ( strncmp( arg, "--start=", 8 ) == 0 ) {
+			params.startDate = arg + 8;
+			startSet = true;
+		} else if ( strncmp( arg, "--end=", 6 ) == 0 ) {
+			params.endDate = arg + 6;
+		} else if ( strncmp( arg, "--country=", 10 ) == 0 ) {
+			params.country = arg + 10;
+		} else if ( strncmp( arg, "--editor=", 9 ) == 0 ) {
+			params.editor = arg + 9;
+		} else if ( strncmp( arg, "--filter=", 9 ) == 0 ) {
+			std::string error;
+			if ( !filter.compile( arg + 9, error ) ) {
+				fprintf( stderr, "Bad filter: %s\n", error.c_str() );
+				return 1;
+			}
+		} else if ( strncmp( arg, "--sample=", 9 ) == 0 ) {
+			if ( !ParseSampleSettings( arg + 9, sampling ) ) {
+				usage();
+				return 1;
+			}
+		} else if ( strncmp( arg, "--editor-rules=", 15 ) == 0 ) {
+			std::string error;
+			if ( !EditorNameNormalizer::loadRules( arg + 15, error ) ) {
+				fprintf( stderr, "Bad editor rules: %s\n", error.c_str() );
+				return 1;
+			}
+		} else if ( strncmp( arg, "--max-errors=", 13 ) == 0 ) {
+			ChangesetParser::defaultErrorBudget = atol( arg + 13 );
+			if ( ChangesetParser::defaultErrorBudget < 0 ) {
+				usage();
+				return 1;
+			}
+		} else if ( strncmp( arg, "--memory-budget=", 16 ) == 0 ) {
+			SpillingCounter::defaultBudget = atol( arg + 16 ) << 20;
+			if ( SpillingCounter::defaultBudget == 0 ) {
+				usage();
+				return 1;
+			}
+		} else if ( strncmp( arg, "--map=", 6 ) == 0 ) {
+			mapManifest = arg + 6;
+		} else if ( strncmp( arg, "--shard=", 8 ) == 0 ) {
+			shardIndex = atoi( arg + 8 );
+		} else if ( strncmp( arg, "--reduce=", 9 ) == 0 ) {
+			reduceManifest = arg + 9;
+		} else if ( strncmp( arg, "--map-reduce=", 13 ) == 0 ) {
+			mapManifest = reduceManifest = arg + 13;
+		} else if ( strncmp( arg, "--replication=", 14 ) == 0 ) {
+			replicationDir = arg + 14;
+		} else if ( strncmp( arg, "--load-store=", 13 ) == 0 ) {
+			loadStore = arg + 13;
+		} else if ( strncmp( arg, "--save-store=", 13 ) == 0 ) {
+			saveStore = arg + 13;
+		} else if ( strncmp( arg, "--rollup=", 9 ) == 0 ) {
+			rollupPath = arg + 9;
+		} else if ( strncmp( arg, "--spatial-index=", 16 ) == 0 ) {
+			spatialIndexPath = arg + 16;
+		} else if ( strncmp( arg, "--comment-index=", 16 ) == 0 ) {
+			commentIndexPath = arg + 16;
+		} else if ( strncmp( arg, "--comment-query=", 16 ) == 0 ) {
+			commentQuery = arg + 16;
+		} else if ( strncmp( arg, "--bbox=", 7 ) == 0 || strncmp( arg, "--point=", 8 ) == 0 ) {
+			if ( !ParseGeoBox( strchr( arg, '=' ) + 1, region ) ) {
+				usage();
+				return 1;
+			}
+			regionSet = true;
+		} else if ( strncmp( arg, "--export=", 9 ) == 0 ) {
+			exportPath = arg + 9;
+		} else if ( strcmp( arg, "--input-benchmark" ) == 0 ) {
+			benchmark = true;
+		} else if ( strcmp( arg, "-" ) == 0 ) {
+			path = arg;
+			options.backend = "stream";
+		} else if ( arg[0] == '-' ) {
+			usage();
+			return 1;
+		} else {
+			path = arg;
+		}
+	}
+	if ( options.backend == "stream" && !blockSizeSet ) {
+		// keep memory use to a few MB
+		options.blockSize = 1 << 20;
+	}
+	if ( options.blockSize <= 0 || (regionSet && spatialIndexPath == NULL) || (commentIndexPath == NULL) != (commentQuery == NULL) ) {
+		usage();
+		return 1;
+	}
+
+	if ( sampling.scheme != SAMPLE_NONE &&
+		(serveSocket || mapManifest || reduceManifest || replicationDir || rollupPath || spatialIndexPath || commentIndexPath) ) {
+		// these save what they parse and use it again, or answer from what was saved, as if it were complete
+		fprintf( stderr, "--sample can't be used with --serve, --map, --reduce, --replication, --rollup or the indexes\n" );
+		return 1;
+	}
+
+	if ( benchmark ) {
+		benchmarkInput( path, options );
+		return 0;
+	}
+	if ( listReaders ) {
+		for ( const auto &name: getReaderNames() ) {
+			printf( "%s\n", name.c_str() );
+		}
+		return 0;
+	}
+
+	if ( serveSocket ) {
+		if ( !startSet )
+			params.startDate = "";
+		return serveFile( path, params, options, filter, serveSocket ) ? 0 : 1;
+	}
+	if ( exportPath ) {
+		ArrowExporter * exporter = new ArrowExporter( exportPath );
+		std::vector<ChangesetReader *> readers( 1, exporter );
+		bool ok = parseFile( path, params, options, filter, readers, sampling ) && !exporter->failed();
+		delete exporter;
+		return ok ? 0 : 1;
+	}
+	std::vector<Shard> shards;
+	if ( mapManifest || reduceManifest ) {
+		std::string error;
+		if ( !ReadShardManifest( mapManifest ? mapManifest : reduceManifest, shards, error ) ) {
+			fprintf( stderr, "%s\n", error.c_str() );
+			return 1;
+		}
+	}
+	if ( mapManifest && !reduceManifest ) {
+		if ( shardIndex < 0 || shardIndex >= (int)shards.size() ) {
+			fprintf( stderr, "--shard must be between 0 and %d\n", (int)shards.size() - 1 );
+			return 1;
+		}
+		return mapShard( shards[shardIndex], params, options, filter ) ? 0 : 1;
+	}
+
+	std::vector<ChangesetReader *> readers;
+	if ( readerNames ) {
+		std::string error;
+		if ( !newReaders( readerNames, params, readers, error ) ) {
+			fprintf( stderr, "Bad readers: %s\n", error.c_str() );
+			return 1;
+		}
+	} else {
+		readers = getReaders( params );
+	}
+	if ( filter.usesTags() && (replicationDir || reduceManifest) ) {
+		// these replay stored changesets, which don't keep the other tags
+		fprintf( stderr, "Filters using tag:<key> or hashtags need the XML, so can't be used with --replication or --reduce\n" );
+		deleteReaders( readers );
+		return 1;
+	}
+	bool ok = true;
+	if ( replicationDir ) {
+		ok = ingestReplication( path, replicationDir, loadStore, saveStore, params, options, filter, readers );
+	} else if ( commentIndexPath ) {
+		ok = answerFromCommentIndex( path, commentIndexPath, commentQuery, params, options, filter, readers );
+	} else if ( spatialIndexPath ) {
+		ok = answerFromSpatialIndex( path, spatialIndexPath, regionSet ? &region : NULL, params, options, filter, readers );
+	} else if ( rollupPath ) {
+		ok = answerFromRollup( path, rollupPath, params, options, filter, readers );
+	} else if ( reduceManifest ) {
+		ok = mapManifest ? mapReduceShards( shards, params, options, filter, readers )
+						 : reduceShards( shards, params, filter, readers );
+	} else {
+		double time = timestamp();
+		ok = parseFile( path, params, options, filter, readers, sampling );
+		time = timestamp() - time;
+		printf( "total time = %f\n", time);
+	}
+	printMemoryUsage( readers );
+	deleteReaders( readers );
+	return ok ? 0 : 1;
 }